@@ -0,0 +1,28 @@
+#!/bin/sh
+# Instructions the interpreter dispatches running a corpus of generated
+# programs, as lowered and with every SSA pass.
+# usage: bench/dispatch.sh [main] [gen_program]   (run from phase-IR)
+
+MAIN=${1:-./main}
+GEN=${2:-./gen_program}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+for seed in 1 2 3 4 5 6 7 8; do
+    "$GEN" 15 40 $seed > "$DIR/p$seed.txt"
+done
+cp text.txt "$DIR/"
+
+count() {
+    "$MAIN" --no-dump --run --stats "$@" 2>&1 | sed -n 's/^\[stats\] interpreter: \([0-9]*\).*/\1/p'
+}
+
+printf "%-12s %12s %12s\n" program lowered all
+total_lowered=0; total_all=0
+for file in "$DIR"/*.txt; do
+    lowered=$(count "$file")
+    all=$(count -O "$file")
+    printf "%-12s %12d %12d\n" "$(basename "$file")" $lowered $all
+    total_lowered=$((total_lowered + lowered)); total_all=$((total_all + all))
+done
+printf "%-12s %12d %12d\n" total $total_lowered $total_all
@@ -0,0 +1,179 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+using namespace std;
+
+// Emits a synthetic source program for benchmarking the front end and the
+// IR pipeline: gen_program [functions] [statements-per-function] [seed] [loops|pre]
+// With "loops", most statements are counted loops, some nested, whose
+// bodies scale the counter and recompute invariant expressions. With
+// "pre", they are loops that compute an expression on one side of an if
+// and again after it, the partial redundancies that code motion targets.
+
+static unsigned int rngState = 12345;
+static bool loopHeavy = false;
+static bool partiallyRedundant = false;
+
+static int rnd(int n) 
+{
+    rngState = rngState * 1103515245u + 12345u;
+    return (int)((rngState >> 16) % (unsigned int)n);
+}
+
+static string pickVar(int declared) 
+{
+    if (declared == 0 || rnd(4) == 0) return "n";
+    return "v" + to_string(rnd(declared));
+}
+
+static string genExpr(int declared, int depth) 
+{
+    // common subexpressions recur the way index arithmetic does in real code
+    static const char* common[] = {"(n - 1)", "(n + 10)", "(n * 2)"};
+    if (depth > 0 && rnd(4) == 0) return common[rnd(3)];
+    if (depth == 0 || rnd(3) == 0) 
+    {
+        if (rnd(3) == 0) return to_string(rnd(100));
+        return pickVar(declared);
+    }
+    static const char* ops[] = {"+", "-", "*", "+"};
+    string op = ops[rnd(4)];
+    return "(" + genExpr(declared, depth - 1) + " " + op + " " + genExpr(declared, depth - 1) + ")";
+}
+
+// while (iS < bound) with a body of accumulations, nested once at most
+static void genLoop(const string& counter, int declared, int depth, const string& indent) 
+{
+    string i = "i" + counter;
+    int step = 1 + rnd(2);
+    cout << indent << "int " << i << " = " << rnd(3) << ";\n";
+    cout << indent << "while (" << i << " < " << (8 + rnd(40)) << ") {\n";
+    int body = 1 + rnd(3);
+    for (int k = 0; k < body; k++) 
+    {
+        string v = pickVar(declared);
+        if (v == "n") v = "v0";
+        switch (rnd(4)) 
+        {
+            case 0: cout << indent << "    " << v << " = " << v << " + " << i << " * " << (2 + rnd(9)) << ";\n"; break;
+            case 1: cout << indent << "    " << v << " = " << v << " + " << i << " * " << pickVar(declared) << ";\n"; break;
+            case 2: cout << indent << "    " << v << " = " << v << " + " << genExpr(declared, 2) << ";\n"; break;
+            default: cout << indent << "    " << v << " = " << v << " - (" << i << " + " << genExpr(declared, 1) << ") * 3;\n"; break;
+        }
+    }
+    if (depth == 0 && rnd(3) == 0) genLoop(counter + "_" + to_string(rnd(10)), declared, 1, indent + "    ");
+    cout << indent << "    " << i << " = " << i << " + " << step << ";\n";
+    cout << indent << "}\n";
+}
+
+// a loop computing one expression under an if, with or without an else, and after it
+static void genRedundant(const string& counter, int declared, const string& indent) 
+{
+    string i = "i" + counter;
+    int p = rnd(declared), q = rnd(declared);
+    int x = rnd(declared);
+    while (x == p || x == q) x = (x + 1) % declared;
+    string vp = "v" + to_string(p), vq = "v" + to_string(q), vx = "v" + to_string(x);
+    string e;
+    switch (rnd(3)) 
+    {
+        case 0: e = "(" + vp + " * " + vq + " + " + i + ")"; break;
+        case 1: e = "(" + vp + " - " + i + ") * " + to_string(2 + rnd(9)); break;
+        default: e = "(" + i + " * " + vq + " + " + to_string(rnd(100)) + ")"; break;
+    }
+    cout << indent << "int " << i << " = 0;\n";
+    cout << indent << "while (" << i << " < " << (8 + rnd(40)) << ") {\n";
+    cout << indent << "    if (" << i << " > " << rnd(30) << ") {\n";
+    cout << indent << "        " << vx << " = " << vx << " + " << e << ";\n";
+    if (rnd(2) == 0) 
+    {
+        cout << indent << "    } else {\n";
+        cout << indent << "        " << vx << " = " << vx << " - " << i << ";\n";
+    }
+    cout << indent << "    }\n";
+    cout << indent << "    " << vx << " = " << vx << " + " << e << " * 3;\n";
+    cout << indent << "    " << i << " = " << i << " + 1;\n";
+    cout << indent << "}\n";
+}
+
+static void genFunction(int index, int stmts) 
+{
+    cout << "fn int f" << index << "(int n) {\n";
+    int declared = 0;
+    for (int s = 0; s < stmts; s++) 
+    {
+        int kind = rnd(10);
+        if (loopHeavy && declared > 0 && kind >= 4 && kind < 9) 
+        {
+            genLoop(to_string(s), declared, 0, "    ");
+            continue;
+        }
+        if (partiallyRedundant && declared > 2 && kind >= 4 && kind < 9) 
+        {
+            genRedundant(to_string(s), declared, "    ");
+            continue;
+        }
+        if (kind < 4 || declared == 0) 
+        {
+            cout << "    int v" << declared << " = " << genExpr(declared, 3) << ";\n";
+            declared++;
+        } 
+        else if (kind < 6) 
+        {
+            string v = pickVar(declared);
+            if (v == "n") v = "v0";
+            cout << "    " << v << " += " << genExpr(declared, 2) << ";\n";
+        } 
+        else if (kind < 8) 
+        {
+            string a = pickVar(declared);
+            cout << "    if (" << a << " > " << genExpr(declared, 1) << ") {\n";
+            cout << "        v0 = v0 + " << genExpr(declared, 2) << ";\n";
+            cout << "    } else {\n";
+            cout << "        v0 = v0 - " << genExpr(declared, 1) << ";\n";
+            cout << "    }\n";
+        } 
+        else if (kind < 9) 
+        {
+            cout << "    int i" << s << " = 0;\n";
+            cout << "    while (i" << s << " < " << (2 + rnd(8)) << ") {\n";
+            cout << "        v0 = v0 + i" << s << " * " << (1 + rnd(9)) << ";\n";
+            cout << "        i" << s << " = i" << s << " + 1;\n";
+            cout << "    }\n";
+        } 
+        else 
+        {
+            if (index > 0) 
+                cout << "    v0 = v0 + f" << rnd(index) << "(" << genExpr(declared, 1) << ");\n";
+            else 
+                cout << "    v0 = v0 + 1;\n";
+        }
+    }
+    cout << "    return v0;\n";
+    cout << "}\n\n";
+}
+
+int main(int argc, char* argv[]) 
+{
+    int functions = argc > 1 ? atoi(argv[1]) : 100;
+    int stmts = argc > 2 ? atoi(argv[2]) : 50;
+    if (argc > 3) rngState = (unsigned int)atoi(argv[3]);
+    loopHeavy = argc > 4 && string(argv[4]) == "loops";
+    partiallyRedundant = argc > 4 && string(argv[4]) == "pre";
+
+    for (int f = 0; f < functions; f++) 
+    {
+        genFunction(f, stmts);
+    }
+
+    cout << "fn int main() {\n";
+    cout << "    int total = 0;\n";
+    for (int f = 0; f < functions && f < 8; f++) 
+    {
+        cout << "    total = total + f" << (functions - 1 - f) << "(" << f << ");\n";
+    }
+    cout << "    return total;\n";
+    cout << "}\n";
+    return 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/sh
+# IR instruction counts over a corpus of generated programs, as lowered,
+# after the SSA round trip, with copy propagation alone and with every pass.
+# usage: bench/ir_size.sh [main] [gen_program]   (run from phase-IR)
+
+MAIN=${1:-./main}
+GEN=${2:-./gen_program}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+for seed in 1 2 3 4 5 6 7 8; do
+    "$GEN" 40 60 $seed > "$DIR/p$seed.txt"
+done
+cp text.txt "$DIR/"
+
+count() {
+    "$MAIN" --no-dump --stats "$@" 2>&1 | sed -n 's/^\[stats\] IR instructions: //p'
+}
+
+printf "%-12s %10s %10s %10s %10s\n" program lowered ssa copy all
+total_lowered=0; total_ssa=0; total_copy=0; total_all=0
+for file in "$DIR"/*.txt; do
+    lowered=$(count "$file")
+    ssa=$(count --ssa "$file")
+    copy=$(count --opt=copy "$file")
+    all=$(count -O "$file")
+    printf "%-12s %10d %10d %10d %10d\n" "$(basename "$file")" $lowered $ssa $copy $all
+    total_lowered=$((total_lowered + lowered)); total_ssa=$((total_ssa + ssa))
+    total_copy=$((total_copy + copy)); total_all=$((total_all + all))
+done
+printf "%-12s %10d %10d %10d %10d\n" total $total_lowered $total_ssa $total_copy $total_all
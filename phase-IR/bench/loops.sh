@@ -0,0 +1,34 @@
+#!/bin/sh
+# Instructions the interpreter dispatches running a corpus of loop-heavy
+# generated programs: as lowered, with the scalar SSA passes, adding
+# loop-invariant code motion, then induction variables, and with every
+# pass, unrolling included.
+# usage: bench/loops.sh [main] [gen_program]   (run from phase-IR)
+
+MAIN=${1:-./main}
+GEN=${2:-./gen_program}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+for seed in 1 2 3 4 5 6 7 8; do
+    "$GEN" 12 30 $seed loops > "$DIR/p$seed.txt"
+done
+
+count() {
+    "$MAIN" --no-dump --run --stats "$@" 2>&1 | sed -n 's/^\[stats\] interpreter: \([0-9]*\).*/\1/p'
+}
+
+SCALAR=sccp,copy,gvn,dce,fuse
+printf "%-12s %12s %12s %12s %12s %12s\n" program lowered scalar licm iv all
+total_lowered=0; total_scalar=0; total_licm=0; total_iv=0; total_all=0
+for file in "$DIR"/*.txt; do
+    lowered=$(count "$file")
+    scalar=$(count --opt=$SCALAR "$file")
+    licm=$(count --opt=$SCALAR,licm "$file")
+    iv=$(count --opt=$SCALAR,licm,iv "$file")
+    all=$(count -O "$file")
+    printf "%-12s %12d %12d %12d %12d %12d\n" "$(basename "$file")" $lowered $scalar $licm $iv $all
+    total_lowered=$((total_lowered + lowered)); total_scalar=$((total_scalar + scalar))
+    total_licm=$((total_licm + licm)); total_iv=$((total_iv + iv)); total_all=$((total_all + all))
+done
+printf "%-12s %12d %12d %12d %12d %12d\n" total $total_lowered $total_scalar $total_licm $total_iv $total_all
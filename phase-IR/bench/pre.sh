@@ -0,0 +1,29 @@
+#!/bin/sh
+# Instructions the interpreter dispatches running a corpus of generated
+# programs full of partial redundancies: as lowered, with every SSA pass
+# but partial redundancy elimination, and with every pass.
+# usage: bench/pre.sh [main] [gen_program]   (run from phase-IR)
+
+MAIN=${1:-./main}
+GEN=${2:-./gen_program}
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+for seed in 1 2 3 4 5 6 7 8; do
+    "$GEN" 12 30 $seed pre > "$DIR/p$seed.txt"
+done
+
+count() {
+    "$MAIN" --no-dump --run --stats "$@" 2>&1 | sed -n 's/^\[stats\] interpreter: \([0-9]*\).*/\1/p'
+}
+
+printf "%-12s %12s %12s %12s\n" program lowered no-pre all
+total_lowered=0; total_nopre=0; total_all=0
+for file in "$DIR"/*.txt; do
+    lowered=$(count "$file")
+    nopre=$(count --opt=sccp,copy,gvn,licm,iv,unroll,dce,fuse "$file")
+    all=$(count -O "$file")
+    printf "%-12s %12d %12d %12d\n" "$(basename "$file")" $lowered $nopre $all
+    total_lowered=$((total_lowered + lowered)); total_nopre=$((total_nopre + nopre)); total_all=$((total_all + all))
+done
+printf "%-12s %12d %12d %12d\n" total $total_lowered $total_nopre $total_all
@@ -0,0 +1,46 @@
+#include "passes.h"
+
+using namespace std;
+
+// whether anything between the comparison and the branch can change a global
+static bool globalsChange(const SSABlock& block, size_t from) 
+{
+    for (size_t i = from; i + 1 < block.code.size(); i++) 
+    {
+        const IRInstruction& instr = block.code[i];
+        if (instr.op == IROpcode::CALL || instr.result.kind() == OperandKind::Global) return true;
+    }
+    return false;
+}
+
+BranchFusionResult fuseBranches(SSAFunction& function) 
+{
+    BranchFusionResult result;
+    function.computeDefUse();
+    for (uint32_t b = 0; b < function.blocks.size(); b++) 
+    {
+        SSABlock& block = function.blocks[b];
+        if (block.code.empty()) continue;
+        IRInstruction& branch = block.terminator();
+        if (branch.op != IROpcode::IF_FALSE && branch.op != IROpcode::IF_TRUE) continue;
+        if (!SSAFunction::isValue(branch.arg1)) continue;
+        uint32_t v = branch.arg1.index();
+        const SSASite& def = function.definition(v);
+        if (function.useCount(v) != 1 || def.isPhi() || def.block != b) continue;
+        
+        const IRInstruction& compare = block.code[def.index];
+        IROpcode fused = branchOn(compare.op);
+        if (fused == IROpcode::GOTO) continue;
+        bool readsGlobal = compare.arg1.kind() == OperandKind::Global || compare.arg2.kind() == OperandKind::Global;
+        if (readsGlobal && globalsChange(block, def.index + 1)) continue;
+        
+        // IF_FALSE jumps when the negation holds; lacking one, the
+        // comparison itself jumps to the other successor
+        if (branch.op == IROpcode::IF_FALSE && negatedBranch(fused) != fused) fused = negatedBranch(fused);
+        else if (branch.op == IROpcode::IF_FALSE) swap(block.succs[0], block.succs[1]);
+        branch = IRInstruction(fused, Operand(), compare.arg1, compare.arg2);
+        block.code.erase(block.code.begin() + def.index);
+        result.fused++;
+    }
+    return result;
+}
@@ -0,0 +1,166 @@
+#include "cfg.h"
+
+using namespace std;
+
+static bool endsBlock(IROpcode op) 
+{
+    return op == IROpcode::GOTO || op == IROpcode::RETURN || isConditionalBranch(op);
+}
+
+int ControlFlowGraph::blockOfLabel(Operand label) const 
+{
+    if (label.index() < firstLabel || label.index() - firstLabel >= labelBlocks.size()) return -1;
+    return labelBlocks[label.index() - firstLabel];
+}
+
+void ControlFlowGraph::build(const IRBuffer& code, size_t begin) 
+{
+    funcBegin = begin;
+    starts.clear();
+    succOffsets.clear();
+    succList.clear();
+    
+    // leaders: the first body instruction, every label and whatever follows a jump or return
+    uint32_t minLabel = UINT32_MAX, maxLabel = 0;
+    size_t i = begin + 1;
+    starts.push_back((uint32_t)i);
+    for (; i < code.size() && code.op(i) != IROpcode::FUNC_END; i++) 
+    {
+        IROpcode op = code.op(i);
+        if (op == IROpcode::LABEL) 
+        {
+            uint32_t label = code.result(i).index();
+            minLabel = min(minLabel, label);
+            maxLabel = max(maxLabel, label);
+        }
+        if (i > begin + 1 && (op == IROpcode::LABEL || endsBlock(code.op(i - 1)))) 
+        {
+            starts.push_back((uint32_t)i);
+        }
+    }
+    funcEnd = i;
+    starts.push_back((uint32_t)funcEnd);
+    size_t blocks = starts.size() - 1;
+    
+    // labels only ever lead a block
+    firstLabel = minLabel == UINT32_MAX ? 0 : minLabel;
+    labelBlocks.assign(minLabel == UINT32_MAX ? 0 : maxLabel - minLabel + 1, -1);
+    for (size_t b = 0; b < blocks; b++) 
+    {
+        if (starts[b] < funcEnd && code.op(starts[b]) == IROpcode::LABEL) 
+        {
+            labelBlocks[code.result(starts[b]).index() - firstLabel] = (int32_t)b;
+        }
+    }
+    
+    succOffsets.reserve(blocks + 1);
+    for (size_t b = 0; b < blocks; b++) 
+    {
+        succOffsets.push_back((uint32_t)succList.size());
+        bool hasNext = b + 1 < blocks;
+        if (starts[b] == starts[b + 1]) 
+        {
+            if (hasNext) succList.push_back((uint32_t)b + 1);
+            continue;
+        }
+        size_t last = starts[b + 1] - 1;
+        IROpcode op = code.op(last);
+        if (op == IROpcode::RETURN) continue;
+        if (op == IROpcode::GOTO) 
+        {
+            int target = blockOfLabel(code.result(last));
+            if (target >= 0) succList.push_back((uint32_t)target);
+            continue;
+        }
+        if (hasNext) succList.push_back((uint32_t)b + 1);
+        if (isConditionalBranch(op)) 
+        {
+            int target = blockOfLabel(code.result(last));
+            if (target >= 0 && (size_t)target != b + 1) succList.push_back((uint32_t)target);
+        }
+    }
+    succOffsets.push_back((uint32_t)succList.size());
+    
+    // predecessors by counting sort over the successor lists
+    predOffsets.assign(blocks + 1, 0);
+    for (uint32_t target : succList) predOffsets[target + 1]++;
+    for (size_t b = 0; b < blocks; b++) predOffsets[b + 1] += predOffsets[b];
+    predList.resize(succList.size());
+    vector<uint32_t> fill(predOffsets.begin(), predOffsets.end() - 1);
+    for (size_t b = 0; b < blocks; b++) 
+    {
+        for (uint32_t target : successors(b)) predList[fill[target]++] = (uint32_t)b;
+    }
+}
+
+void ControlFlowGraph::dump(OutputBuffer& out, const IRBuffer& code) const 
+{
+    out << "CFG " << code.text(code.result(funcBegin)) << ": " << (long long)blockCount() 
+        << " blocks, " << (long long)edgeCount() << " edges\n";
+    for (size_t b = 0; b < blockCount(); b++) 
+    {
+        out << "  B" << (long long)b << " [" << (long long)blockBegin(b) << ", " 
+            << (long long)blockEnd(b) << ")";
+        if (predecessors(b).size()) 
+        {
+            out << " <-";
+            for (uint32_t p : predecessors(b)) out << " B" << (long long)p;
+        }
+        if (successors(b).size()) 
+        {
+            out << " ->";
+            for (uint32_t s : successors(b)) out << " B" << (long long)s;
+        }
+        out << '\n';
+    }
+}
+
+void ControlFlowGraph::dumpJson(OutputBuffer& out, const IRBuffer& code) const 
+{
+    for (size_t b = 0; b < blockCount(); b++) 
+    {
+        out << "{\"function\":";
+        out.jsonString(code.text(code.result(funcBegin)));
+        out << ",\"block\":" << (long long)b << ",\"begin\":" << (long long)blockBegin(b) 
+            << ",\"end\":" << (long long)blockEnd(b) << ",\"pred\":[";
+        for (size_t i = 0; i < predecessors(b).size(); i++) 
+        {
+            if (i) out << ',';
+            out << (long long)predecessors(b)[i];
+        }
+        out << "],\"succ\":[";
+        for (size_t i = 0; i < successors(b).size(); i++) 
+        {
+            if (i) out << ',';
+            out << (long long)successors(b)[i];
+        }
+        out << "]}\n";
+    }
+}
+
+vector<ControlFlowGraph> buildCFGs(const IRBuffer& code) 
+{
+    vector<ControlFlowGraph> graphs;
+    for (size_t i = 0; i < code.size(); i++) 
+    {
+        if (code.op(i) != IROpcode::FUNC_BEGIN) continue;
+        graphs.emplace_back();
+        graphs.back().build(code, i);
+        i = graphs.back().functionEnd();
+    }
+    return graphs;
+}
+
+void printCFGs(ostream& os, const vector<ControlFlowGraph>& graphs, const IRBuffer& code, 
+               DumpFormat format) 
+{
+    OutputBuffer out(os);
+    if (format == DumpFormat::JsonLines) 
+    {
+        for (const auto& graph : graphs) graph.dumpJson(out, code);
+        return;
+    }
+    out << "\n=== CONTROL FLOW GRAPHS ===\n";
+    for (const auto& graph : graphs) graph.dump(out, code);
+    out << "===========================\n\n";
+}
@@ -0,0 +1,74 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "ir.h"
+
+using namespace std;
+
+// Basic blocks of one function's TAC as instruction ranges of an IRBuffer.
+// Successors and predecessors are stored CSR style, a flat array of block
+// indices per direction plus per-block offsets, so rebuilding after a
+// transformation is a few linear passes without per-block allocations.
+// Block 0 is the entry; a block ending in RETURN or falling off the end of
+// the function has no successors.
+class ControlFlowGraph 
+{
+private:
+    size_t funcBegin;               // index of FUNC_BEGIN
+    size_t funcEnd;                 // index of FUNC_END
+    vector<uint32_t> starts;        // first instruction of each block, then funcEnd
+    vector<uint32_t> succOffsets;
+    vector<uint32_t> succList;
+    vector<uint32_t> predOffsets;
+    vector<uint32_t> predList;
+    vector<int32_t> labelBlocks;    // label number - firstLabel -> block
+    uint32_t firstLabel;
+    
+public:
+    // a view of one block's edge list
+    struct Edges 
+    {
+        const uint32_t* first;
+        const uint32_t* last;
+        
+        const uint32_t* begin() const { return first; }
+        const uint32_t* end() const { return last; }
+        size_t size() const { return last - first; }
+        uint32_t operator[](size_t i) const { return first[i]; }
+    };
+    
+    ControlFlowGraph() : funcBegin(0), funcEnd(0), firstLabel(0) {}
+    
+    // (re)builds the graph of the function whose FUNC_BEGIN is at funcBegin
+    void build(const IRBuffer& code, size_t funcBegin);
+    
+    size_t functionBegin() const { return funcBegin; }
+    size_t functionEnd() const { return funcEnd; }
+    size_t blockCount() const { return starts.size() - 1; }
+    size_t edgeCount() const { return succList.size(); }
+    size_t blockBegin(size_t block) const { return starts[block]; }
+    size_t blockEnd(size_t block) const { return starts[block + 1]; }
+    Edges successors(size_t block) const 
+    {
+        return {succList.data() + succOffsets[block], succList.data() + succOffsets[block + 1]};
+    }
+    Edges predecessors(size_t block) const 
+    {
+        return {predList.data() + predOffsets[block], predList.data() + predOffsets[block + 1]};
+    }
+    // block that starts with the given label, -1 if none
+    int blockOfLabel(Operand label) const;
+    
+    void dump(OutputBuffer& out, const IRBuffer& code) const;
+    void dumpJson(OutputBuffer& out, const IRBuffer& code) const;
+};
+
+// one graph per FUNC_BEGIN..FUNC_END range of code, in order
+vector<ControlFlowGraph> buildCFGs(const IRBuffer& code);
+void printCFGs(ostream& os, const vector<ControlFlowGraph>& graphs, const IRBuffer& code, 
+               DumpFormat format = DumpFormat::Text);
+
+#endif
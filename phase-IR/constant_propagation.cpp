@@ -0,0 +1,386 @@
+#include "passes.h"
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+// Lattice of a value: Top until something reaches its definition, then a
+// constant, then Bottom once it can differ between executions
+enum class ConstantLevel : uint8_t { Top, Constant, Bottom };
+
+struct LatticeValue 
+{
+    ConstantLevel level = ConstantLevel::Top;
+    OperandKind kind = OperandKind::None;   // Int, Float or Bool
+    long long i = 0;                        // int value, or 0 / 1 for a bool
+    double f = 0;
+    
+    bool isConstant() const { return level == ConstantLevel::Constant; }
+    
+    static LatticeValue bottom() 
+    {
+        LatticeValue v;
+        v.level = ConstantLevel::Bottom;
+        return v;
+    }
+    static LatticeValue ofInt(long long x) 
+    {
+        LatticeValue v;
+        v.level = ConstantLevel::Constant;
+        v.kind = OperandKind::Int;
+        v.i = x;
+        return v;
+    }
+    static LatticeValue ofBool(bool x) 
+    {
+        LatticeValue v = ofInt(x);
+        v.kind = OperandKind::Bool;
+        return v;
+    }
+    // infinities and NaN are left to run time
+    static LatticeValue ofFloat(double x) 
+    {
+        if (!isfinite(x)) return bottom();
+        LatticeValue v;
+        v.level = ConstantLevel::Constant;
+        v.kind = OperandKind::Float;
+        v.f = x;
+        return v;
+    }
+    
+    bool sameConstant(const LatticeValue& other) const 
+    {
+        if (kind != other.kind) return false;
+        if (kind == OperandKind::Float) return memcmp(&f, &other.f, sizeof f) == 0;
+        return i == other.i;
+    }
+};
+
+static LatticeValue meet(const LatticeValue& a, const LatticeValue& b) 
+{
+    if (a.level == ConstantLevel::Top) return b;
+    if (b.level == ConstantLevel::Top) return a;
+    if (a.level == ConstantLevel::Bottom || b.level == ConstantLevel::Bottom) return LatticeValue::bottom();
+    return a.sameConstant(b) ? a : LatticeValue::bottom();
+}
+
+// ints wrap around as two's complement
+static long long wrapped(unsigned long long x) { return (long long)x; }
+
+// folds an operation on constant operands; b is a for unary operations
+static LatticeValue fold(IROpcode op, const LatticeValue& a, const LatticeValue& b) 
+{
+    typedef unsigned long long U;
+    switch (op) 
+    {
+        case IROpcode::ADD_I: return LatticeValue::ofInt(wrapped((U)a.i + (U)b.i));
+        case IROpcode::SUB_I: return LatticeValue::ofInt(wrapped((U)a.i - (U)b.i));
+        case IROpcode::MUL_I: return LatticeValue::ofInt(wrapped((U)a.i * (U)b.i));
+        case IROpcode::DIV_I:
+            // division by zero stays a run-time error
+            if (b.i == 0 || (a.i == LLONG_MIN && b.i == -1)) return LatticeValue::bottom();
+            return LatticeValue::ofInt(a.i / b.i);
+        case IROpcode::ADD_F: return LatticeValue::ofFloat(a.f + b.f);
+        case IROpcode::SUB_F: return LatticeValue::ofFloat(a.f - b.f);
+        case IROpcode::MUL_F: return LatticeValue::ofFloat(a.f * b.f);
+        case IROpcode::DIV_F:
+            if (b.f == 0) return LatticeValue::bottom();
+            return LatticeValue::ofFloat(a.f / b.f);
+        case IROpcode::NEG_I: return LatticeValue::ofInt(wrapped(0 - (U)a.i));
+        case IROpcode::NEG_F: return LatticeValue::ofFloat(-a.f);
+        case IROpcode::NOT: return LatticeValue::ofBool(!a.i);
+        case IROpcode::I2F: return LatticeValue::ofFloat((double)a.i);
+        case IROpcode::F2I:
+            if (!(a.f > -9.2e18 && a.f < 9.2e18)) return LatticeValue::bottom();
+            return LatticeValue::ofInt((long long)a.f);
+        case IROpcode::EQ_I: return LatticeValue::ofBool(a.i == b.i);
+        case IROpcode::NE_I: return LatticeValue::ofBool(a.i != b.i);
+        case IROpcode::LT_I: return LatticeValue::ofBool(a.i < b.i);
+        case IROpcode::LE_I: return LatticeValue::ofBool(a.i <= b.i);
+        case IROpcode::GT_I: return LatticeValue::ofBool(a.i > b.i);
+        case IROpcode::GE_I: return LatticeValue::ofBool(a.i >= b.i);
+        case IROpcode::EQ_F: return LatticeValue::ofBool(a.f == b.f);
+        case IROpcode::NE_F: return LatticeValue::ofBool(a.f != b.f);
+        case IROpcode::LT_F: return LatticeValue::ofBool(a.f < b.f);
+        case IROpcode::LE_F: return LatticeValue::ofBool(a.f <= b.f);
+        case IROpcode::GT_F: return LatticeValue::ofBool(a.f > b.f);
+        case IROpcode::GE_F: return LatticeValue::ofBool(a.f >= b.f);
+        case IROpcode::EQ_B: return LatticeValue::ofBool(a.i == b.i);
+        case IROpcode::NE_B: return LatticeValue::ofBool(a.i != b.i);
+        case IROpcode::AND: return LatticeValue::ofBool(a.i && b.i);
+        case IROpcode::OR: return LatticeValue::ofBool(a.i || b.i);
+        default: break;
+    }
+    
+    // the untyped comparisons order bools; strings never become constants
+    if (a.kind != b.kind || a.kind == OperandKind::Float) return LatticeValue::bottom();
+    switch (op) 
+    {
+        case IROpcode::EQ: return LatticeValue::ofBool(a.i == b.i);
+        case IROpcode::NE: return LatticeValue::ofBool(a.i != b.i);
+        case IROpcode::LT: return LatticeValue::ofBool(a.i < b.i);
+        case IROpcode::LE: return LatticeValue::ofBool(a.i <= b.i);
+        case IROpcode::GT: return LatticeValue::ofBool(a.i > b.i);
+        case IROpcode::GE: return LatticeValue::ofBool(a.i >= b.i);
+        default: return LatticeValue::bottom();
+    }
+}
+
+static bool isFoldable(IROpcode op) 
+{
+    return op <= IROpcode::OR;
+}
+
+class ConstantPropagator 
+{
+private:
+    SSAFunction& function;
+    IRBuffer& code;
+    vector<LatticeValue> values;
+    vector<uint8_t> blockExecutable;
+    vector<uint32_t> edgeBase;          // per block, index of its first outgoing edge
+    vector<uint8_t> edgeExecutable;
+    vector<pair<uint32_t, uint32_t>> flowWork;     // (block, successor index)
+    vector<uint32_t> ssaWork;
+    
+    LatticeValue valueOf(Operand operand) const 
+    {
+        switch (operand.kind()) 
+        {
+            case OperandKind::Temp: return values[operand.index()];
+            case OperandKind::Int:
+            case OperandKind::LongInt: return LatticeValue::ofInt(code.intValue(operand));
+            case OperandKind::Float: return LatticeValue::ofFloat(code.floatValue(operand));
+            case OperandKind::Bool: return LatticeValue::ofBool(operand.index());
+            default: return LatticeValue::bottom();
+        }
+    }
+    
+    bool executable(uint32_t from, uint32_t to) const 
+    {
+        const auto& succs = function.blocks[from].succs;
+        for (uint32_t k = 0; k < succs.size(); k++) 
+        {
+            if (succs[k] == to) return edgeExecutable[edgeBase[from] + k];
+        }
+        return false;
+    }
+    
+    void markEdge(uint32_t block, uint32_t k) 
+    {
+        uint8_t& mark = edgeExecutable[edgeBase[block] + k];
+        if (mark) return;
+        mark = 1;
+        flowWork.push_back({block, k});
+    }
+    
+    // values only move down the lattice
+    void lower(Operand result, const LatticeValue& value) 
+    {
+        LatticeValue& current = values[result.index()];
+        if (current.level == ConstantLevel::Bottom || value.level == ConstantLevel::Top) return;
+        if (current.isConstant() && value.isConstant() && current.sameConstant(value)) return;
+        current = current.level == ConstantLevel::Top ? value : LatticeValue::bottom();
+        ssaWork.push_back(result.index());
+    }
+    
+    LatticeValue evaluate(const IRInstruction& instr) const 
+    {
+        if (instr.op == IROpcode::COPY || instr.op == IROpcode::ASSIGN) return valueOf(instr.arg1);
+        if (!isFoldable(instr.op)) return LatticeValue::bottom();
+        LatticeValue a = valueOf(instr.arg1);
+        LatticeValue b = instr.arg2.empty() ? a : valueOf(instr.arg2);
+        if (instr.op == IROpcode::AND || instr.op == IROpcode::OR) 
+        {
+            // false AND x and true OR x are known without x
+            long long absorbing = instr.op == IROpcode::OR;
+            if ((a.isConstant() && a.i == absorbing) || (b.isConstant() && b.i == absorbing))
+                return LatticeValue::ofBool(absorbing);
+        }
+        if (a.level == ConstantLevel::Bottom || b.level == ConstantLevel::Bottom) return LatticeValue::bottom();
+        if (a.level == ConstantLevel::Top || b.level == ConstantLevel::Top) return LatticeValue();
+        return fold(instr.op, a, b);
+    }
+    
+    void visitPhi(uint32_t b, size_t k) 
+    {
+        const SSABlock& block = function.blocks[b];
+        const PhiNode& phi = block.phis[k];
+        LatticeValue value;
+        for (size_t j = 0; j < phi.args.size(); j++) 
+        {
+            if (executable(block.preds[j], b)) value = meet(value, valueOf(phi.args[j]));
+        }
+        lower(phi.result, value);
+    }
+    
+    void visitInstruction(uint32_t b, size_t i) 
+    {
+        const SSABlock& block = function.blocks[b];
+        const IRInstruction& instr = block.code[i];
+        if (i + 1 < block.code.size()) 
+        {
+            if (definesResult(instr) && SSAFunction::isValue(instr.result)) lower(instr.result, evaluate(instr));
+            return;
+        }
+        if (instr.op == IROpcode::GOTO) markEdge(b, 0);
+        else if (isConditionalBranch(instr.op)) 
+        {
+            // a fused branch jumps when its comparison holds
+            bool fused = instr.op != IROpcode::IF_FALSE && instr.op != IROpcode::IF_TRUE;
+            LatticeValue condition = fused 
+                ? evaluate(IRInstruction(comparisonOf(instr.op), Operand(), instr.arg1, instr.arg2))
+                : valueOf(instr.arg1);
+            if (condition.isConstant()) 
+            {
+                bool jumps = (condition.i != 0) == (instr.op != IROpcode::IF_FALSE);
+                markEdge(b, jumps ? 1 : 0);
+            }
+            else if (condition.level == ConstantLevel::Bottom) 
+            {
+                markEdge(b, 0);
+                markEdge(b, 1);
+            }
+        }
+    }
+    
+    void visitBlock(uint32_t b) 
+    {
+        const SSABlock& block = function.blocks[b];
+        for (size_t k = 0; k < block.phis.size(); k++) visitPhi(b, k);
+        for (size_t i = 0; i < block.code.size(); i++) visitInstruction(b, i);
+    }
+    
+    void solve() 
+    {
+        blockExecutable[0] = 1;
+        visitBlock(0);
+        while (!flowWork.empty() || !ssaWork.empty()) 
+        {
+            while (!flowWork.empty()) 
+            {
+                auto edge = flowWork.back();
+                flowWork.pop_back();
+                uint32_t to = function.blocks[edge.first].succs[edge.second];
+                if (!blockExecutable[to]) 
+                {
+                    blockExecutable[to] = 1;
+                    visitBlock(to);
+                }
+                else 
+                {
+                    // only the phis see the new edge
+                    for (size_t k = 0; k < function.blocks[to].phis.size(); k++) visitPhi(to, k);
+                }
+            }
+            while (!ssaWork.empty()) 
+            {
+                uint32_t v = ssaWork.back();
+                ssaWork.pop_back();
+                for (const SSASite* use = function.usesBegin(v); use != function.usesEnd(v); use++) 
+                {
+                    if (!blockExecutable[use->block]) continue;
+                    if (use->isPhi()) visitPhi(use->block, use->phi);
+                    else visitInstruction(use->block, use->index);
+                }
+            }
+        }
+    }
+    
+    void rewrite(ConstantPropagationResult& result) 
+    {
+        vector<Operand> constants(values.size());
+        auto substitute = [&](Operand& operand) 
+        {
+            if (!SSAFunction::isValue(operand)) return;
+            const LatticeValue& value = values[operand.index()];
+            if (!value.isConstant()) return;
+            Operand& constant = constants[operand.index()];
+            if (constant.empty()) 
+            {
+                if (value.kind == OperandKind::Float) constant = code.floatConstant(value.f);
+                else if (value.kind == OperandKind::Bool) constant = code.boolConstant(value.i);
+                else constant = code.intConstant(value.i);
+            }
+            operand = constant;
+        };
+        auto folded = [&](Operand result) 
+        {
+            return SSAFunction::isValue(result) && values[result.index()].isConstant();
+        };
+        
+        for (uint32_t b = 0; b < function.blocks.size(); b++) 
+        {
+            if (!blockExecutable[b]) continue;
+            SSABlock& block = function.blocks[b];
+            size_t kept = 0;
+            for (size_t k = 0; k < block.phis.size(); k++) 
+            {
+                if (folded(block.phis[k].result)) 
+                {
+                    result.folded++;
+                    continue;
+                }
+                for (Operand& arg : block.phis[k].args) substitute(arg);
+                if (kept != k) block.phis[kept] = move(block.phis[k]);
+                kept++;
+            }
+            block.phis.resize(kept);
+            
+            kept = 0;
+            for (size_t i = 0; i < block.code.size(); i++) 
+            {
+                IRInstruction instr = block.code[i];
+                if (definesResult(instr) && instr.op != IROpcode::CALL && folded(instr.result)) 
+                {
+                    result.folded++;
+                    continue;
+                }
+                forEachUse(instr, substitute);
+                block.code[kept++] = instr;
+            }
+            block.code.erase(block.code.begin() + kept, block.code.end());
+        }
+        
+        // a branch keeps only the edges that can execute
+        for (uint32_t b = 0; b < function.blocks.size(); b++) 
+        {
+            if (!blockExecutable[b]) continue;
+            auto succs = function.blocks[b].succs;
+            uint32_t live = 0;
+            for (uint32_t k = 0; k < succs.size(); k++) live += edgeExecutable[edgeBase[b] + k];
+            if (live == 0 || live == succs.size()) continue;
+            for (uint32_t k = 0; k < succs.size(); k++) 
+            {
+                if (!edgeExecutable[edgeBase[b] + k]) function.removeEdge(b, succs[k]);
+            }
+            result.branches++;
+        }
+        result.unreachable = function.removeUnreachable();
+    }
+
+public:
+    ConstantPropagator(SSAFunction& fn, IRBuffer& buffer) : function(fn), code(buffer) {}
+    
+    ConstantPropagationResult run() 
+    {
+        size_t blockCount = function.blocks.size();
+        values.assign(function.valueCount(), LatticeValue());
+        blockExecutable.assign(blockCount, 0);
+        edgeBase.assign(blockCount + 1, 0);
+        for (size_t b = 0; b < blockCount; b++) edgeBase[b + 1] = edgeBase[b] + (uint32_t)function.blocks[b].succs.size();
+        edgeExecutable.assign(edgeBase[blockCount], 0);
+        function.computeDefUse();
+        
+        solve();
+        ConstantPropagationResult result;
+        rewrite(result);
+        return result;
+    }
+};
+
+ConstantPropagationResult propagateConstants(SSAFunction& function, IRBuffer& code) 
+{
+    return ConstantPropagator(function, code).run();
+}
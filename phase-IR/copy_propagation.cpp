@@ -0,0 +1,60 @@
+#include "passes.h"
+
+using namespace std;
+
+static bool isCopy(const IRInstruction& instr) 
+{
+    return (instr.op == IROpcode::COPY || instr.op == IROpcode::ASSIGN) &&
+           SSAFunction::isValue(instr.result) && instr.arg1.kind() != OperandKind::Global;
+}
+
+CopyPropagationResult propagateCopies(SSAFunction& function) 
+{
+    CopyPropagationResult result;
+    vector<Operand> source(function.valueCount());
+    for (const auto& block : function.blocks) 
+    {
+        for (const auto& instr : block.code) 
+        {
+            if (isCopy(instr)) source[instr.result.index()] = instr.arg1;
+        }
+    }
+    // a copy's source dominates it, so chains end
+    auto resolve = [&](Operand operand) 
+    {
+        while (SSAFunction::isValue(operand) && !source[operand.index()].empty())
+            operand = source[operand.index()];
+        return operand;
+    };
+    
+    for (auto& block : function.blocks) 
+    {
+        for (auto& phi : block.phis) 
+        {
+            for (Operand& arg : phi.args) arg = resolve(arg);
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < block.code.size(); i++) 
+        {
+            IRInstruction instr = block.code[i];
+            if (isCopy(instr)) 
+            {
+                // the computation feeding a variable takes the variable's
+                // name, so leaving SSA writes it there directly
+                Operand root = resolve(instr.arg1);
+                Operand& name = function.origin[instr.result.index()];
+                if (SSAFunction::isValue(root) && function.origin[root.index()].empty() && !name.empty()) 
+                {
+                    function.origin[root.index()] = name;
+                    result.coalesced++;
+                }
+                result.copies++;
+                continue;
+            }
+            forEachUse(instr, [&](Operand& operand) { operand = resolve(operand); });
+            block.code[kept++] = instr;
+        }
+        block.code.erase(block.code.begin() + kept, block.code.end());
+    }
+    return result;
+}
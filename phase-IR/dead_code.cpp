@@ -0,0 +1,139 @@
+#include "passes.h"
+#include <algorithm>
+
+using namespace std;
+
+static bool storesGlobal(const IRInstruction& instr) 
+{
+    return instr.result.kind() == OperandKind::Global && instr.op != IROpcode::LABEL;
+}
+
+// instructions kept for what they do rather than for the value they define
+static bool hasEffect(const IRInstruction& instr, const IRBuffer& code) 
+{
+    if (!definesResult(instr) || !SSAFunction::isValue(instr.result)) return true;
+    return instr.op == IROpcode::CALL || mayTrap(instr, code);
+}
+
+// Backward over a block: a global stored again later with no read, call or
+// return in between loses the earlier store.
+static size_t removeDeadStores(SSABlock& block) 
+{
+    size_t stores = 0;
+    for (const auto& instr : block.code) stores += storesGlobal(instr);
+    if (stores < 2) return 0;
+    
+    vector<Operand> overwritten;
+    vector<uint8_t> dead(block.code.size(), 0);
+    size_t removed = 0;
+    for (size_t i = block.code.size(); i-- > 0;) 
+    {
+        IRInstruction& instr = block.code[i];
+        if (instr.op == IROpcode::CALL || instr.op == IROpcode::RETURN || instr.op == IROpcode::FUNC_END) 
+        {
+            overwritten.clear();
+            continue;
+        }
+        if (storesGlobal(instr)) 
+        {
+            if (find(overwritten.begin(), overwritten.end(), instr.result) != overwritten.end()) 
+            {
+                dead[i] = 1;
+                removed++;
+                continue;
+            }
+            overwritten.push_back(instr.result);
+        }
+        forEachUse(instr, [&](Operand operand) 
+        {
+            if (operand.kind() != OperandKind::Global) return;
+            auto it = find(overwritten.begin(), overwritten.end(), operand);
+            if (it != overwritten.end()) overwritten.erase(it);
+        });
+    }
+    if (removed) 
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < block.code.size(); i++) 
+        {
+            if (!dead[i]) block.code[kept++] = block.code[i];
+        }
+        block.code.erase(block.code.begin() + kept, block.code.end());
+    }
+    return removed;
+}
+
+DeadCodeResult eliminateDeadCode(SSAFunction& function, const IRBuffer& code) 
+{
+    DeadCodeResult result;
+    result.unreachable = function.removeUnreachable();
+    for (auto& block : function.blocks) result.stores += removeDeadStores(block);
+    
+    // mark: liveness of every value, from the instructions with an effect
+    // back through the definitions of what they read, phis included, so
+    // values carried around loops settle in one pass
+    function.computeDefUse();
+    vector<uint8_t> live(function.valueCount(), 0);
+    vector<uint32_t> work;
+    auto markLive = [&](Operand operand) 
+    {
+        if (!SSAFunction::isValue(operand) || live[operand.index()]) return;
+        live[operand.index()] = 1;
+        work.push_back(operand.index());
+    };
+    for (auto& block : function.blocks) 
+    {
+        for (auto& instr : block.code) 
+        {
+            if (hasEffect(instr, code)) forEachUse(instr, markLive);
+        }
+    }
+    while (!work.empty()) 
+    {
+        const SSASite& def = function.definition(work.back());
+        work.pop_back();
+        SSABlock& block = function.blocks[def.block];
+        if (def.isPhi()) 
+        {
+            for (Operand arg : block.phis[def.phi].args) markLive(arg);
+        }
+        else if (def.index >= 0) forEachUse(block.code[def.index], markLive);
+    }
+    
+    // sweep
+    for (auto& block : function.blocks) 
+    {
+        size_t kept = 0;
+        for (size_t k = 0; k < block.phis.size(); k++) 
+        {
+            if (!live[block.phis[k].result.index()]) 
+            {
+                result.values++;
+                continue;
+            }
+            if (kept != k) block.phis[kept] = move(block.phis[k]);
+            kept++;
+        }
+        block.phis.resize(kept);
+        
+        kept = 0;
+        for (size_t i = 0; i < block.code.size(); i++) 
+        {
+            IRInstruction instr = block.code[i];
+            bool unused = SSAFunction::isValue(instr.result) && !live[instr.result.index()];
+            if (unused && instr.op == IROpcode::CALL) 
+            {
+                instr.result = Operand();
+                result.callResults++;
+            }
+            else if (unused && !hasEffect(instr, code)) 
+            {
+                result.values++;
+                continue;
+            }
+            block.code[kept++] = instr;
+        }
+        block.code.erase(block.code.begin() + kept, block.code.end());
+    }
+    return result;
+}
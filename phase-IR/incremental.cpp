@@ -0,0 +1,136 @@
+#include "incremental.h"
+#include "type_checker.h"
+#include "parser.h"
+#include <algorithm>
+#include <exception>
+#include <string_view>
+#include <unordered_set>
+
+using namespace std;
+
+static size_t bodyHashOf(const FunctionNode& func, const string& source) 
+{
+    size_t end = min((size_t)func.body->endPos, source.size());
+    return hash<string_view>{}(string_view(source).substr(func.pos, end - func.pos));
+}
+
+// the same name resolves the same way throughout one item
+static void dedupe(vector<GlobalLookup>& lookups) 
+{
+    auto key = [](const GlobalLookup& l) { return make_pair(l.name, l.function); };
+    sort(lookups.begin(), lookups.end(), [&](const GlobalLookup& a, const GlobalLookup& b) 
+    {
+        return key(a) < key(b);
+    });
+    lookups.erase(unique(lookups.begin(), lookups.end(), [&](const GlobalLookup& a, const GlobalLookup& b) 
+    {
+        return key(a) == key(b);
+    }), lookups.end());
+}
+
+static void rethrowFirst(const vector<exception_ptr>& errors) 
+{
+    for (const auto& error : errors) 
+    {
+        if (error) rethrow_exception(error);
+    }
+}
+
+bool IncrementalCompiler::reusable(const CachedFunction& entry, size_t bodyHash, int item) 
+{
+    if (entry.bodyHash != bodyHash) return false;
+    ScopeStack& scopes = bodyAnalyzer->getScopeStack();
+    scopes.setCurrentItem(item);
+    for (const auto& lookup : entry.lookups) 
+    {
+        if (!lookup.stillValid(scopes.lookup(lookup.name, lookup.function))) return false;
+    }
+    return true;
+}
+
+void IncrementalCompiler::build(shared_ptr<ProgramNode> program, const string& source) 
+{
+    const auto& items = program->items;
+    globalAnalyzer = make_unique<ScopeAnalyzer>();
+    globalAnalyzer->declareFunctions(program);
+    bodyAnalyzer = make_unique<ScopeAnalyzer>(&globalAnalyzer->getScopeStack());
+    ScopeStack& bodyScopes = bodyAnalyzer->getScopeStack();
+    
+    vector<exception_ptr> scopeErrors(items.size()), typeErrors(items.size());
+    vector<const CachedFunction*> reused(items.size(), nullptr);
+    vector<size_t> hashes(items.size(), 0);
+    vector<vector<GlobalLookup>> lookups(items.size());
+    TypeChecker checker;
+    functionCount = recheckedCount = 0;
+    
+    // items run in order, so a body sees exactly the globals declared before it
+    for (size_t i = 0; i < items.size(); i++) 
+    {
+        auto func = dynamic_pointer_cast<FunctionNode>(items[i]);
+        if (func) 
+        {
+            functionCount++;
+            hashes[i] = bodyHashOf(*func, source);
+            auto cached = cache.find(func->name);
+            if (cached != cache.end() && reusable(cached->second, hashes[i], (int)i)) 
+            {
+                reused[i] = &cached->second;
+                continue;
+            }
+            recheckedCount++;
+            bodyScopes.logGlobalLookups(&lookups[i]);
+        }
+        ScopeAnalyzer& analyzer = func ? *bodyAnalyzer : *globalAnalyzer;
+        try 
+        {
+            analyzer.analyzeItem(items[i], (int)i);
+        } 
+        catch (...) 
+        {
+            scopeErrors[i] = current_exception();
+            analyzer.resetScopes();
+        }
+        bodyScopes.logGlobalLookups(nullptr);
+        if (scopeErrors[i]) continue;
+        try 
+        {
+            checker.checkItem(items[i]);
+        } 
+        catch (...) 
+        {
+            typeErrors[i] = current_exception();
+        }
+    }
+    rethrowFirst(scopeErrors);
+    rethrowFirst(typeErrors);
+    
+    generator.clearInstructions();
+    unordered_set<string> live;
+    for (size_t i = 0; i < items.size(); i++) 
+    {
+        if (reused[i]) 
+        {
+            generator.appendCode(reused[i]->code);
+            live.insert(dynamic_pointer_cast<FunctionNode>(items[i])->name);
+            continue;
+        }
+        size_t start = generator.getCode().size();
+        generator.generateItem(items[i]);
+        if (auto func = dynamic_pointer_cast<FunctionNode>(items[i])) 
+        {
+            const IRBuffer& code = generator.getCode();
+            CachedFunction& entry = cache[func->name];
+            entry.bodyHash = hashes[i];
+            entry.lookups = move(lookups[i]);
+            dedupe(entry.lookups);
+            entry.code.clear();
+            for (size_t j = start; j < code.size(); j++) entry.code.push_back(code.at(j));
+            live.insert(func->name);
+        }
+    }
+    for (auto it = cache.begin(); it != cache.end(); ) 
+    {
+        if (live.count(it->first)) ++it;
+        else it = cache.erase(it);
+    }
+}
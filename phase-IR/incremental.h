@@ -0,0 +1,54 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "scope_analyzer.h"
+#include "ir.h"
+
+using namespace std;
+
+// Scope checking, type checking and lowering that carry over between edits
+// of one program. Each function is cached under a hash of its source text
+// plus every lookup its body made against the global table: the signatures
+// of the functions it calls, the globals it reads and the names it shadows.
+// A later build reuses the cached IR when the text is unchanged and every
+// recorded lookup still resolves to the same thing; only the other bodies
+// and the top-level statements are analysed and lowered again.
+class IncrementalCompiler 
+{
+private:
+    struct CachedFunction 
+    {
+        size_t bodyHash;
+        vector<GlobalLookup> lookups;
+        vector<IRInstruction> code;
+    };
+    
+    unordered_map<string, CachedFunction> cache;
+    // keeps its counters and operand tables across builds, so cached code
+    // stays meaningful and fresh temps and labels never collide with it
+    IRGenerator generator;
+    // analyzers of the latest build, kept alive because its AST points into
+    // their symbol arenas
+    unique_ptr<ScopeAnalyzer> globalAnalyzer;
+    unique_ptr<ScopeAnalyzer> bodyAnalyzer;
+    size_t functionCount;
+    size_t recheckedCount;
+    
+    bool reusable(const CachedFunction& entry, size_t bodyHash, int item);
+    
+public:
+    IncrementalCompiler() : functionCount(0), recheckedCount(0) {}
+    
+    // analyses and lowers one revision; throws the error a full build would
+    void build(shared_ptr<ProgramNode> program, const string& source);
+    const IRGenerator& getGenerator() const { return generator; }
+    IRGenerator& getGenerator() { return generator; }
+    size_t functions() const { return functionCount; }
+    size_t recheckedFunctions() const { return recheckedCount; }
+};
+
+#endif
@@ -0,0 +1,311 @@
+#include "passes.h"
+#include "loops.h"
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+// x * factor with x an induction variable, before (the phi) or after its step
+struct Product 
+{
+    Operand result, factor;
+    bool ofNext;
+};
+
+// A basic induction variable: a header phi entering as init and coming
+// back around every latch as next = phi + step. Other phis of the loop
+// stepping in lockstep with it are its aliases.
+struct InductionVariable 
+{
+    Operand phi, next, init, step;
+    vector<Operand> aliasPhis, aliasNexts;      // replaced by this one's phi and next
+    vector<Product> products;
+    vector<uint32_t> exitTests;         // blocks whose branch compares the variable
+    bool otherUses = false;             // read by anything else
+};
+
+// multiples of a basic variable: phi * factor, stepping by step * factor
+struct ReducedVariable 
+{
+    Operand phi, next, factor;
+};
+
+class InductionVariables 
+{
+private:
+    SSAFunction& function;
+    IRBuffer& code;
+    vector<Operand> replacement;        // per value: what its uses read instead
+    InductionVariableResult result;
+    
+    // whether a's defining instruction comes before b's on every path
+    bool definedBefore(Operand a, Operand b) const 
+    {
+        const SSASite& x = function.definition(a.index());
+        const SSASite& y = function.definition(b.index());
+        return x.block == y.block ? x.index < y.index : function.dominates(x.block, y.block);
+    }
+    
+    Operand multiply(Operand a, Operand b, uint32_t pre) 
+    {
+        if (isIntConstant(a) && isIntConstant(b))
+            return code.intConstant((long long)((unsigned long long)code.intValue(a) * (unsigned long long)code.intValue(b)));
+        if (isIntConstant(b)) swap(a, b);
+        if (isIntConstant(a) && code.intValue(a) == 0) return a;
+        if (isIntConstant(a) && code.intValue(a) == 1) return b;
+        Operand product = function.newValue();
+        vector<IRInstruction>& target = function.blocks[pre].code;
+        target.insert(target.end() - 1, IRInstruction(IROpcode::MUL_I, product, a, b));
+        return product;
+    }
+    
+    // the value a phi comes back around as, when every loop edge agrees
+    Operand loopArgument(const PhiNode& phi, uint32_t header, const vector<uint32_t>& mark, uint32_t stamp) const 
+    {
+        Operand next;
+        const vector<uint32_t>& preds = function.blocks[header].preds;
+        for (size_t j = 0; j < preds.size(); j++) 
+        {
+            if (mark[preds[j]] != stamp) continue;
+            if (!next.empty() && phi.args[j] != next) return Operand();
+            next = phi.args[j];
+        }
+        return next;
+    }
+    
+    void findVariables(const NaturalLoop& loop, uint32_t pre, const vector<uint32_t>& mark, uint32_t stamp,
+                       vector<InductionVariable>& found) 
+    {
+        auto invariant = [&](Operand operand) 
+        {
+            if (SSAFunction::isValue(operand)) return mark[function.definition(operand.index()).block] != stamp;
+            return operand.kind() != OperandKind::Global;
+        };
+        const SSABlock& header = function.blocks[loop.header];
+        size_t entry = find(header.preds.begin(), header.preds.end(), pre) - header.preds.begin();
+        size_t first = found.size();
+        for (const PhiNode& phi : header.phis) 
+        {
+            Operand next = loopArgument(phi, loop.header, mark, stamp);
+            if (!SSAFunction::isValue(next)) continue;
+            const SSASite& def = function.definition(next.index());
+            if (def.isPhi() || mark[def.block] != stamp) continue;
+            const IRInstruction& instr = function.blocks[def.block].code[def.index];
+            Operand step;
+            if (instr.op == IROpcode::ADD_I && instr.arg1 == phi.result && invariant(instr.arg2)) step = instr.arg2;
+            else if (instr.op == IROpcode::ADD_I && instr.arg2 == phi.result && invariant(instr.arg1)) step = instr.arg1;
+            else if (instr.op == IROpcode::SUB_I && instr.arg1 == phi.result && isIntConstant(instr.arg2))
+                step = code.intConstant((long long)(0 - (unsigned long long)code.intValue(instr.arg2)));
+            if (step.empty()) continue;
+            
+            // A variable in lockstep with one found already is redundant. The
+            // one stepped first survives, so its next is there for every
+            // use of the other's.
+            Operand value = phi.result, init = phi.args[entry];
+            auto same = find_if(found.begin() + first, found.end(), [&](const InductionVariable& iv) 
+            {
+                return iv.init == init && iv.step == step;
+            });
+            if (same != found.end() && (definedBefore(same->next, next) || definedBefore(next, same->next))) 
+            {
+                InductionVariable& kept = *same;
+                if (!definedBefore(kept.next, next)) 
+                {
+                    swap(kept.phi, value);
+                    swap(kept.next, next);
+                }
+                replacement[value.index()] = kept.phi;
+                replacement[next.index()] = kept.next;
+                kept.aliasPhis.push_back(value);
+                kept.aliasNexts.push_back(next);
+                result.eliminated++;
+                continue;
+            }
+            found.push_back({value, next, init, step, {}, {}, {}, {}, false});
+        }
+        
+        // what reads each variable: its own step, the phi, products by an
+        // invariant, exit tests, or something else that keeps it alive
+        for (size_t v = first; v < found.size(); v++) 
+        {
+            InductionVariable& iv = found[v];
+            vector<Operand> phis = iv.aliasPhis, nexts = iv.aliasNexts;
+            phis.push_back(iv.phi);
+            nexts.push_back(iv.next);
+            auto among = [](const vector<Operand>& list, Operand o) { return find(list.begin(), list.end(), o) != list.end(); };
+            vector<Operand> values = phis;
+            values.insert(values.end(), nexts.begin(), nexts.end());
+            for (Operand value : values) 
+            {
+                for (const SSASite* use = function.usesBegin(value.index()); use != function.usesEnd(value.index()); use++) 
+                {
+                    if (use->isPhi()) 
+                    {
+                        const PhiNode& phi = function.blocks[use->block].phis[use->phi];
+                        iv.otherUses = iv.otherUses || use->block != loop.header || !among(phis, phi.result);
+                        continue;
+                    }
+                    const SSABlock& block = function.blocks[use->block];
+                    const IRInstruction& instr = block.code[use->index];
+                    if (definesResult(instr) && among(nexts, instr.result)) continue;
+                    if (instr.op == IROpcode::MUL_I && mark[use->block] == stamp) 
+                    {
+                        Operand factor = instr.arg1 == value ? instr.arg2 : instr.arg1;
+                        if (invariant(factor) && factor != value) 
+                        {
+                            iv.products.push_back({instr.result, factor, among(nexts, value)});
+                            continue;
+                        }
+                    }
+                    if ((size_t)use->index + 1 == block.code.size() && isConditionalBranch(instr.op) &&
+                        instr.op != IROpcode::IF_FALSE && instr.op != IROpcode::IF_TRUE) 
+                    {
+                        iv.exitTests.push_back(use->block);
+                        continue;
+                    }
+                    iv.otherUses = true;
+                }
+            }
+        }
+    }
+    
+    // Linear function test replacement: the loop's one exit test, on the
+    // variable against a constant bound, moves onto a constant multiple of
+    // it, leaving the variable to its own step. The test
+    // runs on every trip, so the values seen stay between init and the
+    // bound, one step either side; their multiples must not overflow.
+    bool replaceTest(const NaturalLoop& loop, const InductionVariable& iv, const ReducedVariable& reduced,
+                     const vector<uint32_t>& mark, uint32_t stamp) 
+    {
+        if (iv.otherUses || iv.exitTests.size() != 1 || loop.exits.size() != 1) return false;
+        uint32_t b = iv.exitTests[0];
+        if (loop.exits[0] != b) return false;
+        for (uint32_t latch : loop.latches) 
+        {
+            if (!function.dominates(b, latch)) return false;
+        }
+        if (!isIntConstant(iv.init) || !isIntConstant(iv.step) || !isIntConstant(reduced.factor)) return false;
+        
+        IRInstruction& branch = function.blocks[b].terminator();
+        bool left = replaced(replacement, branch.arg1) == iv.phi || replaced(replacement, branch.arg1) == iv.next;
+        Operand bound = left ? branch.arg2 : branch.arg1;
+        IROpcode compare = comparisonOf(branch.op);
+        if (!isIntConstant(bound) || compare < IROpcode::LT_I || compare > IROpcode::GE_I) return false;
+        
+        // the relation variable-to-bound that keeps the loop going
+        static const IROpcode flipped[] = {IROpcode::GT_I, IROpcode::GE_I, IROpcode::LT_I, IROpcode::LE_I};
+        IROpcode written = compare;
+        if (!left) compare = flipped[(int)compare - (int)IROpcode::LT_I];
+        if (mark[function.blocks[b].succs[1]] != stamp) 
+        {
+            static const IROpcode negated[] = {IROpcode::GE_I, IROpcode::GT_I, IROpcode::LE_I, IROpcode::LT_I};
+            compare = negated[(int)compare - (int)IROpcode::LT_I];
+        }
+        long long init = code.intValue(iv.init), step = code.intValue(iv.step);
+        long long factor = code.intValue(reduced.factor), limit = code.intValue(bound);
+        bool upward = compare == IROpcode::LT_I || compare == IROpcode::LE_I;
+        if (factor == 0 || step == 0 || (step > 0) != upward) return false;
+        __int128 reach = (__int128)max(llabs(init), llabs(limit)) + llabs(step) + 1;
+        if (reach * llabs(factor) >= ((__int128)1 << 62)) return false;
+        
+        // a negative factor turns the order around
+        if (factor < 0) branch.op = branchOn(flipped[(int)written - (int)IROpcode::LT_I]);
+        Operand& variable = left ? branch.arg1 : branch.arg2;
+        variable = replaced(replacement, variable) == iv.phi ? reduced.phi : reduced.next;
+        (left ? branch.arg2 : branch.arg1) = code.intConstant(limit * factor);
+        return true;
+    }
+    
+    void reduce(const NaturalLoop& loop, uint32_t pre, InductionVariable& iv, const vector<uint32_t>& mark, uint32_t stamp) 
+    {
+        if (iv.products.empty()) return;
+        result.reduced += iv.products.size();
+        const SSASite& def = function.definition(iv.next.index());
+        uint32_t stepBlock = def.block;
+        
+        vector<ReducedVariable> reduced;
+        for (const auto& product : iv.products) 
+        {
+            Operand factor = product.factor;
+            auto it = find_if(reduced.begin(), reduced.end(), [&](const ReducedVariable& r) { return r.factor == factor; });
+            if (it == reduced.end()) 
+            {
+                Operand init = multiply(iv.init, factor, pre);
+                Operand step = multiply(iv.step, factor, pre);
+                // named i*k after the variable, so its phi and step coalesce
+                Operand name, variable = function.origin[iv.phi.index()];
+                if (!variable.empty()) name = code.variable(code.name(variable) + "*" + code.text(factor));
+                ReducedVariable r = {function.newValue(name), function.newValue(name), factor};
+                SSABlock& header = function.blocks[loop.header];
+                PhiNode phi = {r.phi, {}};
+                for (uint32_t p : header.preds) phi.args.push_back(p == pre ? init : r.next);
+                header.phis.push_back(phi);
+                
+                // stepped right where the variable itself is
+                vector<IRInstruction>& instrs = function.blocks[stepBlock].code;
+                size_t at = 0;
+                while (!definesResult(instrs[at]) || instrs[at].result != iv.next) at++;
+                instrs.insert(instrs.begin() + at + 1, IRInstruction(IROpcode::ADD_I, r.next, r.phi, step));
+                reduced.push_back(r);
+                it = reduced.end() - 1;
+            }
+            replacement[product.result.index()] = product.ofNext ? it->next : it->phi;
+        }
+        for (const ReducedVariable& r : reduced) 
+        {
+            if (replaceTest(loop, iv, r, mark, stamp)) 
+            {
+                // the variable is left to die, and the multiple takes its name
+                function.origin[r.phi.index()] = function.origin[r.next.index()] = function.origin[iv.phi.index()];
+                result.eliminated++;
+                break;
+            }
+        }
+    }
+
+public:
+    InductionVariables(SSAFunction& fn, IRBuffer& buffer) : function(fn), code(buffer) {}
+    
+    InductionVariableResult run() 
+    {
+        function.computeDominators();
+        vector<NaturalLoop> loops = findLoops(function);
+        if (loops.empty()) return result;
+        for (const auto& loop : loops) insertPreheader(function, loop);
+        function.computeDominators();
+        loops = findLoops(function);
+        function.computeDefUse();
+        replacement.assign(function.valueCount(), Operand());
+        
+        // every loop is read before any is changed, so def-use stays valid
+        vector<uint32_t> mark(function.blocks.size(), 0);
+        vector<vector<InductionVariable>> variables(loops.size());
+        vector<uint32_t> preheaders(loops.size(), 0);
+        for (size_t l = 0; l < loops.size(); l++) 
+        {
+            const NaturalLoop& loop = loops[l];
+            if (loop.header == 0) continue;
+            uint32_t stamp = (uint32_t)l + 1;
+            for (uint32_t b : loop.blocks) mark[b] = stamp;
+            for (uint32_t p : function.blocks[loop.header].preds) 
+            {
+                if (mark[p] != stamp) preheaders[l] = p;
+            }
+            findVariables(loop, preheaders[l], mark, stamp, variables[l]);
+            result.found += variables[l].size();
+        }
+        for (size_t l = 0; l < loops.size(); l++) 
+        {
+            uint32_t stamp = (uint32_t)l + 1;
+            for (uint32_t b : loops[l].blocks) mark[b] = stamp;
+            for (auto& iv : variables[l]) reduce(loops[l], preheaders[l], iv, mark, stamp);
+        }
+        function.replaceValues(replacement);
+        return result;
+    }
+};
+
+InductionVariableResult reduceInductionVariables(SSAFunction& function, IRBuffer& code) 
+{
+    return InductionVariables(function, code).run();
+}
@@ -0,0 +1,345 @@
+#include "interpreter.h"
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+static const int MaxDepth = 20000;
+
+void Interpreter::decodeUnit(const vector<size_t>& indices, uint32_t id) 
+{
+    unordered_map<uint32_t, uint32_t> frameSlots;
+    unordered_map<uint32_t, uint32_t> labels;
+    vector<pair<size_t, uint32_t>> jumps;
+    auto slot = [&](Operand operand) -> Slot 
+    {
+        Slot s;
+        switch (operand.kind()) 
+        {
+            case OperandKind::Temp:
+            case OperandKind::Var:
+                s.space = Space::Frame;
+                s.index = frameSlots.emplace(operand.raw(), (uint32_t)frameSlots.size()).first->second;
+                break;
+            case OperandKind::Global: 
+            {
+                auto inserted = globalSlots.emplace(operand.raw(), (uint32_t)globals.size());
+                if (inserted.second) globals.emplace_back();
+                s.space = Space::Global;
+                s.index = inserted.first->second;
+                break;
+            }
+            case OperandKind::Int:
+            case OperandKind::LongInt:
+            case OperandKind::Float:
+            case OperandKind::Bool:
+            case OperandKind::String: 
+            {
+                auto inserted = constantSlots.emplace(operand.raw(), (uint32_t)constants.size());
+                if (inserted.second) 
+                {
+                    RuntimeValue value;
+                    value.kind = operand.kind() == OperandKind::LongInt ? OperandKind::Int : operand.kind();
+                    if (value.kind == OperandKind::Float) value.f = code.floatValue(operand);
+                    else if (value.kind == OperandKind::Int) value.i = code.intValue(operand);
+                    else value.i = operand.index();
+                    constants.push_back(value);
+                }
+                s.space = Space::Constant;
+                s.index = inserted.first->second;
+                break;
+            }
+            default:
+                break;
+        }
+        return s;
+    };
+    
+    uint32_t entry = (uint32_t)program.size();
+    for (size_t i : indices) 
+    {
+        IRInstruction instr = code.at(i);
+        if (instr.op == IROpcode::LABEL) 
+        {
+            labels[instr.result.index()] = (uint32_t)program.size();
+            continue;
+        }
+        Decoded d;
+        d.op = instr.op;
+        if (instr.op == IROpcode::GOTO || isConditionalBranch(instr.op)) 
+        {
+            jumps.push_back({program.size(), instr.result.index()});
+        }
+        else if (instr.op == IROpcode::CALL) 
+        {
+            auto callee = functionIds.emplace(instr.arg1.raw(), (uint32_t)functions.size());
+            if (callee.second) 
+            {
+                functions.emplace_back();
+                functions.back().name = instr.arg1;
+            }
+            d.target = callee.first->second;
+            d.count = (uint32_t)code.intValue(instr.arg2);
+            d.result = slot(instr.result);
+            program.push_back(d);
+            continue;
+        }
+        else 
+        {
+            d.result = slot(instr.result);
+        }
+        d.a = slot(instr.arg1);
+        d.b = slot(instr.arg2);
+        program.push_back(d);
+    }
+    if (program.size() == entry || program.back().op != IROpcode::FUNC_END) 
+    {
+        Decoded end;
+        end.op = IROpcode::FUNC_END;
+        program.push_back(end);
+    }
+    
+    for (auto& jump : jumps) 
+    {
+        auto it = labels.find(jump.second);
+        if (it == labels.end()) throw InterpreterError("jump to undefined label L" + to_string(jump.second));
+        program[jump.first].target = it->second;
+    }
+    
+    // calls above may have added functions, so it is looked up only now
+    Function& function = functions[id];
+    function.entry = entry;
+    function.frameSize = (uint32_t)frameSlots.size();
+    function.defined = true;
+    if (!function.name.empty()) 
+    {
+        for (Operand param : code.parameters(function.name)) 
+        {
+            auto it = frameSlots.find(param.raw());
+            function.params.push_back(it == frameSlots.end() ? -1 : (int32_t)it->second);
+        }
+    }
+}
+
+uint32_t Interpreter::decode() 
+{
+    // function ids first, so calls decode before their callee's body
+    vector<pair<uint32_t, vector<size_t>>> bodies;
+    vector<size_t> topLevel;
+    for (size_t i = 0; i < code.size(); i++) 
+    {
+        if (code.op(i) != IROpcode::FUNC_BEGIN) 
+        {
+            topLevel.push_back(i);
+            continue;
+        }
+        Operand name = code.result(i);
+        auto id = functionIds.emplace(name.raw(), (uint32_t)functions.size());
+        if (id.second) 
+        {
+            functions.emplace_back();
+            functions.back().name = name;
+        }
+        vector<size_t> body;
+        for (i++; i < code.size(); i++) 
+        {
+            body.push_back(i);
+            if (code.op(i) == IROpcode::FUNC_END) break;
+        }
+        bodies.push_back({id.first->second, move(body)});
+    }
+    for (auto& body : bodies) decodeUnit(body.second, body.first);
+    uint32_t topLevelId = (uint32_t)functions.size();
+    functions.emplace_back();
+    decodeUnit(topLevel, topLevelId);
+    return topLevelId;
+}
+
+int Interpreter::compareStrings(const RuntimeValue& a, const RuntimeValue& b) const 
+{
+    return code.text(Operand(OperandKind::String, (uint32_t)a.i))
+        .compare(code.text(Operand(OperandKind::String, (uint32_t)b.i)));
+}
+
+RuntimeValue Interpreter::call(uint32_t id, size_t argumentBase) 
+{
+    const Function& function = functions[id];
+    if (!function.defined) throw InterpreterError("call to undefined function " + code.name(function.name));
+    if (depth >= MaxDepth) throw InterpreterError("call depth exceeds " + to_string(MaxDepth));
+    depth++;
+    
+    vector<RuntimeValue> frame(function.frameSize);
+    size_t count = arguments.size() - argumentBase;
+    for (size_t k = 0; k < function.params.size() && k < count; k++) 
+    {
+        if (function.params[k] >= 0) frame[function.params[k]] = arguments[argumentBase + k];
+    }
+    arguments.resize(argumentBase);
+    
+    auto get = [&](const Slot& s) -> const RuntimeValue& 
+    {
+        if (s.space == Space::Frame) return frame[s.index];
+        return s.space == Space::Global ? globals[s.index] : constants[s.index];
+    };
+    auto set = [&](const Slot& s) -> RuntimeValue& 
+    {
+        return s.space == Space::Frame ? frame[s.index] : globals[s.index];
+    };
+    auto setInt = [&](const Slot& s, unsigned long long value) 
+    {
+        RuntimeValue& r = set(s);
+        r.kind = OperandKind::Int;
+        r.i = (long long)value;
+    };
+    auto setFloat = [&](const Slot& s, double value) 
+    {
+        RuntimeValue& r = set(s);
+        r.kind = OperandKind::Float;
+        r.f = value;
+    };
+    auto setBool = [&](const Slot& s, bool value) 
+    {
+        RuntimeValue& r = set(s);
+        r.kind = OperandKind::Bool;
+        r.i = value;
+    };
+    // the untyped comparisons: strings by content, bools by value
+    auto compare = [&](const RuntimeValue& a, const RuntimeValue& b) 
+    {
+        if (a.kind == OperandKind::String && b.kind == OperandKind::String) return compareStrings(a, b);
+        return a.i < b.i ? -1 : a.i > b.i ? 1 : 0;
+    };
+    
+    typedef unsigned long long U;
+    size_t pc = function.entry;
+    for (;;) 
+    {
+        const Decoded& d = program[pc++];
+        dispatches++;
+        switch (d.op) 
+        {
+            case IROpcode::ADD_I: setInt(d.result, (U)get(d.a).i + (U)get(d.b).i); break;
+            case IROpcode::SUB_I: setInt(d.result, (U)get(d.a).i - (U)get(d.b).i); break;
+            case IROpcode::MUL_I: setInt(d.result, (U)get(d.a).i * (U)get(d.b).i); break;
+            case IROpcode::DIV_I: 
+            {
+                long long a = get(d.a).i, b = get(d.b).i;
+                if (b == 0) throw InterpreterError("division by zero");
+                setInt(d.result, b == -1 ? 0 - (U)a : (U)(a / b));
+                break;
+            }
+            case IROpcode::ADD_F: setFloat(d.result, get(d.a).f + get(d.b).f); break;
+            case IROpcode::SUB_F: setFloat(d.result, get(d.a).f - get(d.b).f); break;
+            case IROpcode::MUL_F: setFloat(d.result, get(d.a).f * get(d.b).f); break;
+            case IROpcode::DIV_F: setFloat(d.result, get(d.a).f / get(d.b).f); break;
+            case IROpcode::NEG_I: setInt(d.result, 0 - (U)get(d.a).i); break;
+            case IROpcode::NEG_F: setFloat(d.result, -get(d.a).f); break;
+            case IROpcode::NOT: setBool(d.result, !get(d.a).i); break;
+            case IROpcode::I2F: setFloat(d.result, (double)get(d.a).i); break;
+            case IROpcode::F2I: 
+            {
+                double f = get(d.a).f;
+                if (!(f >= -9223372036854775808.0 && f < 9223372036854775808.0))
+                    throw InterpreterError("float out of int range");
+                setInt(d.result, (U)(long long)f);
+                break;
+            }
+            case IROpcode::EQ_I: setBool(d.result, get(d.a).i == get(d.b).i); break;
+            case IROpcode::NE_I: setBool(d.result, get(d.a).i != get(d.b).i); break;
+            case IROpcode::LT_I: setBool(d.result, get(d.a).i < get(d.b).i); break;
+            case IROpcode::LE_I: setBool(d.result, get(d.a).i <= get(d.b).i); break;
+            case IROpcode::GT_I: setBool(d.result, get(d.a).i > get(d.b).i); break;
+            case IROpcode::GE_I: setBool(d.result, get(d.a).i >= get(d.b).i); break;
+            case IROpcode::EQ_F: setBool(d.result, get(d.a).f == get(d.b).f); break;
+            case IROpcode::NE_F: setBool(d.result, get(d.a).f != get(d.b).f); break;
+            case IROpcode::LT_F: setBool(d.result, get(d.a).f < get(d.b).f); break;
+            case IROpcode::LE_F: setBool(d.result, get(d.a).f <= get(d.b).f); break;
+            case IROpcode::GT_F: setBool(d.result, get(d.a).f > get(d.b).f); break;
+            case IROpcode::GE_F: setBool(d.result, get(d.a).f >= get(d.b).f); break;
+            case IROpcode::EQ_B: setBool(d.result, get(d.a).i == get(d.b).i); break;
+            case IROpcode::NE_B: setBool(d.result, get(d.a).i != get(d.b).i); break;
+            case IROpcode::EQ: setBool(d.result, compare(get(d.a), get(d.b)) == 0); break;
+            case IROpcode::NE: setBool(d.result, compare(get(d.a), get(d.b)) != 0); break;
+            case IROpcode::LT: setBool(d.result, compare(get(d.a), get(d.b)) < 0); break;
+            case IROpcode::LE: setBool(d.result, compare(get(d.a), get(d.b)) <= 0); break;
+            case IROpcode::GT: setBool(d.result, compare(get(d.a), get(d.b)) > 0); break;
+            case IROpcode::GE: setBool(d.result, compare(get(d.a), get(d.b)) >= 0); break;
+            case IROpcode::AND: setBool(d.result, get(d.a).i && get(d.b).i); break;
+            case IROpcode::OR: setBool(d.result, get(d.a).i || get(d.b).i); break;
+            case IROpcode::ASSIGN:
+            case IROpcode::COPY: set(d.result) = get(d.a); break;
+            case IROpcode::GOTO: pc = d.target; break;
+            case IROpcode::IF_FALSE: if (!get(d.a).i) pc = d.target; break;
+            case IROpcode::IF_TRUE: if (get(d.a).i) pc = d.target; break;
+            case IROpcode::IF_EQ_I: if (get(d.a).i == get(d.b).i) pc = d.target; break;
+            case IROpcode::IF_NE_I: if (get(d.a).i != get(d.b).i) pc = d.target; break;
+            case IROpcode::IF_LT_I: if (get(d.a).i < get(d.b).i) pc = d.target; break;
+            case IROpcode::IF_LE_I: if (get(d.a).i <= get(d.b).i) pc = d.target; break;
+            case IROpcode::IF_GT_I: if (get(d.a).i > get(d.b).i) pc = d.target; break;
+            case IROpcode::IF_GE_I: if (get(d.a).i >= get(d.b).i) pc = d.target; break;
+            case IROpcode::IF_EQ_F: if (get(d.a).f == get(d.b).f) pc = d.target; break;
+            case IROpcode::IF_NE_F: if (get(d.a).f != get(d.b).f) pc = d.target; break;
+            case IROpcode::IF_LT_F: if (get(d.a).f < get(d.b).f) pc = d.target; break;
+            case IROpcode::IF_LE_F: if (get(d.a).f <= get(d.b).f) pc = d.target; break;
+            case IROpcode::IF_GT_F: if (get(d.a).f > get(d.b).f) pc = d.target; break;
+            case IROpcode::IF_GE_F: if (get(d.a).f >= get(d.b).f) pc = d.target; break;
+            case IROpcode::PARAM: arguments.push_back(get(d.a)); break;
+            case IROpcode::CALL: 
+            {
+                RuntimeValue value = call(d.target, arguments.size() - d.count);
+                if (d.result.space != Space::None) set(d.result) = value;
+                break;
+            }
+            case IROpcode::RETURN: 
+            {
+                depth--;
+                if (d.a.space == Space::None) return RuntimeValue{OperandKind::None};
+                return get(d.a);
+            }
+            case IROpcode::FUNC_END:
+                depth--;
+                return RuntimeValue{OperandKind::None};
+            default:
+                break;
+        }
+    }
+}
+
+bool Interpreter::run(RuntimeValue& result) 
+{
+    uint32_t topLevel = decode();
+    call(topLevel, 0);
+    for (uint32_t id = 0; id < functions.size(); id++) 
+    {
+        if (id != topLevel && functions[id].defined && code.name(functions[id].name) == "main") 
+        {
+            result = call(id, 0);
+            return true;
+        }
+    }
+    return false;
+}
+
+string Interpreter::format(const RuntimeValue& value) const 
+{
+    switch (value.kind) 
+    {
+        case OperandKind::Int: return to_string(value.i);
+        case OperandKind::Bool: return value.i ? "true" : "false";
+        case OperandKind::String: return code.text(Operand(OperandKind::String, (uint32_t)value.i));
+        case OperandKind::Float: 
+        {
+            // the shortest spelling that reads back as the same double
+            char text[32];
+            for (int precision = 1; precision <= 17; precision++) 
+            {
+                snprintf(text, sizeof text, "%.*g", precision, value.f);
+                if (strtod(text, nullptr) == value.f) break;
+            }
+            return text;
+        }
+        default: return "nothing";
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ir.h"
+
+using namespace std;
+
+class InterpreterError : public exception 
+{
+    string msg;
+
+public:
+    explicit InterpreterError(const string& message) : msg("Runtime error: " + message) {}
+    
+    const char* what() const noexcept override 
+    {
+        return msg.c_str();
+    }
+};
+
+// A value at run time: kind is Int, Float, Bool or String (an index into
+// the buffer's strings), or None for a function that returned nothing.
+// Variables read before any assignment hold int 0.
+struct RuntimeValue 
+{
+    OperandKind kind = OperandKind::Int;
+    long long i = 0;
+    double f = 0;
+};
+
+// Runs a program's TAC. The buffer is decoded once into a flat array:
+// labels become instruction indices, a function's temps and variables
+// slots of its frame, globals and constants slots of their own tables.
+// The top-level code runs first, then main. Every instruction executed
+// counts as one dispatch; labels and FUNC_BEGIN are not instructions here.
+class Interpreter 
+{
+private:
+    enum class Space : uint8_t { None, Frame, Global, Constant };
+    
+    struct Slot 
+    {
+        Space space = Space::None;
+        uint32_t index = 0;
+    };
+    
+    struct Decoded 
+    {
+        IROpcode op;
+        Slot result, a, b;
+        uint32_t target = 0;    // jump target, or the callee of a CALL
+        uint32_t count = 0;     // a CALL's argument count
+    };
+    
+    struct Function 
+    {
+        Operand name;
+        uint32_t entry = 0;
+        uint32_t frameSize = 0;
+        vector<int32_t> params; // frame slot per parameter, -1 when never read
+        bool defined = false;
+    };
+    
+    const IRBuffer& code;
+    vector<Decoded> program;
+    vector<Function> functions;     // by id; the top-level code has no name
+    vector<RuntimeValue> globals;
+    vector<RuntimeValue> constants;
+    unordered_map<uint32_t, uint32_t> functionIds, globalSlots, constantSlots;  // by raw operand
+    vector<RuntimeValue> arguments; // PARAM values waiting for their CALL
+    uint64_t dispatches = 0;
+    int depth = 0;
+    
+    uint32_t decode();     // returns the top-level code's function id
+    void decodeUnit(const vector<size_t>& indices, uint32_t id);
+    RuntimeValue call(uint32_t function, size_t argumentBase);
+    int compareStrings(const RuntimeValue& a, const RuntimeValue& b) const;
+
+public:
+    explicit Interpreter(const IRBuffer& buffer) : code(buffer) {}
+    
+    // runs the top-level code and main; false when there is no main
+    bool run(RuntimeValue& result);
+    string format(const RuntimeValue& value) const;
+    uint64_t dispatchCount() const { return dispatches; }
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include "passes.h"
+#include "loops.h"
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+bool mayTrap(const IRInstruction& instr, const IRBuffer& code) 
+{
+    if (instr.op == IROpcode::DIV_I) return !(isIntConstant(instr.arg2) && code.intValue(instr.arg2) != 0);
+    if (instr.op != IROpcode::F2I) return false;
+    if (instr.arg1.kind() != OperandKind::Float) return true;
+    double f = code.floatValue(instr.arg1);
+    return !(f >= -9223372036854775808.0 && f < 9223372036854775808.0);
+}
+
+unordered_map<uint32_t, CallEffect> findCallEffects(const IRBuffer& code) 
+{
+    unordered_map<uint32_t, CallEffect> effects;
+    unordered_map<uint32_t, vector<uint32_t>> callees;
+    for (size_t i = 0; i < code.size(); i++) 
+    {
+        if (code.op(i) != IROpcode::FUNC_BEGIN) continue;
+        uint32_t f = code.result(i).index();
+        CallEffect effect = CallEffect::Pure;
+        for (i++; code.op(i) != IROpcode::FUNC_END; i++) 
+        {
+            if (code.result(i).kind() == OperandKind::Global) effect = CallEffect::WritesGlobals;
+            else if (code.arg1(i).kind() == OperandKind::Global || code.arg2(i).kind() == OperandKind::Global)
+                effect = max(effect, CallEffect::ReadsGlobals);
+            if (code.op(i) == IROpcode::CALL) callees[f].push_back(code.arg1(i).index());
+        }
+        effects[f] = effect;
+    }
+    
+    // a caller does whatever its callees do; a function never defined may do anything
+    bool changed = true;
+    while (changed) 
+    {
+        changed = false;
+        for (auto& entry : effects) 
+        {
+            for (uint32_t callee : callees[entry.first]) 
+            {
+                auto it = effects.find(callee);
+                CallEffect effect = it == effects.end() ? CallEffect::WritesGlobals : it->second;
+                if (effect <= entry.second) continue;
+                entry.second = effect;
+                changed = true;
+            }
+        }
+    }
+    return effects;
+}
+
+InvariantMotionResult hoistInvariants(SSAFunction& function, const IRBuffer& code, const unordered_map<uint32_t, CallEffect>& effects) 
+{
+    InvariantMotionResult result;
+    auto effectOf = [&](Operand callee) 
+    {
+        auto it = effects.find(callee.index());
+        return it == effects.end() ? CallEffect::WritesGlobals : it->second;
+    };
+    function.computeDominators();
+    vector<NaturalLoop> loops = findLoops(function);
+    if (loops.empty()) return result;
+    for (const auto& loop : loops) insertPreheader(function, loop);
+    function.computeDominators();
+    loops = findLoops(function);
+    result.loops = loops.size();
+    
+    vector<int32_t> defBlock(function.valueCount(), -1);
+    for (uint32_t b = 0; b < function.blocks.size(); b++) 
+    {
+        for (const auto& phi : function.blocks[b].phis) defBlock[phi.result.index()] = (int32_t)b;
+        for (const auto& instr : function.blocks[b].code) 
+        {
+            if (definesResult(instr) && SSAFunction::isValue(instr.result)) defBlock[instr.result.index()] = (int32_t)b;
+        }
+    }
+    
+    // Inner loops first, so what leaves an inner loop lands in a preheader
+    // that belongs to the loop around it and can move on from there.
+    vector<uint8_t> inLoop(function.blocks.size(), 0);
+    for (const auto& loop : loops) 
+    {
+        if (loop.header == 0) continue;
+        for (uint32_t b : loop.blocks) inLoop[b] = 1;
+        uint32_t pre = 0;
+        for (uint32_t p : function.blocks[loop.header].preds) 
+        {
+            if (!inLoop[p]) pre = p;
+        }
+        
+        // globals hold still in a loop that stores none and calls nothing that does
+        bool globalsChange = false;
+        for (uint32_t b : loop.blocks) 
+        {
+            for (const auto& instr : function.blocks[b].code) 
+            {
+                if (instr.result.kind() == OperandKind::Global ||
+                    (instr.op == IROpcode::CALL && effectOf(instr.arg1) == CallEffect::WritesGlobals))
+                    globalsChange = true;
+            }
+        }
+        auto invariant = [&](Operand operand) 
+        {
+            if (SSAFunction::isValue(operand)) return !inLoop[defBlock[operand.index()]];
+            return operand.kind() != OperandKind::Global || !globalsChange;
+        };
+        auto hoist = [&](const IRInstruction& instr) 
+        {
+            vector<IRInstruction>& target = function.blocks[pre].code;
+            target.insert(target.end() - 1, instr);
+            if (definesResult(instr) && SSAFunction::isValue(instr.result)) defBlock[instr.result.index()] = (int32_t)pre;
+            result.hoisted++;
+        };
+        
+        for (uint32_t b : loop.blocks) 
+        {
+            // a block that runs on every trip may keep operations that can fail
+            bool everyTrip = true;
+            for (uint32_t x : loop.latches) everyTrip = everyTrip && function.dominates(b, x);
+            for (uint32_t x : loop.exits) everyTrip = everyTrip && function.dominates(b, x);
+            
+            vector<IRInstruction>& instrs = function.blocks[b].code;
+            vector<IRInstruction> kept;
+            kept.reserve(instrs.size());
+            for (size_t i = 0; i + 1 < instrs.size(); i++) 
+            {
+                const IRInstruction& instr = instrs[i];
+                if (instr.op == IROpcode::CALL) 
+                {
+                    // A call that stores no global and reads none the loop
+                    // changes is pure here; it goes with the PARAMs right before it.
+                    size_t n = (size_t)code.intValue(instr.arg2);
+                    CallEffect effect = effectOf(instr.arg1);
+                    bool pure = effect == CallEffect::Pure || (effect == CallEffect::ReadsGlobals && !globalsChange);
+                    bool movable = everyTrip && pure && kept.size() >= n;
+                    for (size_t k = kept.size() - min(n, kept.size()); movable && k < kept.size(); k++) 
+                    {
+                        movable = kept[k].op == IROpcode::PARAM && invariant(kept[k].arg1);
+                    }
+                    if (!movable) 
+                    {
+                        kept.push_back(instr);
+                        continue;
+                    }
+                    for (size_t k = kept.size() - n; k < kept.size(); k++) hoist(kept[k]);
+                    kept.erase(kept.end() - n, kept.end());
+                    hoist(instr);
+                    result.calls++;
+                    continue;
+                }
+                if (instr.op > IROpcode::COPY || !SSAFunction::isValue(instr.result) ||
+                    (!everyTrip && mayTrap(instr, code)) || !invariant(instr.arg1) || !invariant(instr.arg2)) 
+                {
+                    kept.push_back(instr);
+                    continue;
+                }
+                hoist(instr);
+            }
+            kept.push_back(instrs.back());
+            instrs = move(kept);
+        }
+        for (uint32_t b : loop.blocks) inLoop[b] = 0;
+    }
+    return result;
+}
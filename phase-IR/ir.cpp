@@ -1,19 +1,41 @@
 #include "ir.h"
 #include "parser.h"
 #include <iomanip>
+#include <cstdio>
 
 using namespace std;
 
-string opcodeToString(IROpcode op) 
+const char* opcodeToString(IROpcode op) 
 {
     switch(op) 
     {
-        case IROpcode::ADD: return "ADD";
-        case IROpcode::SUB: return "SUB";
-        case IROpcode::MUL: return "MUL";
-        case IROpcode::DIV: return "DIV";
-        case IROpcode::NEG: return "NEG";
+        case IROpcode::ADD_I: return "ADD_I";
+        case IROpcode::SUB_I: return "SUB_I";
+        case IROpcode::MUL_I: return "MUL_I";
+        case IROpcode::DIV_I: return "DIV_I";
+        case IROpcode::ADD_F: return "ADD_F";
+        case IROpcode::SUB_F: return "SUB_F";
+        case IROpcode::MUL_F: return "MUL_F";
+        case IROpcode::DIV_F: return "DIV_F";
+        case IROpcode::NEG_I: return "NEG_I";
+        case IROpcode::NEG_F: return "NEG_F";
         case IROpcode::NOT: return "NOT";
+        case IROpcode::I2F: return "I2F";
+        case IROpcode::F2I: return "F2I";
+        case IROpcode::EQ_I: return "EQ_I";
+        case IROpcode::NE_I: return "NE_I";
+        case IROpcode::LT_I: return "LT_I";
+        case IROpcode::LE_I: return "LE_I";
+        case IROpcode::GT_I: return "GT_I";
+        case IROpcode::GE_I: return "GE_I";
+        case IROpcode::EQ_F: return "EQ_F";
+        case IROpcode::NE_F: return "NE_F";
+        case IROpcode::LT_F: return "LT_F";
+        case IROpcode::LE_F: return "LE_F";
+        case IROpcode::GT_F: return "GT_F";
+        case IROpcode::GE_F: return "GE_F";
+        case IROpcode::EQ_B: return "EQ_B";
+        case IROpcode::NE_B: return "NE_B";
         case IROpcode::EQ: return "EQ";
         case IROpcode::NE: return "NE";
         case IROpcode::LT: return "LT";
@@ -28,6 +50,18 @@ string opcodeToString(IROpcode op)
         case IROpcode::GOTO: return "GOTO";
         case IROpcode::IF_FALSE: return "IF_FALSE";
         case IROpcode::IF_TRUE: return "IF_TRUE";
+        case IROpcode::IF_EQ_I: return "IF_EQ_I";
+        case IROpcode::IF_NE_I: return "IF_NE_I";
+        case IROpcode::IF_LT_I: return "IF_LT_I";
+        case IROpcode::IF_LE_I: return "IF_LE_I";
+        case IROpcode::IF_GT_I: return "IF_GT_I";
+        case IROpcode::IF_GE_I: return "IF_GE_I";
+        case IROpcode::IF_EQ_F: return "IF_EQ_F";
+        case IROpcode::IF_NE_F: return "IF_NE_F";
+        case IROpcode::IF_LT_F: return "IF_LT_F";
+        case IROpcode::IF_LE_F: return "IF_LE_F";
+        case IROpcode::IF_GT_F: return "IF_GT_F";
+        case IROpcode::IF_GE_F: return "IF_GE_F";
         case IROpcode::PARAM: return "PARAM";
         case IROpcode::CALL: return "CALL";
         case IROpcode::RETURN: return "RETURN";
@@ -37,159 +71,424 @@ string opcodeToString(IROpcode op)
     return "UNKNOWN";
 }
 
-void IRInstruction::print(ostream& os) const 
+bool isConditionalBranch(IROpcode op) 
 {
-    string opStr = opcodeToString(op);
+    return op >= IROpcode::IF_FALSE && op <= IROpcode::IF_GE_F;
+}
+
+IROpcode branchOn(IROpcode comparison) 
+{
+    if (comparison < IROpcode::EQ_I || comparison > IROpcode::GE_F) return IROpcode::GOTO;
+    return IROpcode((int)IROpcode::IF_EQ_I + ((int)comparison - (int)IROpcode::EQ_I));
+}
+
+IROpcode comparisonOf(IROpcode branch) 
+{
+    return IROpcode((int)IROpcode::EQ_I + ((int)branch - (int)IROpcode::IF_EQ_I));
+}
+
+IROpcode negatedBranch(IROpcode op) 
+{
+    switch (op) 
+    {
+        case IROpcode::IF_FALSE: return IROpcode::IF_TRUE;
+        case IROpcode::IF_TRUE: return IROpcode::IF_FALSE;
+        case IROpcode::IF_EQ_I: return IROpcode::IF_NE_I;
+        case IROpcode::IF_NE_I: return IROpcode::IF_EQ_I;
+        case IROpcode::IF_LT_I: return IROpcode::IF_GE_I;
+        case IROpcode::IF_GE_I: return IROpcode::IF_LT_I;
+        case IROpcode::IF_LE_I: return IROpcode::IF_GT_I;
+        case IROpcode::IF_GT_I: return IROpcode::IF_LE_I;
+        case IROpcode::IF_EQ_F: return IROpcode::IF_NE_F;
+        case IROpcode::IF_NE_F: return IROpcode::IF_EQ_F;
+        default: return op;
+    }
+}
+
+bool isCommutative(IROpcode op) 
+{
+    switch (op) 
+    {
+        case IROpcode::ADD_I: case IROpcode::MUL_I:
+        case IROpcode::ADD_F: case IROpcode::MUL_F:
+        case IROpcode::EQ_I: case IROpcode::NE_I:
+        case IROpcode::EQ_F: case IROpcode::NE_F:
+        case IROpcode::EQ_B: case IROpcode::NE_B:
+        case IROpcode::EQ: case IROpcode::NE:
+        case IROpcode::AND: case IROpcode::OR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint32_t IRBuffer::intern(const string& name) 
+{
+    auto it = nameIndex.find(name);
+    if (it != nameIndex.end()) return it->second;
+    uint32_t index = (uint32_t)names.size();
+    names.push_back(name);
+    nameIndex.emplace(name, index);
+    return index;
+}
+
+Operand IRBuffer::intConstant(long long value) 
+{
+    if (Operand::fitsInline(value)) return Operand(OperandKind::Int, (uint32_t)value);
+    longInts.push_back(value);
+    return Operand(OperandKind::LongInt, (uint32_t)(longInts.size() - 1));
+}
+
+// keeps the spelling so dumps show the literal as written
+Operand IRBuffer::floatConstant(const string& spelling) 
+{
+    floats.push_back(strtod(spelling.c_str(), nullptr));
+    floatSpellings.push_back(spelling);
+    return Operand(OperandKind::Float, (uint32_t)(floats.size() - 1));
+}
+
+// a computed value gets the shortest spelling that reads back exactly
+Operand IRBuffer::floatConstant(double value) 
+{
+    char spelling[32];
+    for (int digits = 1; digits <= 17; digits++) 
+    {
+        snprintf(spelling, sizeof spelling, "%.*g", digits, value);
+        if (strtod(spelling, nullptr) == value) break;
+    }
+    string text = spelling;
+    if (text.find_first_of(".e") == string::npos) text += ".0";
+    floats.push_back(value);
+    floatSpellings.push_back(text);
+    return Operand(OperandKind::Float, (uint32_t)(floats.size() - 1));
+}
+
+Operand IRBuffer::stringConstant(const string& value) 
+{
+    strings.push_back(value);
+    return Operand(OperandKind::String, (uint32_t)(strings.size() - 1));
+}
+
+long long IRBuffer::intValue(Operand operand) const 
+{
+    if (operand.kind() == OperandKind::LongInt) return longInts[operand.index()];
+    return operand.inlineInt();
+}
+
+void IRBuffer::push_back(const IRInstruction& instr) 
+{
+    ops.push_back(instr.op);
+    results.push_back(instr.result);
+    args1.push_back(instr.arg1);
+    args2.push_back(instr.arg2);
+}
+
+const vector<Operand>& IRBuffer::parameters(Operand function) const 
+{
+    static const vector<Operand> none;
+    auto it = params.find(function.index());
+    return it == params.end() ? none : it->second;
+}
+
+void IRBuffer::clear() 
+{
+    ops.clear();
+    results.clear();
+    args1.clear();
+    args2.clear();
+}
+
+void IRBuffer::writeOperand(OutputBuffer& out, Operand operand) const 
+{
+    switch (operand.kind()) 
+    {
+        case OperandKind::None: break;
+        case OperandKind::Temp: out << 't' << (long long)operand.index(); break;
+        case OperandKind::Label: out << 'L' << (long long)operand.index(); break;
+        case OperandKind::Var:
+        case OperandKind::Global:
+        case OperandKind::Func: out << names[operand.index()]; break;
+        case OperandKind::Int:
+        case OperandKind::LongInt: out << intValue(operand); break;
+        case OperandKind::Float: out << floatSpellings[operand.index()]; break;
+        case OperandKind::Bool: out << (operand.index() ? "true" : "false"); break;
+        case OperandKind::String: out << strings[operand.index()]; break;
+    }
+}
+
+string IRBuffer::text(Operand operand) const 
+{
+    switch (operand.kind()) 
+    {
+        case OperandKind::None: return "";
+        case OperandKind::Temp: return "t" + to_string(operand.index());
+        case OperandKind::Label: return "L" + to_string(operand.index());
+        case OperandKind::Var:
+        case OperandKind::Global:
+        case OperandKind::Func: return names[operand.index()];
+        case OperandKind::Int:
+        case OperandKind::LongInt: return to_string(intValue(operand));
+        case OperandKind::Float: return floatSpellings[operand.index()];
+        case OperandKind::Bool: return operand.index() ? "true" : "false";
+        case OperandKind::String: return strings[operand.index()];
+    }
+    return "";
+}
+
+void IRBuffer::dump(OutputBuffer& out, const IRInstruction& instr) const 
+{
+    IROpcode op = instr.op;
+    Operand result = instr.result, arg1 = instr.arg1, arg2 = instr.arg2;
+    const char* opStr = opcodeToString(op);
+    auto put = [&](Operand operand) { writeOperand(out, operand); };
     
     switch(op) 
     {
         case IROpcode::LABEL:
-            os << result << ":";
+            put(result); out << ":";
             break;
             
         case IROpcode::GOTO:
-            os << "  GOTO " << result;
+            out << "  GOTO "; put(result);
             break;
             
         case IROpcode::IF_FALSE:
-            os << "  IF_FALSE " << arg1 << " GOTO " << result;
+            out << "  IF_FALSE "; put(arg1); out << " GOTO "; put(result);
             break;
             
         case IROpcode::IF_TRUE:
-            os << "  IF_TRUE " << arg1 << " GOTO " << result;
+            out << "  IF_TRUE "; put(arg1); out << " GOTO "; put(result);
+            break;
+            
+        case IROpcode::IF_EQ_I: case IROpcode::IF_NE_I: case IROpcode::IF_LT_I:
+        case IROpcode::IF_LE_I: case IROpcode::IF_GT_I: case IROpcode::IF_GE_I:
+        case IROpcode::IF_EQ_F: case IROpcode::IF_NE_F: case IROpcode::IF_LT_F:
+        case IROpcode::IF_LE_F: case IROpcode::IF_GT_F: case IROpcode::IF_GE_F:
+            out << "  " << opStr << " "; put(arg1); out << ", "; put(arg2); out << " GOTO "; put(result);
             break;
             
         case IROpcode::FUNC_BEGIN:
-            os << "\nFUNCTION " << result << ":";
+            out << "\nFUNCTION "; put(result); out << ":";
             break;
             
         case IROpcode::FUNC_END:
-            os << "END_FUNCTION " << result;
+            out << "END_FUNCTION "; put(result);
             break;
             
         case IROpcode::PARAM:
-            os << "  PARAM " << arg1;
+            out << "  PARAM "; put(arg1);
             break;
             
         case IROpcode::CALL:
-            if (!result.empty())
-                os << "  " << result << " = CALL " << arg1 << ", " << arg2;
-            else
-                os << "  CALL " << arg1 << ", " << arg2;
+            out << "  ";
+            if (!result.empty()) 
+            {
+                put(result); out << " = ";
+            }
+            out << "CALL "; put(arg1); out << ", "; put(arg2);
             break;
             
         case IROpcode::RETURN:
-            if (!arg1.empty())
-                os << "  RETURN " << arg1;
-            else
-                os << "  RETURN";
+            out << "  RETURN";
+            if (!arg1.empty()) 
+            {
+                out << " "; put(arg1);
+            }
             break;
             
-        case IROpcode::NEG:
+        case IROpcode::NEG_I:
+        case IROpcode::NEG_F:
         case IROpcode::NOT:
-            os << "  " << result << " = " << opStr << " " << arg1;
+        case IROpcode::I2F:
+        case IROpcode::F2I:
+            out << "  "; put(result); out << " = " << opStr << " "; put(arg1);
             break;
             
         case IROpcode::COPY:
-            os << "  " << result << " = " << arg1;
+            out << "  "; put(result); out << " = "; put(arg1);
             break;
             
         default:
             
-            if (!arg2.empty())
-                os << "  " << result << " = " << arg1 << " " << opStr << " " << arg2;
-            else
-                os << "  " << result << " = " << opStr << " " << arg1;
+            out << "  "; put(result); out << " = ";
+            if (!arg2.empty()) 
+            {
+                put(arg1); out << " " << opStr << " "; put(arg2);
+            }
+            else 
+            {
+                out << opStr << " "; put(arg1);
+            }
             break;
     }
 }
 
-string IRGenerator::newTemp() 
+void IRBuffer::dumpJson(OutputBuffer& out, size_t i) const 
+{
+    out << "{\"op\":\"" << opcodeToString(ops[i]) << '"';
+    if (!results[i].empty()) 
+    {
+        out << ",\"result\":";
+        out.jsonString(text(results[i]));
+    }
+    if (!args1[i].empty()) 
+    {
+        out << ",\"arg1\":";
+        out.jsonString(text(args1[i]));
+    }
+    if (!args2[i].empty()) 
+    {
+        out << ",\"arg2\":";
+        out.jsonString(text(args2[i]));
+    }
+    out << '}';
+}
+
+Operand IRGenerator::newTemp() 
 {
-    return "t" + to_string(tempCounter++);
+    return Operand(OperandKind::Temp, tempCounter++);
 }
 
-string IRGenerator::newLabel() 
+Operand IRGenerator::newLabel() 
 {
-    return "L" + to_string(labelCounter++);
+    return Operand(OperandKind::Label, labelCounter++);
 }
 
 void IRGenerator::emit(const IRInstruction& instr) 
 {
-    instructions.push_back(instr);
+    invalidateCache(instr.op, instr.result);
+    code.push_back(instr);
 }
 
-void IRGenerator::emit(IROpcode op, const string& result, 
-                       const string& arg1, const string& arg2) 
+void IRGenerator::emit(IROpcode op, Operand result, Operand arg1, Operand arg2) 
 {
-    instructions.push_back(IRInstruction(op, result, arg1, arg2));
+    invalidateCache(op, result);
+    code.push_back(IRInstruction(op, result, arg1, arg2));
 }
 
-void IRGenerator::generate(shared_ptr<ProgramNode> program) 
+static void collectReads(const AST& node, vector<const IdentifierNode*>& reads) 
 {
-    genProgram(program);
+    if (auto id = dynamic_pointer_cast<IdentifierNode>(node)) 
+    {
+        reads.push_back(id.get());
+    } 
+    else if (auto binOp = dynamic_pointer_cast<BinaryOpNode>(node)) 
+    {
+        collectReads(binOp->left, reads);
+        collectReads(binOp->right, reads);
+    } 
+    else if (auto unOp = dynamic_pointer_cast<UnaryOpNode>(node)) 
+    {
+        collectReads(unOp->operand, reads);
+    }
+}
+
+// globals live at scope level 0; everything else belongs to the current function
+Operand IRGenerator::variableOf(const SymbolInfo* symbol) 
+{
+    if (symbol->scopeLevel == 0) return code.global(symbol->uniqueName);
+    return code.variable(symbol->uniqueName);
 }
 
-void IRGenerator::printIR(ostream& os) const 
+void IRGenerator::cacheExpr(const AST& node, Operand result) 
 {
-    os << "\n=== THREE ADDRESS CODE (TAC) ===" << endl;
-    for (const auto& instr : instructions) 
+    vector<const IdentifierNode*> reads;
+    collectReads(node, reads);
+    exprCache[node.get()] = result;
+    for (const IdentifierNode* id : reads) 
     {
-        instr.print(os);
-        os << endl;
+        cacheReaders[variableOf(id->symbol).raw()].push_back(node.get());
     }
-    os << "================================\n" << endl;
 }
 
-void IRGenerator::genProgram(shared_ptr<ProgramNode> node) 
+void IRGenerator::invalidateCache(IROpcode op, Operand result) 
 {
+    if (exprCache.empty()) return;
     
-    for (const auto& item : node->items) 
+    if (op == IROpcode::LABEL || op == IROpcode::CALL || 
+        op == IROpcode::FUNC_BEGIN || op == IROpcode::FUNC_END) 
     {
-        if (auto func = dynamic_pointer_cast<FunctionNode>(item)) 
+        exprCache.clear();
+        cacheReaders.clear();
+    } 
+    else if (op == IROpcode::COPY) 
+    {
+        auto it = cacheReaders.find(result.raw());
+        if (it == cacheReaders.end()) return;
+        for (const ASTNode* reader : it->second) 
         {
-            vector<string> paramTypes;
-            for (const auto& param : func->params) 
-            {
-                paramTypes.push_back(param.first);
-            }
-            scopeStack.addFunction(func->name, func->retType, paramTypes);
+            exprCache.erase(reader);
         }
+        cacheReaders.erase(it);
     }
-    
-    
-    for (const auto& item : node->items) 
+}
+
+void IRGenerator::generate(shared_ptr<ProgramNode> program) 
+{
+    genProgram(program);
+}
+
+void IRGenerator::printIR(ostream& os, DumpFormat format) const 
+{
+    OutputBuffer out(os);
+    if (format == DumpFormat::JsonLines) 
     {
-        if (auto func = dynamic_pointer_cast<FunctionNode>(item)) 
+        for (size_t i = 0; i < code.size(); i++) 
         {
-            genFunction(func);
-        } 
-        else 
-        {
-            
-            if (auto varDecl = dynamic_pointer_cast<VarDeclNode>(item)) 
-            {
-                genVarDecl(varDecl);
-            }
+            code.dumpJson(out, i);
+            out << '\n';
         }
+        return;
     }
+    out << "\n=== THREE ADDRESS CODE (TAC) ===\n";
+    for (size_t i = 0; i < code.size(); i++) 
+    {
+        code.dump(out, i);
+        out << '\n';
+    }
+    out << "================================\n\n";
 }
 
-void IRGenerator::genFunction(shared_ptr<FunctionNode> node) 
+void IRGenerator::generateItem(const AST& item) 
 {
-    currentFunction = node->name;
-    
-    emit(IROpcode::FUNC_BEGIN, node->name);
-    
-    scopeStack.enterScope();
-    
-    
-    for (const auto& param : node->params) 
+    if (auto func = dynamic_pointer_cast<FunctionNode>(item)) 
+    {
+        genFunction(func);
+    } 
+    else 
     {
-        scopeStack.addSymbol(param.second, param.first, false);
         
+        if (auto varDecl = dynamic_pointer_cast<VarDeclNode>(item)) 
+        {
+            genVarDecl(varDecl);
+        }
+    }
+}
+
+void IRGenerator::appendCode(const vector<IRInstruction>& instrs) 
+{
+    for (const auto& instr : instrs) code.push_back(instr);
+    exprCache.clear();
+    cacheReaders.clear();
+}
+
+void IRGenerator::genProgram(shared_ptr<ProgramNode> node) 
+{
+    for (const auto& item : node->items) 
+    {
+        generateItem(item);
     }
+}
+
+void IRGenerator::genFunction(shared_ptr<FunctionNode> node) 
+{
+    currentFunction = node->name;
+    currentReturnType = node->retType;
     
+    emit(IROpcode::FUNC_BEGIN, code.function(node->name));
+    vector<Operand> params;
+    for (const SymbolInfo* param : node->paramSymbols) params.push_back(variableOf(param));
+    code.setParameters(code.function(node->name), move(params));
     
     for (const auto& stmt : node->body->stmts) 
     {
@@ -219,15 +518,11 @@ void IRGenerator::genFunction(shared_ptr<FunctionNode> node)
         }
     }
     
-    scopeStack.exitScope();
-    
-    emit(IROpcode::FUNC_END, node->name);
+    emit(IROpcode::FUNC_END, code.function(node->name));
 }
 
 void IRGenerator::genBlock(shared_ptr<BlockNode> node) 
 {
-    scopeStack.enterScope();
-    
     for (const auto& stmt : node->stmts) 
     {
         if (auto varDecl = dynamic_pointer_cast<VarDeclNode>(stmt)) 
@@ -255,28 +550,23 @@ void IRGenerator::genBlock(shared_ptr<BlockNode> node)
             genBlock(block);
         }
     }
-    
-    scopeStack.exitScope();
 }
 
 void IRGenerator::genVarDecl(shared_ptr<VarDeclNode> node) 
 {
     if (node->init) 
     {
-        string initValue = genExpression(node->init);
-        emit(IROpcode::COPY, node->name, initValue);
+        Operand initValue = genExpressionAs(node->init, node->typeName);
+        emit(IROpcode::COPY, variableOf(node->symbol), initValue);
     }
-    
-    
-    scopeStack.addSymbol(node->name, node->typeName, false);
 }
 
 void IRGenerator::genReturn(shared_ptr<ReturnNode> node) 
 {
     if (node->expr) 
     {
-        string retValue = genExpression(node->expr);
-        emit(IROpcode::RETURN, "", retValue);
+        Operand retValue = genExpressionAs(node->expr, currentReturnType);
+        emit(IROpcode::RETURN, Operand(), retValue);
     } 
     else 
     {
@@ -286,20 +576,10 @@ void IRGenerator::genReturn(shared_ptr<ReturnNode> node)
 
 void IRGenerator::genIf(shared_ptr<IfNode> node) 
 {
-    string condResult = genExpression(node->cond);
+    Operand elseLabel = newLabel();
+    Operand endLabel = newLabel();
     
-    string elseLabel = newLabel();
-    string endLabel = newLabel();
-    
-    
-    if (node->elseBlock) 
-    {
-        emit(IROpcode::IF_FALSE, elseLabel, condResult);
-    } 
-    else 
-    {
-        emit(IROpcode::IF_FALSE, endLabel, condResult);
-    }
+    genBranch(node->cond, node->elseBlock ? elseLabel : endLabel, false);
     
     
     genBlock(node->thenBlock);
@@ -314,20 +594,33 @@ void IRGenerator::genIf(shared_ptr<IfNode> node)
     emit(IROpcode::LABEL, endLabel);
 }
 
+// Loops are rotated into a guarded do-while: the condition is tested once
+// on entry and again at the bottom of the body, so an iteration takes one
+// branch and the loop has a single latch. A condition too large to lower
+// twice is tested at the bottom only, and entry jumps straight to it.
+static const size_t MaxCopiedCondition = 16;
+
 void IRGenerator::genWhile(shared_ptr<WhileNode> node) 
 {
-    string startLabel = newLabel();
-    string endLabel = newLabel();
-    
-    emit(IROpcode::LABEL, startLabel);
-    
-    string condResult = genExpression(node->cond);
-    emit(IROpcode::IF_FALSE, endLabel, condResult);
+    Operand exitLabel = newLabel();     // after the loop, or at the test when it is not copied
+    bool copied = countASTNodes(node->cond) <= MaxCopiedCondition;
+    
+    if (copied) genBranch(node->cond, exitLabel, false);
+    else emit(IROpcode::GOTO, exitLabel);
+    // a guard ending in a label of its own (past an ||) already marks the body
+    Operand bodyLabel;
+    if (code.size() > 0 && code.op(code.size() - 1) == IROpcode::LABEL) bodyLabel = code.result(code.size() - 1);
+    else 
+    {
+        bodyLabel = newLabel();
+        emit(IROpcode::LABEL, bodyLabel);
+    }
     
     genBlock(node->body);
     
-    emit(IROpcode::GOTO, startLabel);
-    emit(IROpcode::LABEL, endLabel);
+    if (!copied) emit(IROpcode::LABEL, exitLabel);
+    genBranch(node->cond, bodyLabel, true);
+    if (copied) emit(IROpcode::LABEL, exitLabel);
 }
 
 void IRGenerator::genExprStmt(shared_ptr<ExprStmtNode> node) 
@@ -335,9 +628,93 @@ void IRGenerator::genExprStmt(shared_ptr<ExprStmtNode> node)
     genExpression(node->expr);
 }
 
-string IRGenerator::genExpression(AST node) 
+// Picks the comparison opcode for operands of the given (common) type.
+static IROpcode comparisonOpcode(const string& op, TypeId type) 
 {
-    if (!node) return "";
+    static const IROpcode table[][6] = 
+    {
+        { IROpcode::EQ_I, IROpcode::NE_I, IROpcode::LT_I, IROpcode::LE_I, IROpcode::GT_I, IROpcode::GE_I },
+        { IROpcode::EQ_F, IROpcode::NE_F, IROpcode::LT_F, IROpcode::LE_F, IROpcode::GT_F, IROpcode::GE_F },
+        { IROpcode::EQ_B, IROpcode::NE_B, IROpcode::LT, IROpcode::LE, IROpcode::GT, IROpcode::GE },
+        { IROpcode::EQ, IROpcode::NE, IROpcode::LT, IROpcode::LE, IROpcode::GT, IROpcode::GE },
+    };
+    int row = type == TypeId::Int ? 0 : type == TypeId::Float ? 1 : type == TypeId::Bool ? 2 : 3;
+    int col;
+    if (op == "==") col = 0;
+    else if (op == "!=") col = 1;
+    else if (op == "<") col = 2;
+    else if (op == "<=") col = 3;
+    else if (op == ">") col = 4;
+    else col = 5;
+    return table[row][col];
+}
+
+static bool isComparison(const string& op) 
+{
+    return op == "==" || op == "!=" || op == "<" || op == "<=" || op == ">" || op == ">=";
+}
+
+static bool isLogical(const AST& node, const char* op) 
+{
+    auto binOp = dynamic_pointer_cast<BinaryOpNode>(node);
+    return binOp && binOp->op == op;
+}
+
+// && and || become jumps: the right operand runs only when the left one
+// leaves the outcome open, and no bool is materialized along the way.
+// Int and float comparisons become fused branches.
+void IRGenerator::genBranch(const AST& cond, Operand target, bool jumpIf) 
+{
+    bool isAnd = isLogical(cond, "&&");
+    if (isAnd || isLogical(cond, "||")) 
+    {
+        auto binOp = static_pointer_cast<BinaryOpNode>(cond);
+        // the left operand decides alone when it is false for &&, true for ||
+        bool decides = !isAnd;
+        if (decides == jumpIf) 
+        {
+            genBranch(binOp->left, target, jumpIf);
+            genBranch(binOp->right, target, jumpIf);
+        } 
+        else 
+        {
+            Operand skip = newLabel();
+            genBranch(binOp->left, skip, decides);
+            genBranch(binOp->right, target, jumpIf);
+            emit(IROpcode::LABEL, skip);
+        }
+        return;
+    }
+    
+    // an int or float comparison branches on its operands directly
+    auto binOp = dynamic_pointer_cast<BinaryOpNode>(cond);
+    if (binOp && isComparison(binOp->op) && !(binOp->shared && exprCache.count(binOp.get()))) 
+    {
+        TypeId operandType = promoteTypes(binOp->left->type, binOp->right->type);
+        IROpcode branch = branchOn(comparisonOpcode(binOp->op, operandType));
+        if (branch != IROpcode::GOTO) 
+        {
+            Operand left = genExpressionAs(binOp->left, operandType);
+            Operand right = genExpressionAs(binOp->right, operandType);
+            if (jumpIf || negatedBranch(branch) != branch) 
+            {
+                emit(jumpIf ? branch : negatedBranch(branch), target, left, right);
+                return;
+            }
+            // a float ordering has no negation, so it jumps over the jump
+            Operand skip = newLabel();
+            emit(branch, skip, left, right);
+            emit(IROpcode::GOTO, target);
+            emit(IROpcode::LABEL, skip);
+            return;
+        }
+    }
+    emit(jumpIf ? IROpcode::IF_TRUE : IROpcode::IF_FALSE, target, genExpression(cond));
+}
+
+Operand IRGenerator::genExpression(AST node) 
+{
+    if (!node) return Operand();
     
     if (auto binOp = dynamic_pointer_cast<BinaryOpNode>(node)) 
     {
@@ -364,50 +741,104 @@ string IRGenerator::genExpression(AST node)
         return genAssignment(assign);
     }
     
-    return "";
+    return Operand();
+}
+
+// Picks the arithmetic opcode for op ("+", "-=", ...) at int or float type.
+static IROpcode arithmeticOpcode(const string& op, TypeId type) 
+{
+    bool f = type == TypeId::Float;
+    switch (op[0]) 
+    {
+        case '-': return f ? IROpcode::SUB_F : IROpcode::SUB_I;
+        case '*': return f ? IROpcode::MUL_F : IROpcode::MUL_I;
+        case '/': return f ? IROpcode::DIV_F : IROpcode::DIV_I;
+        default: return f ? IROpcode::ADD_F : IROpcode::ADD_I;
+    }
 }
 
-string IRGenerator::genBinaryOp(shared_ptr<BinaryOpNode> node) 
+// Converts an already lowered value between int and float; literals are
+// converted in place instead of through an instruction.
+Operand IRGenerator::convert(Operand value, TypeId from, TypeId to) 
 {
-    string left = genExpression(node->left);
-    string right = genExpression(node->right);
-    string result = newTemp();
+    if (from == to || !isNumericType(from) || !isNumericType(to)) return value;
     
-    IROpcode op;
-    if (node->op == "+") op = IROpcode::ADD;
-    else if (node->op == "-") op = IROpcode::SUB;
-    else if (node->op == "*") op = IROpcode::MUL;
-    else if (node->op == "/") op = IROpcode::DIV;
-    else if (node->op == "==") op = IROpcode::EQ;
-    else if (node->op == "!=") op = IROpcode::NE;
-    else if (node->op == "<") op = IROpcode::LT;
-    else if (node->op == "<=") op = IROpcode::LE;
-    else if (node->op == ">") op = IROpcode::GT;
-    else if (node->op == ">=") op = IROpcode::GE;
-    else if (node->op == "&&") op = IROpcode::AND;
-    else if (node->op == "||") op = IROpcode::OR;
-    else op = IROpcode::ADD; 
+    IROpcode op = to == TypeId::Float ? IROpcode::I2F : IROpcode::F2I;
+    Operand result = newTemp();
+    emit(op, result, value);
+    return result;
+}
+
+Operand IRGenerator::genExpressionAs(const AST& node, TypeId type) 
+{
+    if (node->type == type || !isNumericType(type) || !isNumericType(node->type)) 
+        return genExpression(node);
+    
+    if (auto lit = dynamic_pointer_cast<LiteralNode>(node)) 
+    {
+        if (type == TypeId::Float) return code.floatConstant(lit->value + ".0");
+        return code.intConstant((long long)stod(lit->value));
+    }
+    return convert(genExpression(node), node->type, type);
+}
+
+Operand IRGenerator::genBinaryOp(shared_ptr<BinaryOpNode> node) 
+{
+    if (node->shared) 
+    {
+        auto it = exprCache.find(node.get());
+        if (it != exprCache.end()) return it->second;
+    }
+    
+    if (node->op == "&&" || node->op == "||") 
+    {
+        // as a value: the left operand, replaced by the right one unless it
+        // already settles the result
+        Operand result = newTemp();
+        Operand endLabel = newLabel();
+        emit(IROpcode::COPY, result, genExpression(node->left));
+        emit(node->op == "&&" ? IROpcode::IF_FALSE : IROpcode::IF_TRUE, endLabel, result);
+        emit(IROpcode::COPY, result, genExpression(node->right));
+        emit(IROpcode::LABEL, endLabel);
+        return result;
+    }
+    
+    // comparisons work at the operands' common type, arithmetic at the result type
+    TypeId operandType = isComparison(node->op) 
+        ? promoteTypes(node->left->type, node->right->type) : node->type;
+    IROpcode op = isComparison(node->op) 
+        ? comparisonOpcode(node->op, operandType) : arithmeticOpcode(node->op, operandType);
+    Operand left = genExpressionAs(node->left, operandType);
+    Operand right = genExpressionAs(node->right, operandType);
+    Operand result = newTemp();
     
     emit(op, result, left, right);
+    if (node->shared) cacheExpr(node, result);
     return result;
 }
 
-string IRGenerator::genUnaryOp(shared_ptr<UnaryOpNode> node) 
+Operand IRGenerator::genUnaryOp(shared_ptr<UnaryOpNode> node) 
 {
-    string operand = genExpression(node->operand);
+    if (node->shared && node->op == "-") 
+    {
+        auto it = exprCache.find(node.get());
+        if (it != exprCache.end()) return it->second;
+    }
+    
+    Operand operand = genExpression(node->operand);
     
     if (node->op == "++" || node->op == "--") 
     {
         
-        string one = "1";
-        IROpcode op = (node->op == "++") ? IROpcode::ADD : IROpcode::SUB;
+        Operand one = node->type == TypeId::Float ? code.floatConstant("1.0") : code.intConstant(1);
+        IROpcode op = arithmeticOpcode(node->op == "++" ? "+" : "-", node->type);
         
         if (node->postfix) 
         {
             
-            string temp = newTemp();
+            Operand temp = newTemp();
             emit(IROpcode::COPY, temp, operand);
-            string result = newTemp();
+            Operand result = newTemp();
             emit(op, result, operand, one);
             emit(IROpcode::COPY, operand, result);
             return temp; 
@@ -415,7 +846,7 @@ string IRGenerator::genUnaryOp(shared_ptr<UnaryOpNode> node)
         else 
         {
             
-            string result = newTemp();
+            Operand result = newTemp();
             emit(op, result, operand, one);
             emit(IROpcode::COPY, operand, result);
             return result;
@@ -423,13 +854,14 @@ string IRGenerator::genUnaryOp(shared_ptr<UnaryOpNode> node)
     } 
     else if (node->op == "-") 
     {
-        string result = newTemp();
-        emit(IROpcode::NEG, result, operand);
+        Operand result = newTemp();
+        emit(node->type == TypeId::Float ? IROpcode::NEG_F : IROpcode::NEG_I, result, operand);
+        if (node->shared) cacheExpr(node, result);
         return result;
     } 
     else if (node->op == "!") 
     {
-        string result = newTemp();
+        Operand result = newTemp();
         emit(IROpcode::NOT, result, operand);
         return result;
     }
@@ -437,61 +869,66 @@ string IRGenerator::genUnaryOp(shared_ptr<UnaryOpNode> node)
     return operand;
 }
 
-string IRGenerator::genLiteral(shared_ptr<LiteralNode> node) 
+Operand IRGenerator::genLiteral(shared_ptr<LiteralNode> node) 
 {
-    return node->value;
+    switch (node->kind) 
+    {
+        case TypeId::Int: return code.intConstant(strtoll(node->value.c_str(), nullptr, 10));
+        case TypeId::Float: return code.floatConstant(node->value);
+        case TypeId::Bool: return code.boolConstant(node->value == "true");
+        default: return code.stringConstant(node->value);
+    }
 }
 
-string IRGenerator::genIdentifier(shared_ptr<IdentifierNode> node) 
+Operand IRGenerator::genIdentifier(shared_ptr<IdentifierNode> node) 
 {
-    return node->name;
+    return variableOf(node->symbol);
 }
 
-string IRGenerator::genCall(shared_ptr<CallNode> node) 
+Operand IRGenerator::genCall(shared_ptr<CallNode> node) 
 {
-    auto idNode = dynamic_pointer_cast<IdentifierNode>(node->callee);
-    if (!idNode) return "";
+    if (!node->symbol) return Operand();
     
     
-    for (const auto& arg : node->args) 
+    const auto& paramTypes = node->symbol->paramTypes;
+    for (size_t i = 0; i < node->args.size(); i++) 
     {
-        string argValue = genExpression(arg);
-        emit(IROpcode::PARAM, "", argValue);
+        Operand argValue = genExpressionAs(node->args[i], paramTypes[i]);
+        emit(IROpcode::PARAM, Operand(), argValue);
     }
     
     
-    string result = newTemp();
-    string numArgs = to_string(node->args.size());
-    emit(IROpcode::CALL, result, idNode->name, numArgs);
+    Operand result = newTemp();
+    Operand numArgs = code.intConstant((long long)node->args.size());
+    emit(IROpcode::CALL, result, code.function(node->symbol->name), numArgs);
     
     return result;
 }
 
-string IRGenerator::genAssignment(shared_ptr<AssignmentNode> node) 
+Operand IRGenerator::genAssignment(shared_ptr<AssignmentNode> node) 
 {
     auto idNode = dynamic_pointer_cast<IdentifierNode>(node->left);
-    if (!idNode) return "";
+    if (!idNode) return Operand();
     
-    string rightValue = genExpression(node->right);
+    Operand target = variableOf(idNode->symbol);
+    TypeId targetType = idNode->symbol->type;
     
     if (node->op == "=") 
     {
-        emit(IROpcode::COPY, idNode->name, rightValue);
+        Operand rightValue = genExpressionAs(node->right, targetType);
+        emit(IROpcode::COPY, target, rightValue);
     } 
     else 
     {
+        // int += float computes in float and truncates back
+        TypeId opType = promoteTypes(targetType, node->right->type);
+        Operand rightValue = genExpressionAs(node->right, opType);
+        Operand current = convert(target, targetType, opType);
         
-        IROpcode op;
-        if (node->op == "+=") op = IROpcode::ADD;
-        else if (node->op == "-=") op = IROpcode::SUB;
-        else if (node->op == "*=") op = IROpcode::MUL;
-        else if (node->op == "/=") op = IROpcode::DIV;
-        else op = IROpcode::ADD;
-        
-        string result = newTemp();
-        emit(op, result, idNode->name, rightValue);
-        emit(IROpcode::COPY, idNode->name, result);
+        Operand result = newTemp();
+        emit(arithmeticOpcode(node->op, opType), result, current, rightValue);
+        emit(IROpcode::COPY, target, convert(result, opType, targetType));
     }
     
-    return idNode->name;
+    return target;
 }
\ No newline at end of file
@@ -6,7 +6,9 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <cstdint>
 #include "scope_analyzer.h"
+#include "output_buffer.h"
 
 using namespace std;
 
@@ -30,15 +32,27 @@ struct AssignmentNode;
 using AST = shared_ptr<ASTNode>;
 
 
-enum class IROpcode 
+// Arithmetic and comparisons come in int (_I), float (_F) and bool (_B)
+// variants chosen from the operands' checked types. The untyped
+// comparisons remain for strings and for ordering bools. IF_LT_I and the
+// other fused branches jump to result when arg1 compares to arg2, without
+// a bool in between; they follow the int and float comparisons' order.
+enum class IROpcode : uint8_t 
 {
     
-    ADD, SUB, MUL, DIV,
+    ADD_I, SUB_I, MUL_I, DIV_I,
+    ADD_F, SUB_F, MUL_F, DIV_F,
     
     
-    NEG, NOT,
+    NEG_I, NEG_F, NOT,
     
     
+    I2F, F2I,
+    
+    
+    EQ_I, NE_I, LT_I, LE_I, GT_I, GE_I,
+    EQ_F, NE_F, LT_F, LE_F, GT_F, GE_F,
+    EQ_B, NE_B,
     EQ, NE, LT, LE, GT, GE,
     
     
@@ -49,6 +63,8 @@ enum class IROpcode
     
     
     LABEL, GOTO, IF_FALSE, IF_TRUE,
+    IF_EQ_I, IF_NE_I, IF_LT_I, IF_LE_I, IF_GT_I, IF_GE_I,
+    IF_EQ_F, IF_NE_F, IF_LT_F, IF_LE_F, IF_GT_F, IF_GE_F,
     
     
     PARAM, CALL, RETURN,
@@ -58,48 +74,154 @@ enum class IROpcode
 };
 
 
+// A TAC operand packed into 32 bits: the kind in the top four bits and a
+// payload below. Temps and labels carry their number, variables, globals
+// and functions an index into the buffer's name table, ints that fit their
+// value, and the remaining constants an index into the matching pool.
+// Var is a function's own parameter or local; Global is program state
+// that calls and top-level code can change.
+enum class OperandKind : uint8_t 
+{
+    None, Temp, Var, Global, Func, Label, Int, LongInt, Float, Bool, String
+};
+
+class Operand 
+{
+private:
+    static const int PayloadBits = 28;
+    static const uint32_t PayloadMask = (1u << PayloadBits) - 1;
+    uint32_t bits;
+    
+public:
+    Operand() : bits(0) {}
+    Operand(OperandKind kind, uint32_t payload) 
+        : bits((uint32_t)kind << PayloadBits | (payload & PayloadMask)) {}
+    
+    static bool fitsInline(long long value) 
+    {
+        return value >= -(1LL << (PayloadBits - 1)) && value < (1LL << (PayloadBits - 1));
+    }
+    
+    OperandKind kind() const { return OperandKind(bits >> PayloadBits); }
+    uint32_t index() const { return bits & PayloadMask; }
+    int32_t inlineInt() const { return int32_t(bits << (32 - PayloadBits)) >> (32 - PayloadBits); }
+    bool empty() const { return kind() == OperandKind::None; }
+    uint32_t raw() const { return bits; }
+    
+    bool operator==(Operand other) const { return bits == other.bits; }
+    bool operator!=(Operand other) const { return bits != other.bits; }
+};
+
 struct IRInstruction 
 {
     IROpcode op;
-    string result;      
-    string arg1;        
-    string arg2;        
+    Operand result;
+    Operand arg1;
+    Operand arg2;
     
-    IRInstruction(IROpcode opcode, const string& res = "", 
-                  const string& a1 = "", const string& a2 = "")
+    IRInstruction(IROpcode opcode, Operand res = Operand(), 
+                  Operand a1 = Operand(), Operand a2 = Operand())
         : op(opcode), result(res), arg1(a1), arg2(a2) {}
+};
+
+// Instructions stored column by column, together with the names and
+// constants their operands index. Text is produced only when dumping.
+// clear() drops the instructions but keeps the tables, so operands held
+// elsewhere stay meaningful.
+class IRBuffer 
+{
+private:
+    vector<IROpcode> ops;
+    vector<Operand> results;
+    vector<Operand> args1;
+    vector<Operand> args2;
+    
+    vector<string> names;
+    unordered_map<string, uint32_t> nameIndex;
+    vector<long long> longInts;
+    vector<double> floats;
+    vector<string> floatSpellings;
+    vector<string> strings;
+    unordered_map<uint32_t, vector<Operand>> params;    // per function name
+    
+    uint32_t intern(const string& name);
+    void writeOperand(OutputBuffer& out, Operand operand) const;
+    
+public:
+    size_t size() const { return ops.size(); }
+    IROpcode op(size_t i) const { return ops[i]; }
+    Operand result(size_t i) const { return results[i]; }
+    Operand arg1(size_t i) const { return args1[i]; }
+    Operand arg2(size_t i) const { return args2[i]; }
+    IRInstruction at(size_t i) const { return IRInstruction(ops[i], results[i], args1[i], args2[i]); }
+    
+    void push_back(const IRInstruction& instr);
+    void clear();
+    
+    Operand variable(const string& name) { return Operand(OperandKind::Var, intern(name)); }
+    Operand global(const string& name) { return Operand(OperandKind::Global, intern(name)); }
+    Operand function(const string& name) { return Operand(OperandKind::Func, intern(name)); }
+    Operand intConstant(long long value);
+    Operand floatConstant(const string& spelling);
+    Operand floatConstant(double value);
+    Operand boolConstant(bool value) { return Operand(OperandKind::Bool, value); }
+    Operand stringConstant(const string& value);
+    
+    const string& name(Operand operand) const { return names[operand.index()]; }
+    // a function's parameters as the Var operands its body reads them by
+    void setParameters(Operand function, vector<Operand> vars) { params[function.index()] = move(vars); }
+    const vector<Operand>& parameters(Operand function) const;
+    long long intValue(Operand operand) const;
+    double floatValue(Operand operand) const { return floats[operand.index()]; }
+    string text(Operand operand) const;
     
-    void print(ostream& os) const;
+    void dump(OutputBuffer& out, const IRInstruction& instr) const;
+    void dump(OutputBuffer& out, size_t i) const { dump(out, at(i)); }
+    void dumpJson(OutputBuffer& out, size_t i) const;
 };
 
 class IRGenerator 
 {
 private:
-    vector<IRInstruction> instructions;
-    ScopeStack scopeStack;
+    IRBuffer code;
     
     int tempCounter;
     int labelCounter;
     
     string currentFunction;
+    TypeId currentReturnType;
     
+    // Lowered results of hash-consed expressions, valid until a label, a call
+    // or a write to one of the variables the expression reads
+    unordered_map<const ASTNode*, Operand> exprCache;
+    unordered_map<uint32_t, vector<const ASTNode*>> cacheReaders;
     
-    string newTemp();
+    Operand variableOf(const SymbolInfo* symbol);
+    void cacheExpr(const AST& node, Operand result);
+    void invalidateCache(IROpcode op, Operand result);
     
     
-    string newLabel();
+    Operand newTemp();
+    
+    
+    Operand newLabel();
     
     
     void emit(const IRInstruction& instr);
-    void emit(IROpcode op, const string& result = "", 
-              const string& arg1 = "", const string& arg2 = "");
+    void emit(IROpcode op, Operand result = Operand(), 
+              Operand arg1 = Operand(), Operand arg2 = Operand());
     
 public:
-    IRGenerator() : tempCounter(0), labelCounter(0) {}
+    IRGenerator() : tempCounter(0), labelCounter(0), currentReturnType(TypeId::Void) {}
     
     void generate(shared_ptr<ProgramNode> program);
-    void printIR(ostream& os) const;
-    const vector<IRInstruction>& getInstructions() const { return instructions; }
+    // one top-level item; temp and label numbering continues across calls
+    void generateItem(const AST& item);
+    void appendCode(const vector<IRInstruction>& instrs);
+    void clearInstructions() { code.clear(); }
+    void printIR(ostream& os, DumpFormat format = DumpFormat::Text) const;
+    const IRBuffer& getCode() const { return code; }
+    IRBuffer& getCode() { return code; }
     
 private:
     
@@ -111,18 +233,34 @@ private:
     void genIf(shared_ptr<IfNode> node);
     void genWhile(shared_ptr<WhileNode> node);
     void genExprStmt(shared_ptr<ExprStmtNode> node);
+    // jumps to target when cond evaluates to jumpIf, falls through otherwise
+    void genBranch(const AST& cond, Operand target, bool jumpIf);
     
     
-    string genExpression(AST node);
-    string genBinaryOp(shared_ptr<BinaryOpNode> node);
-    string genUnaryOp(shared_ptr<UnaryOpNode> node);
-    string genLiteral(shared_ptr<LiteralNode> node);
-    string genIdentifier(shared_ptr<IdentifierNode> node);
-    string genCall(shared_ptr<CallNode> node);
-    string genAssignment(shared_ptr<AssignmentNode> node);
+    Operand genExpression(AST node);
+    Operand genExpressionAs(const AST& node, TypeId type);
+    Operand convert(Operand value, TypeId from, TypeId to);
+    Operand genBinaryOp(shared_ptr<BinaryOpNode> node);
+    Operand genUnaryOp(shared_ptr<UnaryOpNode> node);
+    Operand genLiteral(shared_ptr<LiteralNode> node);
+    Operand genIdentifier(shared_ptr<IdentifierNode> node);
+    Operand genCall(shared_ptr<CallNode> node);
+    Operand genAssignment(shared_ptr<AssignmentNode> node);
 };
 
 
-string opcodeToString(IROpcode op);
+const char* opcodeToString(IROpcode op);
+
+// IF_FALSE, IF_TRUE and the fused branches
+bool isConditionalBranch(IROpcode op);
+// the fused branch on an int or float comparison, or GOTO when there is none
+IROpcode branchOn(IROpcode comparison);
+// the comparison a fused branch tests
+IROpcode comparisonOf(IROpcode branch);
+// The branch taken exactly when op is not, or op itself when there is
+// none: a float ordering is false on NaN, and so is its opposite.
+IROpcode negatedBranch(IROpcode op);
+// whether swapping the operands leaves the result alone
+bool isCommutative(IROpcode op);
 
 #endif
\ No newline at end of file
@@ -126,6 +126,15 @@ token lexer::comment()
 token lexer::getNextToken() 
 {
     skipWhitespace();
+    int start = pos;
+    token t = scanToken();
+    t.pos = start;
+    t.end = pos;
+    return t;
+}
+
+token lexer::scanToken() 
+{
     if (isEOF())
         return {T_EOF, ""};
 
@@ -239,7 +248,7 @@ token lexer::getNextToken()
     throw runtime_error("Unknown token starting at: " + string(1, c));
 }
 
-string tokenTypeToString(tokenType type, const string& val) 
+const char* tokenTypeName(tokenType type) 
 {
     switch (type) 
     {
@@ -253,11 +262,11 @@ string tokenTypeToString(tokenType type, const string& val)
     case T_WHILE: return "T_WHILE";
     case T_FOR: return "T_FOR";
     case T_RETURN: return "T_RETURN";
-    case T_IDENTIFIER: return "T_IDENTIFIER(\"" + val + "\")";
-    case T_INTLIT: return "T_INTLIT(" + val + ")";
-    case T_FLOATLIT: return "T_FLOATLIT(" + val + ")";
-    case T_STRINGLIT: return "T_STRINGLIT(" + val + ")";
-    case T_BOOLLIT: return "T_BOOLLIT(" + val + ")";
+    case T_IDENTIFIER: return "T_IDENTIFIER";
+    case T_INTLIT: return "T_INTLIT";
+    case T_FLOATLIT: return "T_FLOATLIT";
+    case T_STRINGLIT: return "T_STRINGLIT";
+    case T_BOOLLIT: return "T_BOOLLIT";
     case T_ASSIGNOP: return "T_ASSIGNOP";
     case T_EQUALSOP: return "T_EQUALSOP";
     case T_NOTEQOP: return "T_NOTEQOP";
@@ -291,4 +300,17 @@ string tokenTypeToString(tokenType type, const string& val)
     case T_EOF: return "T_EOF";
     }
     return "UNKNOWN";
+}
+
+string tokenTypeToString(tokenType type, const string& val) 
+{
+    switch (type) 
+    {
+    case T_IDENTIFIER: return "T_IDENTIFIER(\"" + val + "\")";
+    case T_INTLIT: return "T_INTLIT(" + val + ")";
+    case T_FLOATLIT: return "T_FLOATLIT(" + val + ")";
+    case T_STRINGLIT: return "T_STRINGLIT(" + val + ")";
+    case T_BOOLLIT: return "T_BOOLLIT(" + val + ")";
+    default: return tokenTypeName(type);
+    }
 }
\ No newline at end of file
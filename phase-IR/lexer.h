@@ -23,6 +23,8 @@ struct token
 {
     tokenType type;
     string value;
+    int pos = -1;   // source offset of the first character
+    int end = -1;   // source offset just past the last character
 };
 
 
@@ -40,7 +42,9 @@ public:
     token number();
     token stringLiteral();
     token comment();
+    token scanToken();
     token getNextToken();
 };
 
 std::string tokenTypeToString(tokenType type, const string& val = "");
+const char* tokenTypeName(tokenType type);
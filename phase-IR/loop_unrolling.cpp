@@ -0,0 +1,431 @@
+#include "passes.h"
+#include "loops.h"
+#include <algorithm>
+#include <climits>
+#include <unordered_map>
+
+using namespace std;
+
+static const size_t MaxFactor = 8;     // copies of the body in one trip of a partially unrolled loop
+
+static bool fits(__int128 v) 
+{
+    return v >= LLONG_MIN && v <= LLONG_MAX;
+}
+
+static bool holds(IROpcode relation, __int128 a, __int128 b) 
+{
+    switch (relation) 
+    {
+        case IROpcode::LT_I: return a < b;
+        case IROpcode::LE_I: return a <= b;
+        case IROpcode::GT_I: return a > b;
+        default: return a >= b;
+    }
+}
+
+// The counter deciding a loop's trip count: a header phi entering as init
+// and stepped by a constant into next, which the latch's branch compares
+// with an invariant bound. The loop goes around again while next relation
+// bound holds, relation being one of LT_I, LE_I, GT_I and GE_I.
+struct LoopCounter 
+{
+    Operand init, next, bound;
+    long long step;
+    IROpcode relation;
+};
+
+// an innermost loop to unroll: fully when trips is set, else by factor
+struct UnrollPlan 
+{
+    uint32_t loop, pre;
+    LoopCounter counter;
+    size_t trips, factor;
+};
+
+class LoopUnroller 
+{
+private:
+    SSAFunction& function;
+    IRBuffer& code;
+    size_t budget;
+    vector<Operand> replacement;        // per value: what its uses read instead
+    UnrollResult result;
+    
+    size_t predIndex(uint32_t block, uint32_t pred) const 
+    {
+        const vector<uint32_t>& preds = function.blocks[block].preds;
+        return find(preds.begin(), preds.end(), pred) - preds.begin();
+    }
+    
+    bool findCounter(const NaturalLoop& loop, uint32_t pre, const vector<uint32_t>& mark, uint32_t stamp,
+                     LoopCounter& counter) const 
+    {
+        uint32_t latch = loop.latches[0];
+        const SSABlock& header = function.blocks[loop.header];
+        const SSABlock& last = function.blocks[latch];
+        const IRInstruction& branch = last.terminator();
+        if (branch.op < IROpcode::IF_LT_I || branch.op > IROpcode::IF_GE_I) return false;
+        size_t entry = predIndex(loop.header, pre), back = predIndex(loop.header, latch);
+        
+        for (const PhiNode& phi : header.phis) 
+        {
+            Operand next = phi.args[back];
+            if (!SSAFunction::isValue(next) || (next != branch.arg1 && next != branch.arg2)) continue;
+            // through the copies left when copy propagation has not run
+            const IRInstruction* defining = nullptr;
+            for (Operand value = next; SSAFunction::isValue(value);) 
+            {
+                const SSASite& def = function.definition(value.index());
+                if (def.isPhi() || def.index < 0) break;
+                defining = &function.blocks[def.block].code[def.index];
+                if (defining->op != IROpcode::COPY) break;
+                value = defining->arg1;
+            }
+            if (!defining) continue;
+            const IRInstruction& instr = *defining;
+            long long step;
+            if (instr.op == IROpcode::ADD_I && instr.arg1 == phi.result && isIntConstant(instr.arg2)) step = code.intValue(instr.arg2);
+            else if (instr.op == IROpcode::ADD_I && instr.arg2 == phi.result && isIntConstant(instr.arg1)) step = code.intValue(instr.arg1);
+            else if (instr.op == IROpcode::SUB_I && instr.arg1 == phi.result && isIntConstant(instr.arg2) &&
+                     code.intValue(instr.arg2) != LLONG_MIN)
+                step = -code.intValue(instr.arg2);
+            else continue;
+            
+            bool left = branch.arg1 == next;
+            Operand bound = left ? branch.arg2 : branch.arg1;
+            if (bound == next || bound.kind() == OperandKind::Global) continue;
+            if (SSAFunction::isValue(bound) && mark[function.definition(bound.index()).block] == stamp) continue;
+            
+            // normalized to next relation bound, which keeps the loop going
+            static const IROpcode flipped[] = {IROpcode::GT_I, IROpcode::GE_I, IROpcode::LT_I, IROpcode::LE_I};
+            static const IROpcode negated[] = {IROpcode::GE_I, IROpcode::GT_I, IROpcode::LE_I, IROpcode::LT_I};
+            IROpcode relation = comparisonOf(branch.op);
+            if (!left) relation = flipped[(int)relation - (int)IROpcode::LT_I];
+            if (last.succs[1] != loop.header) relation = negated[(int)relation - (int)IROpcode::LT_I];
+            bool upward = relation == IROpcode::LT_I || relation == IROpcode::LE_I;
+            if (step == 0 || (step > 0) != upward) continue;
+            counter = {phi.args[entry], next, bound, step, relation};
+            return true;
+        }
+        return false;
+    }
+    
+    // trips through the loop, counting the first, or 0 when unknown or above limit
+    size_t tripCount(const LoopCounter& counter, size_t limit) const 
+    {
+        if (!isIntConstant(counter.init) || !isIntConstant(counter.bound)) return 0;
+        __int128 value = code.intValue(counter.init), bound = code.intValue(counter.bound);
+        for (size_t trips = 1; trips <= limit; trips++) 
+        {
+            value += counter.step;
+            if (!fits(value)) return 0;
+            if (!holds(counter.relation, value, bound)) return trips;
+        }
+        return 0;
+    }
+    
+    // Lays out a copy of the loop's blocks in a chain after `after`, reading
+    // values through `values`, which maps the header's phis on entry and
+    // gains every value the copy defines. Returns the copies in the loop's
+    // order; the header's copy has no predecessors yet, and the latch's
+    // copy no successors, its branch to be replaced by the caller.
+    vector<uint32_t> copyBody(const NaturalLoop& loop, unordered_map<uint32_t, Operand>& values, uint32_t& after) 
+    {
+        vector<uint32_t> copies;
+        unordered_map<uint32_t, uint32_t> copyOf;
+        for (uint32_t b : loop.blocks) 
+        {
+            after = function.addBlock((int32_t)after);
+            copies.push_back(after);
+            copyOf[b] = after;
+        }
+        auto mapped = [&](Operand operand) 
+        {
+            if (!SSAFunction::isValue(operand)) return operand;
+            auto it = values.find(operand.index());
+            return it == values.end() ? operand : it->second;
+        };
+        
+        // in reverse postorder every value is copied before the copies reading it
+        uint32_t latch = loop.latches[0];
+        for (size_t k = 0; k < loop.blocks.size(); k++) 
+        {
+            uint32_t b = loop.blocks[k];
+            SSABlock& copy = function.blocks[copies[k]];
+            const SSABlock& block = function.blocks[b];
+            if (b != loop.header) 
+            {
+                for (const PhiNode& phi : block.phis) 
+                {
+                    PhiNode merged = {function.newValue(function.origin[phi.result.index()]), {}};
+                    for (Operand arg : phi.args) merged.args.push_back(mapped(arg));
+                    values[phi.result.index()] = merged.result;
+                    copy.phis.push_back(merged);
+                }
+                for (uint32_t p : block.preds) copy.preds.push_back(copyOf[p]);
+            }
+            for (const IRInstruction& instr : block.code) 
+            {
+                IRInstruction cloned = instr;
+                forEachUse(cloned, [&](Operand& operand) { operand = mapped(operand); });
+                if (definesResult(cloned) && SSAFunction::isValue(cloned.result)) 
+                {
+                    cloned.result = function.newValue(function.origin[instr.result.index()]);
+                    values[instr.result.index()] = cloned.result;
+                }
+                copy.code.push_back(cloned);
+            }
+            if (b == latch) continue;
+            for (uint32_t s : block.succs) copy.succs.push_back(copyOf[s]);
+        }
+        return copies;
+    }
+    
+    // what the header's phis come back around as, in the copy whose values are given
+    vector<Operand> backArguments(const NaturalLoop& loop, const unordered_map<uint32_t, Operand>& values) const 
+    {
+        size_t back = predIndex(loop.header, loop.latches[0]);
+        vector<Operand> args;
+        for (const PhiNode& phi : function.blocks[loop.header].phis) 
+        {
+            Operand arg = phi.args[back];
+            auto it = SSAFunction::isValue(arg) ? values.find(arg.index()) : values.end();
+            args.push_back(it == values.end() ? arg : it->second);
+        }
+        return args;
+    }
+    
+    // control passes from the end of `from` into the header's copy at `to`
+    void chain(uint32_t from, uint32_t to) 
+    {
+        SSABlock& block = function.blocks[from];
+        block.terminator() = IRInstruction(IROpcode::GOTO);
+        block.succs = {to};
+        function.blocks[to].preds.push_back(from);
+    }
+    
+    // Full unrolling: trips - 1 copies of the body run ahead of the loop's
+    // own blocks, which are left as the last trip, so uses after the loop
+    // still read their values. The back edge goes and the header's phis
+    // become the values of the copy before.
+    void unrollFully(const NaturalLoop& loop, uint32_t pre, size_t trips) 
+    {
+        uint32_t header = loop.header, latch = loop.latches[0];
+        size_t entry = predIndex(header, pre);
+        unordered_map<uint32_t, Operand> values;
+        vector<Operand> args;
+        for (const PhiNode& phi : function.blocks[header].phis) args.push_back(phi.args[entry]);
+        
+        uint32_t from = pre, after = pre;
+        for (size_t t = 1; t < trips; t++) 
+        {
+            const vector<PhiNode>& phis = function.blocks[header].phis;
+            values.clear();
+            for (size_t k = 0; k < phis.size(); k++) values[phis[k].result.index()] = args[k];
+            vector<uint32_t> copies = copyBody(loop, values, after);
+            if (from == pre) 
+            {
+                *find(function.blocks[pre].succs.begin(), function.blocks[pre].succs.end(), header) = copies[0];
+                function.blocks[copies[0]].preds.push_back(pre);
+            }
+            else chain(from, copies[0]);
+            from = copies.back();
+            args = backArguments(loop, values);
+        }
+        if (from != pre) 
+        {
+            SSABlock& block = function.blocks[from];
+            block.terminator() = IRInstruction(IROpcode::GOTO);
+            block.succs = {header};
+            function.blocks[header].preds[entry] = from;
+        }
+        
+        function.removeEdge(latch, header);
+        vector<PhiNode>& phis = function.blocks[header].phis;
+        for (size_t k = 0; k < phis.size(); k++) replacement[phis[k].result.index()] = args[k];
+        phis.clear();
+        result.full++;
+        result.copies += trips - 1;
+    }
+    
+    // Partial unrolling: a main loop of factor copies of the body runs
+    // while at least one more trip is left after them, then the loop
+    // itself finishes the rest. It always runs a trip or more, so it stays
+    // the only way out and keeps its values for the uses after it. With the
+    // counter at i, the trip factor steps on exists when i relation
+    // bound - factor * step; that limit is computed once, and where it
+    // could wrap around a guard sends everything to the loop instead.
+    bool unrollPartially(const NaturalLoop& loop, uint32_t pre, const LoopCounter& counter, size_t factor) 
+    {
+        uint32_t header = loop.header;
+        __int128 shift = (__int128)counter.step * (__int128)factor;
+        if (!fits(shift)) return false;
+        bool knownInit = isIntConstant(counter.init), knownBound = isIntConstant(counter.bound);
+        Operand limit;
+        if (knownBound) 
+        {
+            __int128 l = (__int128)code.intValue(counter.bound) - shift;
+            if (!fits(l)) return false;
+            limit = code.intConstant((long long)l);
+        }
+        __int128 first = knownInit ? (__int128)code.intValue(counter.init) + shift : 0;
+        if (knownInit && !fits(first)) return false;
+        if (knownInit && knownBound && !holds(counter.relation, first, code.intValue(counter.bound))) return false;
+        
+        IROpcode test = branchOn(counter.relation);
+        if (!knownBound) 
+        {
+            limit = function.newValue();
+            vector<IRInstruction>& instrs = function.blocks[pre].code;
+            instrs.insert(instrs.end() - 1, IRInstruction(IROpcode::SUB_I, limit, counter.bound, code.intConstant((long long)shift)));
+        }
+        
+        // the block deciding between the main loop (taken) and the loop itself
+        uint32_t entering = pre, after = pre;
+        size_t entry = predIndex(header, pre);
+        if (!knownInit && !knownBound) 
+        {
+            bool upward = counter.step > 0;
+            __int128 edge = (upward ? (__int128)LLONG_MIN : (__int128)LLONG_MAX) + shift;
+            entering = after = function.addBlock((int32_t)pre);
+            SSABlock& block = function.blocks[pre];
+            block.terminator() = IRInstruction(upward ? IROpcode::IF_LT_I : IROpcode::IF_GT_I, Operand(),
+                                               counter.bound, code.intConstant((long long)edge));
+            block.succs = {entering, header};
+            function.blocks[entering].preds.push_back(pre);
+            function.blocks[entering].code.push_back(IRInstruction(test, Operand(), counter.init, limit));
+            function.blocks[entering].succs.push_back(header);
+            SSABlock& target = function.blocks[header];
+            target.preds.push_back(entering);
+            for (PhiNode& phi : target.phis) phi.args.push_back(phi.args[entry]);
+        }
+        else if (!knownInit) 
+        {
+            function.blocks[pre].terminator() = IRInstruction(test, Operand(), counter.init, limit);
+        }
+        else if (!knownBound) 
+        {
+            function.blocks[pre].terminator() = IRInstruction(test, Operand(), code.intConstant((long long)first), counter.bound);
+        }
+        
+        // the main loop's header merges the entry values with its own latch's
+        unordered_map<uint32_t, Operand> values;
+        vector<PhiNode> merges;
+        for (const PhiNode& phi : function.blocks[header].phis) 
+        {
+            merges.push_back({function.newValue(function.origin[phi.result.index()]), {phi.args[entry]}});
+            values[phi.result.index()] = merges.back().result;
+        }
+        uint32_t top = 0, from = 0;
+        for (size_t k = 0; k < factor; k++) 
+        {
+            vector<uint32_t> copies = copyBody(loop, values, after);
+            if (k == 0) top = copies[0];
+            else chain(from, copies[0]);
+            from = copies.back();
+            if (k + 1 == factor) break;
+            vector<Operand> args = backArguments(loop, values);
+            vector<PhiNode>& phis = function.blocks[header].phis;
+            values.clear();
+            for (size_t j = 0; j < phis.size(); j++) values[phis[j].result.index()] = args[j];
+        }
+        vector<Operand> args = backArguments(loop, values);
+        Operand next = values[counter.next.index()];
+        
+        SSABlock& main = function.blocks[top];
+        main.preds = {entering, from};
+        for (size_t k = 0; k < merges.size(); k++) merges[k].args.push_back(args[k]);
+        main.phis = move(merges);
+        SSABlock& last = function.blocks[from];
+        last.terminator() = IRInstruction(test, Operand(), next, limit);
+        last.succs = {header, top};
+        
+        SSABlock& entered = function.blocks[entering];
+        if (entering == pre && knownInit && knownBound) entered.succs = {top};
+        else if (entering == pre) entered.succs = {header, top};
+        else entered.succs.push_back(top);
+        
+        SSABlock& target = function.blocks[header];
+        if (knownInit && knownBound) 
+        {
+            // the main loop always runs first, and the loop is entered from it alone
+            target.preds[entry] = from;
+            for (size_t k = 0; k < target.phis.size(); k++) target.phis[k].args[entry] = args[k];
+        }
+        else 
+        {
+            target.preds.push_back(from);
+            for (size_t k = 0; k < target.phis.size(); k++) target.phis[k].args.push_back(args[k]);
+        }
+        result.partial++;
+        result.copies += factor;
+        return true;
+    }
+
+public:
+    LoopUnroller(SSAFunction& fn, IRBuffer& buffer, size_t size) : function(fn), code(buffer), budget(size) {}
+    
+    UnrollResult run() 
+    {
+        function.computeDominators();
+        vector<NaturalLoop> loops = findLoops(function);
+        if (loops.empty()) return result;
+        for (const auto& loop : loops) insertPreheader(function, loop);
+        function.computeDominators();
+        loops = findLoops(function);
+        function.computeDefUse();
+        replacement.assign(function.valueCount(), Operand());
+        
+        // Innermost loops with one latch, which is also their only exit and
+        // ends in the counter's test. Every loop is planned before any is
+        // changed, so def-use stays valid.
+        vector<uint8_t> outer(loops.size(), 0);
+        for (const auto& loop : loops) 
+        {
+            if (loop.parent >= 0) outer[loop.parent] = 1;
+        }
+        vector<uint32_t> mark(function.blocks.size(), 0);
+        vector<UnrollPlan> plans;
+        for (size_t l = 0; l < loops.size(); l++) 
+        {
+            const NaturalLoop& loop = loops[l];
+            if (outer[l] || loop.header == 0 || loop.latches.size() != 1 || loop.exits.size() != 1 ||
+                loop.exits[0] != loop.latches[0])
+                continue;
+            uint32_t stamp = (uint32_t)l + 1, pre = 0;
+            for (uint32_t b : loop.blocks) mark[b] = stamp;
+            for (uint32_t p : function.blocks[loop.header].preds) 
+            {
+                if (mark[p] != stamp) pre = p;
+            }
+            LoopCounter counter;
+            if (!findCounter(loop, pre, mark, stamp, counter)) continue;
+            
+            // The cost model: a copy costs the body's instructions, the
+            // branch closing each trip is what unrolling saves. A loop is
+            // unrolled fully when all its trips fit the budget; otherwise
+            // as many copies go into one trip as fit, if that is two or more.
+            size_t size = 0;
+            for (uint32_t b : loop.blocks) size += function.blocks[b].code.size();
+            size = max<size_t>(size - 1, 1);
+            size_t trips = tripCount(counter, max<size_t>(budget / size, 1));
+            size_t factor = min(MaxFactor, budget / size);
+            if (trips == 0 && factor < 2) continue;
+            plans.push_back({(uint32_t)l, pre, counter, trips, factor});
+        }
+        
+        for (const UnrollPlan& plan : plans) 
+        {
+            if (plan.trips > 0) unrollFully(loops[plan.loop], plan.pre, plan.trips);
+            else unrollPartially(loops[plan.loop], plan.pre, plan.counter, plan.factor);
+        }
+        if (!plans.empty()) function.replaceValues(replacement);
+        return result;
+    }
+};
+
+UnrollResult unrollLoops(SSAFunction& function, IRBuffer& code, size_t budget) 
+{
+    return LoopUnroller(function, code, budget).run();
+}
@@ -0,0 +1,165 @@
+#include "loops.h"
+#include <algorithm>
+
+using namespace std;
+
+vector<NaturalLoop> findLoops(const SSAFunction& function) 
+{
+    const vector<uint32_t>& rpo = function.reversePostorder();
+    size_t count = function.blocks.size();
+    vector<uint32_t> order(count, 0);
+    for (uint32_t i = 0; i < rpo.size(); i++) order[rpo[i]] = i;
+    
+    vector<NaturalLoop> loops;
+    vector<int32_t> loopOf(count, -1);      // header -> loop
+    for (uint32_t b : rpo) 
+    {
+        for (uint32_t s : function.blocks[b].succs) 
+        {
+            if (!function.dominates(s, b)) continue;
+            if (loopOf[s] < 0) 
+            {
+                loopOf[s] = (int32_t)loops.size();
+                loops.emplace_back();
+                loops.back().header = s;
+            }
+            vector<uint32_t>& latches = loops[loopOf[s]].latches;
+            if (find(latches.begin(), latches.end(), b) == latches.end()) latches.push_back(b);
+        }
+    }
+    
+    // each body walked backward from the latches, stopping at the header
+    vector<int32_t> mark(count, -1);
+    vector<uint32_t> stack;
+    for (size_t l = 0; l < loops.size(); l++) 
+    {
+        NaturalLoop& loop = loops[l];
+        mark[loop.header] = (int32_t)l;
+        loop.blocks.push_back(loop.header);
+        for (uint32_t latch : loop.latches) 
+        {
+            if (mark[latch] == (int32_t)l) continue;
+            mark[latch] = (int32_t)l;
+            stack.push_back(latch);
+        }
+        while (!stack.empty()) 
+        {
+            uint32_t b = stack.back();
+            stack.pop_back();
+            loop.blocks.push_back(b);
+            for (uint32_t p : function.blocks[b].preds) 
+            {
+                if (mark[p] == (int32_t)l || !function.reachable(p)) continue;
+                mark[p] = (int32_t)l;
+                stack.push_back(p);
+            }
+        }
+        sort(loop.blocks.begin(), loop.blocks.end(), [&](uint32_t a, uint32_t b) { return order[a] < order[b]; });
+        for (uint32_t b : loop.blocks) 
+        {
+            for (uint32_t s : function.blocks[b].succs) 
+            {
+                if (mark[s] == (int32_t)l) continue;
+                loop.exits.push_back(b);
+                break;
+            }
+        }
+    }
+    
+    // A loop inside another has fewer blocks, so by size inner loops come
+    // first. Each block then names the loop that took it first; a bigger
+    // loop meeting it adopts the outermost loop found above it so far.
+    stable_sort(loops.begin(), loops.end(),
+                [](const NaturalLoop& a, const NaturalLoop& b) { return a.blocks.size() < b.blocks.size(); });
+    vector<int32_t> innermost(count, -1);
+    for (size_t l = 0; l < loops.size(); l++) 
+    {
+        for (uint32_t b : loops[l].blocks) 
+        {
+            if (innermost[b] < 0) 
+            {
+                innermost[b] = (int32_t)l;
+                continue;
+            }
+            int32_t top = innermost[b];
+            while (loops[top].parent >= 0) top = loops[top].parent;
+            if (top != (int32_t)l) loops[top].parent = (int32_t)l;
+        }
+    }
+    for (size_t l = loops.size(); l-- > 0;) 
+    {
+        if (loops[l].parent >= 0) loops[l].depth = loops[loops[l].parent].depth + 1;
+    }
+    return loops;
+}
+
+int32_t insertPreheader(SSAFunction& function, const NaturalLoop& loop) 
+{
+    uint32_t header = loop.header;
+    if (header == 0) return -1;
+    // the header's predecessors inside the loop are its latches
+    auto inLoop = [&](uint32_t b) { return find(loop.latches.begin(), loop.latches.end(), b) != loop.latches.end(); };
+    
+    vector<size_t> outside;     // positions in the header's predecessor list
+    const vector<uint32_t>& preds = function.blocks[header].preds;
+    for (size_t j = 0; j < preds.size(); j++) 
+    {
+        if (!inLoop(preds[j])) outside.push_back(j);
+    }
+    if (outside.empty()) return -1;
+    if (outside.size() == 1) 
+    {
+        uint32_t p = preds[outside[0]];
+        if (function.blocks[p].succs.size() == 1) return (int32_t)p;
+        return (int32_t)function.splitEdge(p, header);
+    }
+    
+    // laid out after the outside predecessor closest above the header
+    int32_t after = -1;
+    for (size_t j : outside) 
+    {
+        if (preds[j] < header) after = max(after, (int32_t)preds[j]);
+    }
+    if (after < 0) after = (int32_t)preds[outside[0]];
+    uint32_t pre = function.addBlock(after);
+    SSABlock& block = function.blocks[pre];
+    SSABlock& target = function.blocks[header];
+    block.code.push_back(IRInstruction(IROpcode::GOTO));
+    block.succs.push_back(header);
+    for (size_t j : outside) block.preds.push_back(target.preds[j]);
+    for (uint32_t p : block.preds) 
+    {
+        for (uint32_t& s : function.blocks[p].succs) 
+        {
+            if (s == header) s = pre;
+        }
+    }
+    
+    // the header keeps its loop edges in order, the preheader in place of the first outside one
+    for (PhiNode& phi : target.phis) 
+    {
+        vector<Operand> entering;
+        for (size_t j : outside) entering.push_back(phi.args[j]);
+        Operand arg = entering[0];
+        if (any_of(entering.begin(), entering.end(), [&](Operand a) { return a != arg; })) 
+        {
+            arg = function.newValue(function.origin[phi.result.index()]);
+            block.phis.push_back({arg, entering});
+        }
+        vector<Operand> args;
+        for (size_t j = 0; j < phi.args.size(); j++) 
+        {
+            if (j == outside[0]) args.push_back(arg);
+            else if (inLoop(target.preds[j])) args.push_back(phi.args[j]);
+        }
+        phi.args = move(args);
+    }
+    vector<uint32_t> kept;
+    for (size_t j = 0; j < target.preds.size(); j++) 
+    {
+        if (j == outside[0]) kept.push_back(pre);
+        else if (inLoop(target.preds[j])) kept.push_back(target.preds[j]);
+    }
+    target.preds = move(kept);
+    return (int32_t)pre;
+}
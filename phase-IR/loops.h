@@ -0,0 +1,38 @@
+#ifndef LOOPS_H
+#define LOOPS_H
+
+#include <cstdint>
+#include <vector>
+#include "ssa.h"
+
+using namespace std;
+
+// A natural loop of an SSA function. An edge whose target dominates its
+// source is a back edge; the loop of a header is the header plus every
+// block that reaches one of its back edges without passing through it.
+// Back edges into one header make one loop. Edges of irreducible cycles
+// are not back edges, so those cycles are not loops here.
+struct NaturalLoop 
+{
+    uint32_t header;
+    vector<uint32_t> blocks;    // in reverse postorder, so the header first
+    vector<uint32_t> latches;   // sources of the back edges
+    vector<uint32_t> exits;     // blocks of the loop with a successor outside it
+    int32_t parent = -1;        // the innermost loop enclosing this one
+    uint32_t depth = 1;         // 1 for an outermost loop
+};
+
+// The loops of a function, inner loops before the loops enclosing them.
+// Dominators must be current.
+vector<NaturalLoop> findLoops(const SSAFunction& function);
+
+// Gives the loop a preheader, a block whose only successor is the header
+// and through which every entry into the loop passes, and returns it. A
+// lone predecessor from outside that leads nowhere else already is one;
+// otherwise the outside edges are redirected into a new block, which
+// takes over the header's phi arguments along them, merging them in a phi
+// of its own when they differ. Returns -1 for a loop headed by the entry.
+// Dominators and the loops found are stale afterwards.
+int32_t insertPreheader(SSAFunction& function, const NaturalLoop& loop);
+
+#endif
@@ -4,56 +4,501 @@
 #include "parser.h"
 #include "scope_analyzer.h"
 #include "type_checker.h"
+#include "parallel_semantic.h"
+#include "semantic_analyzer.h"
+#include "incremental.h"
 #include "ir.h"
+#include "cfg.h"
+#include "optimizer.h"
+#include "interpreter.h"
 #include <fstream>
+#include <chrono>
+#include <cstdio>
 
 using namespace std;
 
-int main() 
+struct DriverOptions 
 {
-    ifstream file("text.txt");
-    if (!file.is_open()) 
+    string inputFile = "text.txt";
+    vector<string> revisions;   // --incremental: earlier revisions of inputFile, oldest first
+    bool incremental = false;
+    bool dumpTokens = false;
+    bool dumpAST = true;
+    bool dumpIR = true;
+    bool dumpCFG = false;
+    bool buildCFG = false;
+    bool dumpSSA = false;
+    bool ssa = false;
+    OptimizerOptions optimizer; // SSA passes picked by --opt and -O
+    bool run = false;
+    DumpFormat format = DumpFormat::Text;
+    bool timing = false;
+    bool stats = false;
+    bool hashCons = false;
+    int jobs = -1;              // -1: sequential passes, 0: one worker per core
+    bool fused = false;
+    bool compareSemantic = false;
+    int lookupLine = 0;         // 1-based position for --lookup, 0 when unset
+    int lookupCol = 0;
+};
+
+class PhaseTimer 
+{
+    bool enabled;
+    chrono::steady_clock::time_point start;
+
+public:
+    PhaseTimer(bool on) : enabled(on), start(chrono::steady_clock::now()) {}
+
+    void lap(const string& phase) 
     {
-        cerr << "Error: Could not open text.txt\n";
-        return 1;
+        auto now = chrono::steady_clock::now();
+        if (enabled) 
+        {
+            cerr << "[time] " << phase << ": " 
+                 << chrono::duration<double, milli>(now - start).count() << " ms\n";
+        }
+        start = chrono::steady_clock::now();
+    }
+};
+
+static void printUsage(ostream& os) 
+{
+    os << "Usage: main [options] [source-file]\n"
+       << "       main --incremental [options] revision-file... source-file\n"
+       << "  --dump=LIST      comma-separated dumps to print: tokens, ast, ir, cfg, ssa (default: ast,ir)\n"
+       << "  --no-dump        disable all dumps\n"
+       << "  --format=FMT     dump format: text (default) or json (JSON lines)\n"
+       << "  --time           report per-phase wall-clock times on stderr\n"
+       << "  --stats          report AST node and IR instruction counts on stderr\n"
+       << "  --hash-cons      share structurally identical pure expressions within a scope\n"
+       << "  --fused          resolve names and check types in a single traversal\n"
+       << "  --compare-semantic  time the two-pass and fused analyses on the same AST (stderr)\n"
+       << "  --jobs=N         check function bodies in parallel on N workers (0: one per core)\n"
+       << "  --lookup=L:C     after scope analysis, print the symbol at and symbols visible at line L, column C\n"
+       << "                   (not with --hash-cons, --fused, --compare-semantic or --jobs)\n"
+       << "  --cfg            split each function's TAC into basic blocks (implied by --dump=cfg)\n"
+       << "  --ssa            take each function through SSA form and back (implied by --dump=ssa)\n"
+       << "  --opt=LIST       comma-separated SSA passes to run: sccp, copy, lvn, gvn, licm, iv, pre, unroll, dce, fuse (implies --ssa)\n"
+       << "  -O               run every SSA pass\n"
+       << "  --unroll=N       let unrolling grow a loop to N instructions (default 32, 0: never)\n"
+       << "  --run            interpret the final TAC and print what main returns; --stats adds the\n"
+       << "                   number of instructions dispatched\n"
+       << "  --incremental    build each file as an edit of the one before it, re-checking and\n"
+       << "                   re-lowering only the functions the edit affects; dumps show the last\n"
+       << "                   revision\n";
+}
+
+static int offsetOf(const string& code, int line, int col) 
+{
+    size_t offset = 0;
+    for (int l = 1; l < line; l++) 
+    {
+        offset = code.find('\n', offset);
+        if (offset == string::npos) return -1;
+        offset++;
+    }
+    return (int)(offset + col - 1);
+}
+
+static void printLineCol(ostream& os, const string& code, int offset) 
+{
+    int line = 1, col = 1;
+    for (int i = 0; i < offset && i < (int)code.size(); i++) 
+    {
+        if (code[i] == '\n') { line++; col = 1; }
+        else col++;
     }
+    os << line << ":" << col;
+}
 
+static void printLookup(ostream& os, const string& code, const ScopeTree& tree, const DriverOptions& opts) 
+{
+    int pos = offsetOf(code, opts.lookupLine, opts.lookupCol);
+    os << "\nLookup at " << opts.lookupLine << ":" << opts.lookupCol << "\n";
+    
+    const ScopeRegion& region = tree.region(tree.regionAt(pos));
+    os << "  scope: ";
+    if (region.parent < 0) os << "global";
+    else 
+    {
+        printLineCol(os, code, region.begin);
+        os << " - ";
+        printLineCol(os, code, region.end);
+    }
+    os << "\n";
+    
+    if (const SymbolInfo* info = tree.symbolAt(pos)) 
+    {
+        os << "  definition: " << info->name << " : " << typeName(info->type) << " at ";
+        printLineCol(os, code, info->declPos);
+        os << "\n";
+    }
+    
+    os << "  visible:";
+    for (const SymbolInfo* info : tree.visibleAt(pos)) 
+    {
+        os << " " << info->name << (info->isFunction ? "()" : "") << " : " << typeName(info->type);
+    }
+    os << "\n";
+}
+
+static bool parseArgs(int argc, char* argv[], DriverOptions& opts) 
+{
+    for (int i = 1; i < argc; i++) 
+    {
+        string arg = argv[i];
+        if (arg == "--no-dump") 
+        {
+            opts.dumpTokens = opts.dumpAST = opts.dumpIR = opts.dumpCFG = opts.dumpSSA = false;
+        } 
+        else if (arg.rfind("--dump=", 0) == 0) 
+        {
+            opts.dumpTokens = opts.dumpAST = opts.dumpIR = opts.dumpCFG = opts.dumpSSA = false;
+            stringstream list(arg.substr(7));
+            string item;
+            while (getline(list, item, ',')) 
+            {
+                if (item == "tokens") opts.dumpTokens = true;
+                else if (item == "ast") opts.dumpAST = true;
+                else if (item == "ir") opts.dumpIR = true;
+                else if (item == "cfg") opts.dumpCFG = opts.buildCFG = true;
+                else if (item == "ssa") opts.dumpSSA = opts.ssa = true;
+                else return false;
+            }
+        } 
+        else if (arg == "--format=text") 
+        {
+            opts.format = DumpFormat::Text;
+        } 
+        else if (arg == "--format=json") 
+        {
+            opts.format = DumpFormat::JsonLines;
+        } 
+        else if (arg == "--time") 
+        {
+            opts.timing = true;
+        } 
+        else if (arg == "--stats") 
+        {
+            opts.stats = true;
+        } 
+        else if (arg == "--hash-cons") 
+        {
+            opts.hashCons = true;
+        } 
+        else if (arg == "--fused") 
+        {
+            opts.fused = true;
+        } 
+        else if (arg == "--compare-semantic") 
+        {
+            opts.compareSemantic = true;
+        } 
+        else if (arg.rfind("--jobs=", 0) == 0) 
+        {
+            try 
+            {
+                opts.jobs = stoi(arg.substr(7));
+            } 
+            catch (const exception&) 
+            {
+                return false;
+            }
+            if (opts.jobs < 0) return false;
+        } 
+        else if (arg.rfind("--lookup=", 0) == 0) 
+        {
+            if (sscanf(arg.c_str() + 9, "%d:%d", &opts.lookupLine, &opts.lookupCol) != 2 || 
+                opts.lookupLine < 1 || opts.lookupCol < 1) 
+                return false;
+        } 
+        else if (arg == "--cfg") 
+        {
+            opts.buildCFG = true;
+        } 
+        else if (arg == "--ssa") 
+        {
+            opts.ssa = true;
+        } 
+        else if (arg.rfind("--opt=", 0) == 0) 
+        {
+            stringstream list(arg.substr(6));
+            string item;
+            while (getline(list, item, ',')) 
+            {
+                if (!opts.optimizer.enable(item)) return false;
+            }
+            opts.ssa = true;
+        } 
+        else if (arg.rfind("--unroll=", 0) == 0) 
+        {
+            try 
+            {
+                int budget = stoi(arg.substr(9));
+                if (budget < 0) return false;
+                opts.optimizer.unrollBudget = (size_t)budget;
+            } 
+            catch (const exception&) 
+            {
+                return false;
+            }
+        } 
+        else if (arg == "-O") 
+        {
+            opts.optimizer.enableAll();
+            opts.ssa = true;
+        } 
+        else if (arg == "--run") 
+        {
+            opts.run = true;
+        } 
+        else if (arg == "--incremental") 
+        {
+            opts.incremental = true;
+        } 
+        else if (!arg.empty() && arg[0] != '-') 
+        {
+            opts.revisions.push_back(arg);
+        } 
+        else 
+        {
+            return false;
+        }
+    }
+    if (!opts.revisions.empty()) 
+    {
+        opts.inputFile = opts.revisions.back();
+        opts.revisions.pop_back();
+    }
+    if (!opts.revisions.empty() && !opts.incremental) return false;
+    if (opts.incremental && (opts.jobs >= 0 || opts.fused || opts.compareSemantic || opts.lookupLine)) 
+        return false;
+    // shared identifiers keep one position, and only the two-pass analysis records scopes
+    if (opts.lookupLine && (opts.hashCons || opts.jobs >= 0 || opts.fused || opts.compareSemantic)) 
+        return false;
+    return true;
+}
+
+static bool readSource(const string& path, string& code) 
+{
+    ifstream file(path);
+    if (!file.is_open()) 
+    {
+        cerr << "Error: Could not open " << path << "\n";
+        return false;
+    }
     stringstream buffer;
     buffer << file.rdbuf();
-    string code = buffer.str();
+    code = buffer.str();
+    return true;
+}
 
-    file.close();
+static void incrementalBuild(IncrementalCompiler& compiler, shared_ptr<ProgramNode> ast, 
+                             const string& code, const string& path) 
+{
+    compiler.build(ast, code);
+    cerr << "[incremental] " << path << ": " << compiler.functions() << " functions, " 
+         << compiler.recheckedFunctions() << " re-checked, " 
+         << compiler.functions() - compiler.recheckedFunctions() << " reused\n";
+}
+
+int main(int argc, char* argv[]) 
+{
+    ios::sync_with_stdio(false);
+
+    DriverOptions opts;
+    if (!parseArgs(argc, argv, opts)) 
+    {
+        printUsage(cerr);
+        return 1;
+    }
+    bool text = opts.format == DumpFormat::Text;
+
+    string code;
+    if (!readSource(opts.inputFile, code)) return 1;
 
     try 
     {
         
-        Parser parser(code);
+        PhaseTimer timer(opts.timing);
+        IncrementalCompiler incremental;
+        for (const string& revision : opts.revisions) 
+        {
+            string earlier;
+            if (!readSource(revision, earlier)) return 1;
+            Parser parser(earlier, opts.hashCons);
+            incrementalBuild(incremental, parser.parseProgram(), earlier, revision);
+            timer.lap("incremental build of " + revision);
+        }
+        
+        Parser parser(code, opts.hashCons);
         auto ast = parser.parseProgram();
+        timer.lap("parse");
+        
+        if (opts.dumpTokens) 
+        {
+            parser.printTokens(cout, opts.format);
+            timer.lap("dump tokens");
+        }
         
-        cout << "AST:" << endl;
-        ast->print(cout);
+        if (opts.dumpAST) 
+        {
+            if (text) 
+            {
+                cout << "AST:\n";
+                ast->print(cout);
+            } 
+            else 
+            {
+                ast->printJson(cout);
+            }
+            timer.lap("dump AST");
+        }
         
         
         ScopeAnalyzer scopeAnalyzer;
-        scopeAnalyzer.analyze(ast);
-        cout << "\nScope analysis passed" << endl;
+        FusedSemanticAnalyzer fusedAnalyzer;
+        ParallelSemanticAnalyzer parallelAnalyzer(opts.jobs < 0 ? 1 : opts.jobs);
+        if (opts.lookupLine) scopeAnalyzer.recordScopeTree();
+        if (opts.incremental) 
+        {
+            incrementalBuild(incremental, ast, code, opts.inputFile);
+            timer.lap("scope analysis + type checking + IR generation (incremental)");
+            if (text) cout << "\nScope analysis passed\nType checking passed\n";
+        } 
+        else if (opts.jobs >= 0) 
+        {
+            parallelAnalyzer.analyze(ast);
+            timer.lap("scope analysis + type checking (parallel)");
+            if (text) cout << "\nScope analysis passed\nType checking passed\n";
+        } 
+        else if (opts.fused || opts.compareSemantic) 
+        {
+            if (opts.compareSemantic) 
+            {
+                // the fused pass runs last, so its annotations are the ones IR generation sees
+                using clock = chrono::steady_clock;
+                auto ms = [](clock::time_point a, clock::time_point b) 
+                {
+                    return chrono::duration<double, milli>(b - a).count();
+                };
+                auto t0 = clock::now();
+                scopeAnalyzer.analyze(ast);
+                auto t1 = clock::now();
+                TypeChecker typeChecker;
+                typeChecker.check(ast);
+                auto t2 = clock::now();
+                fusedAnalyzer.analyze(ast);
+                auto t3 = clock::now();
+                cerr << "[semantic] two-pass: scope " << ms(t0, t1) << " ms + types " << ms(t1, t2) 
+                     << " ms = " << ms(t0, t2) << " ms | fused: " << ms(t2, t3) << " ms\n";
+            } 
+            else 
+            {
+                fusedAnalyzer.analyze(ast);
+            }
+            timer.lap("scope analysis + type checking (fused)");
+            if (text) cout << "\nScope analysis passed\nType checking passed\n";
+        } 
+        else 
+        {
+            scopeAnalyzer.analyze(ast);
+            timer.lap("scope analysis");
+            if (text) cout << "\nScope analysis passed\n";
+            if (opts.lookupLine) 
+            {
+                printLookup(cout, code, *scopeAnalyzer.getScopeTree(), opts);
+                timer.lap("lookup");
+            }
+            
+            
+            TypeChecker typeChecker;
+            typeChecker.check(ast);
+            timer.lap("type checking");
+            if (text) cout << "Type checking passed\n";
+        }
         
         
-        TypeChecker typeChecker(scopeAnalyzer.getScopeStack());
-        typeChecker.check(ast);
-        cout << "Type checking passed" << endl;
+        IRGenerator fullGen;
+        if (!opts.incremental) 
+        {
+            fullGen.generate(ast);
+            timer.lap("IR generation");
+        }
+        IRGenerator& irGen = opts.incremental ? incremental.getGenerator() : fullGen;
+        if (text) cout << "\nIR generation passed\n";
+        if (opts.ssa) 
+        {
+            OptimizerOptions optimizerOptions = opts.optimizer;
+            optimizerOptions.dumpSSA = opts.dumpSSA;
+            Optimizer optimizer(optimizerOptions);
+            optimizer.run(irGen.getCode(), cout);
+            timer.lap("SSA round trip");
+            if (opts.stats) optimizer.printStats(cerr);
+        }
+        if (opts.stats) 
+        {
+            cerr << "[stats] AST nodes: " << countASTNodes(ast) << "\n";
+            cerr << "[stats] IR instructions: " << irGen.getCode().size() << "\n";
+            timer.lap("stats");
+        }
+        if (opts.dumpIR) 
+        {
+            irGen.printIR(cout, opts.format);
+            timer.lap("dump IR");
+        }
         
+        if (opts.buildCFG) 
+        {
+            auto graphs = buildCFGs(irGen.getCode());
+            timer.lap("CFG construction");
+            if (opts.stats) 
+            {
+                size_t blocks = 0, edges = 0;
+                for (const auto& graph : graphs) 
+                {
+                    blocks += graph.blockCount();
+                    edges += graph.edgeCount();
+                }
+                cerr << "[stats] CFG: " << graphs.size() << " functions, " << blocks 
+                     << " blocks, " << edges << " edges\n";
+            }
+            if (opts.dumpCFG) 
+            {
+                printCFGs(cout, graphs, irGen.getCode(), opts.format);
+                timer.lap("dump CFG");
+            }
+        }
         
-        IRGenerator irGen;
-        irGen.generate(ast);
-        cout << "\nIR generation passed" << endl;
-        irGen.printIR(cout);
+        if (opts.run) 
+        {
+            Interpreter interpreter(irGen.getCode());
+            RuntimeValue value;
+            bool ran = interpreter.run(value);
+            timer.lap("run");
+            string returned = ran ? interpreter.format(value) : "no main function";
+            if (text) cout << (ran ? "main returned " : "") << returned << "\n";
+            else 
+            {
+                cout << "{\"run\":";
+                OutputBuffer out(cout);
+                out.jsonString(returned);
+                out << "}\n";
+            }
+            if (opts.stats) cerr << "[stats] interpreter: " << interpreter.dispatchCount() << " instructions dispatched\n";
+        }
     } 
     catch (const runtime_error& e) 
     {
         cerr << "Lexer error: " << e.what() << endl;
         return 1;
     } 
+    catch (const InterpreterError& e) 
+    {
+        cerr << e.what() << endl;
+        return 1;
+    } 
     catch (const ParseError& e) 
     {
         cerr << "Parse error: " << e.message() << endl;
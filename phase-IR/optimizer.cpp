@@ -0,0 +1,200 @@
+#include "optimizer.h"
+#include "output_buffer.h"
+
+using namespace std;
+
+bool OptimizerOptions::enable(const string& pass) 
+{
+    if (pass == "sccp") constants = true;
+    else if (pass == "copy") copies = true;
+    else if (pass == "lvn") localNumbering = true;
+    else if (pass == "gvn") globalNumbering = true;
+    else if (pass == "dce") deadCode = true;
+    else if (pass == "fuse") fuseBranches = true;
+    else if (pass == "licm") invariants = true;
+    else if (pass == "iv") inductionVariables = true;
+    else if (pass == "pre") partialRedundancy = true;
+    else if (pass == "unroll") unroll = true;
+    else return false;
+    return true;
+}
+
+void OptimizerOptions::enableAll() 
+{
+    constants = true;
+    copies = true;
+    globalNumbering = true;
+    deadCode = true;
+    fuseBranches = true;
+    invariants = true;
+    inductionVariables = true;
+    partialRedundancy = true;
+    unroll = true;
+}
+
+void Optimizer::run(IRBuffer& code, ostream& ssaOut) 
+{
+    OutputBuffer out(ssaOut);
+    if (options.dumpSSA) out << "\n=== SSA FORM ===\n";
+    
+    // function labels are renumbered after those of the top-level code
+    uint32_t nextLabel = 0;
+    for (size_t i = 0; i < code.size(); i++) 
+    {
+        if (code.op(i) == IROpcode::FUNC_BEGIN) 
+        {
+            while (code.op(i) != IROpcode::FUNC_END) i++;
+            continue;
+        }
+        if (code.op(i) == IROpcode::LABEL) nextLabel = max(nextLabel, code.result(i).index() + 1);
+    }
+    
+    unordered_map<uint32_t, CallEffect> effects;
+    if (options.invariants) effects = findCallEffects(code);
+    
+    vector<IRInstruction> result;
+    result.reserve(code.size());
+    for (size_t i = 0; i < code.size(); i++) 
+    {
+        if (code.op(i) != IROpcode::FUNC_BEGIN) 
+        {
+            result.push_back(code.at(i));
+            continue;
+        }
+        cfg.build(code, i);
+        function.build(code, cfg);
+        functionCount++;
+        blockCount += function.blocks.size();
+        droppedCount += function.droppedInstructions;
+        for (const auto& block : function.blocks) phiCount += block.phis.size();
+        if (options.constants) 
+        {
+            ConstantPropagationResult r = propagateConstants(function, code);
+            constants.folded += r.folded;
+            constants.branches += r.branches;
+            constants.unreachable += r.unreachable;
+        }
+        if (options.copies) 
+        {
+            CopyPropagationResult r = propagateCopies(function);
+            copies.copies += r.copies;
+            copies.coalesced += r.coalesced;
+        }
+        if (options.localNumbering || options.globalNumbering) 
+        {
+            ValueNumberingResult r = numberValues(function, code, options.globalNumbering);
+            numbering.redundant += r.redundant;
+            numbering.phis += r.phis;
+        }
+        if (options.invariants) 
+        {
+            InvariantMotionResult r = hoistInvariants(function, code, effects);
+            motion.loops += r.loops;
+            motion.hoisted += r.hoisted;
+            motion.calls += r.calls;
+        }
+        if (options.inductionVariables) 
+        {
+            InductionVariableResult r = reduceInductionVariables(function, code);
+            induction.found += r.found;
+            induction.reduced += r.reduced;
+            induction.eliminated += r.eliminated;
+        }
+        if (options.partialRedundancy) 
+        {
+            PartialRedundancyResult r = eliminatePartialRedundancy(function, code);
+            redundancy.expressions += r.expressions;
+            redundancy.removed += r.removed;
+            redundancy.inserted += r.inserted;
+            redundancy.phis += r.phis;
+        }
+        if (options.unroll && options.unrollBudget > 0) 
+        {
+            UnrollResult r = unrollLoops(function, code, options.unrollBudget);
+            unrolling.full += r.full;
+            unrolling.partial += r.partial;
+            unrolling.copies += r.copies;
+            
+            // copies of a fully unrolled loop start from constants; fold them again
+            if (r.full > 0 && options.constants) 
+            {
+                ConstantPropagationResult c = propagateConstants(function, code);
+                constants.folded += c.folded;
+                constants.branches += c.branches;
+                constants.unreachable += c.unreachable;
+            }
+            if (r.full > 0 && options.copies) 
+            {
+                CopyPropagationResult c = propagateCopies(function);
+                copies.copies += c.copies;
+                copies.coalesced += c.coalesced;
+            }
+        }
+        if (options.deadCode) 
+        {
+            DeadCodeResult r = eliminateDeadCode(function, code);
+            deadCode.values += r.values;
+            deadCode.stores += r.stores;
+            deadCode.callResults += r.callResults;
+            deadCode.unreachable += r.unreachable;
+        }
+        if (options.fuseBranches) fusion.fused += ::fuseBranches(function).fused;
+        if (options.dumpSSA) function.dump(out, code);
+        function.toTAC(result, nextLabel);
+        i = cfg.functionEnd();
+    }
+    
+    code.clear();
+    for (const auto& instr : result) code.push_back(instr);
+    if (options.dumpSSA) out << "================\n\n";
+}
+
+void Optimizer::printStats(ostream& os) const 
+{
+    os << "[stats] SSA: " << functionCount << " functions, " << blockCount << " blocks, "
+       << phiCount << " phis, " << droppedCount << " unreachable instructions dropped\n";
+    if (options.constants) 
+    {
+        os << "[stats] constants: " << constants.folded << " folded, " << constants.branches 
+           << " branches resolved, " << constants.unreachable << " unreachable instructions removed\n";
+    }
+    if (options.copies) 
+    {
+        os << "[stats] copies: " << copies.copies << " propagated, " << copies.coalesced << " coalesced\n";
+    }
+    if (options.localNumbering || options.globalNumbering) 
+    {
+        os << "[stats] value numbering: " << numbering.redundant << " redundant instructions, " 
+           << numbering.phis << " redundant phis\n";
+    }
+    if (options.invariants) 
+    {
+        os << "[stats] loop-invariant code motion: " << motion.hoisted << " instructions hoisted out of " 
+           << motion.loops << " loops, " << motion.calls << " calls among them\n";
+    }
+    if (options.inductionVariables) 
+    {
+        os << "[stats] induction variables: " << induction.found << " found, " << induction.reduced 
+           << " multiplications reduced, " << induction.eliminated << " eliminated\n";
+    }
+    if (options.partialRedundancy) 
+    {
+        os << "[stats] partial redundancy: " << redundancy.removed << " computations removed, " << redundancy.inserted 
+           << " inserted, " << redundancy.phis << " phis, over " << redundancy.expressions << " expressions\n";
+    }
+    if (options.unroll) 
+    {
+        os << "[stats] loop unrolling: " << unrolling.full << " loops unrolled fully, " << unrolling.partial 
+           << " partially, " << unrolling.copies << " body copies\n";
+    }
+    if (options.deadCode) 
+    {
+        os << "[stats] dead code: " << deadCode.removed() << " instructions removed (" << deadCode.values 
+           << " unused values, " << deadCode.stores << " dead stores, " << deadCode.unreachable 
+           << " unreachable), " << deadCode.callResults << " call results dropped\n";
+    }
+    if (options.fuseBranches) 
+    {
+        os << "[stats] branch fusion: " << fusion.fused << " comparisons fused into branches\n";
+    }
+}
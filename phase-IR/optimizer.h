@@ -0,0 +1,66 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include "ir.h"
+#include "cfg.h"
+#include "ssa.h"
+#include "passes.h"
+
+using namespace std;
+
+struct OptimizerOptions 
+{
+    bool dumpSSA = false;       // print each function's SSA form before leaving it
+    bool constants = false;     // sparse conditional constant propagation
+    bool copies = false;        // copy propagation and coalescing
+    bool localNumbering = false;    // value numbering within basic blocks
+    bool globalNumbering = false;   // value numbering over the dominator tree
+    bool deadCode = false;      // dead code and dead store elimination
+    bool fuseBranches = false;  // compare-and-branch fusion
+    bool invariants = false;    // loop-invariant code motion
+    bool inductionVariables = false;    // induction variable strength reduction
+    bool partialRedundancy = false;     // partial redundancy elimination by lazy code motion
+    bool unroll = false;        // loop unrolling
+    size_t unrollBudget = 32;   // instructions an unrolled loop may grow to
+    
+    // turns on a pass by its --opt name: sccp, copy, lvn, gvn, licm, iv, pre, unroll, dce, fuse
+    bool enable(const string& pass);
+    void enableAll();
+};
+
+// Takes every function of a program through SSA and back to TAC, running
+// the enabled passes on the SSA form in between. Top-level statements are
+// left as they are.
+class Optimizer 
+{
+private:
+    OptimizerOptions options;
+    ControlFlowGraph cfg;
+    SSAFunction function;
+    size_t functionCount;
+    size_t blockCount;
+    size_t phiCount;
+    size_t droppedCount;
+    ConstantPropagationResult constants;
+    CopyPropagationResult copies;
+    ValueNumberingResult numbering;
+    DeadCodeResult deadCode;
+    BranchFusionResult fusion;
+    InvariantMotionResult motion;
+    InductionVariableResult induction;
+    PartialRedundancyResult redundancy;
+    UnrollResult unrolling;
+
+public:
+    explicit Optimizer(const OptimizerOptions& opts)
+        : options(opts), functionCount(0), blockCount(0), phiCount(0), droppedCount(0) {}
+        
+    // rewrites code in place; SSA dumps go to ssaOut
+    void run(IRBuffer& code, ostream& ssaOut);
+    void printStats(ostream& os) const;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include "output_buffer.h"
+
+using namespace std;
+
+OutputBuffer::OutputBuffer(ostream& out, size_t cap)
+    : os(out), data(new char[cap < 4096 ? 4096 : cap]), capacity(cap < 4096 ? 4096 : cap) 
+{
+    cur = data.get();
+    limit = cur + capacity;
+}
+
+OutputBuffer::~OutputBuffer() 
+{
+    flush();
+}
+
+OutputBuffer& OutputBuffer::operator<<(long long v) 
+{
+    char tmp[24];
+    int n = 0;
+    unsigned long long u = v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+    do 
+    {
+        tmp[n++] = char('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (v < 0) tmp[n++] = '-';
+    if (limit - cur < n) flush();
+    while (n > 0) *cur++ = tmp[--n];
+    return *this;
+}
+
+void OutputBuffer::jsonString(const string& s) 
+{
+    static const char hex[] = "0123456789abcdef";
+    *this << '"';
+    for (char c : s) 
+    {
+        switch (c) 
+        {
+            case '"': write("\\\"", 2); break;
+            case '\\': write("\\\\", 2); break;
+            case '\n': write("\\n", 2); break;
+            case '\t': write("\\t", 2); break;
+            case '\r': write("\\r", 2); break;
+            default:
+                if ((unsigned char)c < 0x20) 
+                {
+                    write("\\u00", 4);
+                    *this << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+                }
+                else 
+                {
+                    *this << c;
+                }
+        }
+    }
+    *this << '"';
+}
+
+void OutputBuffer::writeSlow(const char* s, size_t n) 
+{
+    flush();
+    if (n >= capacity) 
+    {
+        os.write(s, n);
+        return;
+    }
+    memcpy(cur, s, n);
+    cur += n;
+}
+
+void OutputBuffer::flush() 
+{
+    if (cur == data.get()) return;
+    os.write(data.get(), cur - data.get());
+    cur = data.get();
+}
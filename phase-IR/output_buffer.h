@@ -0,0 +1,88 @@
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <memory>
+
+using namespace std;
+
+enum class DumpFormat 
+{
+    Text,
+    JsonLines
+};
+
+// Accumulates dump output in one large buffer and hands it to the stream
+// in big chunks instead of flushing every line.
+class OutputBuffer 
+{
+private:
+    ostream& os;
+    unique_ptr<char[]> data;
+    char* cur;
+    char* limit;
+    size_t capacity;
+
+public:
+    OutputBuffer(ostream& out, size_t capacity = 1 << 20);
+    ~OutputBuffer();
+
+    OutputBuffer& operator<<(const string& s) 
+    {
+        write(s.data(), s.size());
+        return *this;
+    }
+
+    OutputBuffer& operator<<(const char* s) 
+    {
+        write(s, strlen(s));
+        return *this;
+    }
+
+    OutputBuffer& operator<<(char c) 
+    {
+        if (cur == limit) flush();
+        *cur++ = c;
+        return *this;
+    }
+
+    OutputBuffer& operator<<(long long v);
+    OutputBuffer& operator<<(int v) { return *this << (long long)v; }
+    OutputBuffer& operator<<(size_t v) { return *this << (long long)v; }
+
+    void write(const char* s, size_t n) 
+    {
+        if ((size_t)(limit - cur) < n) 
+        {
+            writeSlow(s, n);
+            return;
+        }
+        memcpy(cur, s, n);
+        cur += n;
+    }
+
+    void indent(int n) 
+    {
+        size_t len = (size_t)n * 2;
+        while ((size_t)(limit - cur) < len) 
+        {
+            size_t room = limit - cur;
+            memset(cur, ' ', room);
+            cur += room;
+            len -= room;
+            flush();
+        }
+        memset(cur, ' ', len);
+        cur += len;
+    }
+
+    void jsonString(const string& s);
+    void flush();
+
+private:
+    void writeSlow(const char* s, size_t n);
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "parallel_semantic.h"
+#include "type_checker.h"
+#include "work_pool.h"
+#include "parser.h"
+#include <exception>
+
+using namespace std;
+
+static void rethrowFirst(const vector<exception_ptr>& errors) 
+{
+    for (const auto& error : errors) 
+    {
+        if (error) rethrow_exception(error);
+    }
+}
+
+void ParallelSemanticAnalyzer::analyze(shared_ptr<ProgramNode> program) 
+{
+    const auto& items = program->items;
+    vector<exception_ptr> scopeErrors(items.size()), typeErrors(items.size());
+    
+    // global declarations and top-level statements run in order on this
+    // thread, so expressions they share with bodies are typed before the
+    // workers start
+    vector<size_t> functions;
+    TypeChecker checker;
+    globalAnalyzer.declareFunctions(program);
+    for (size_t i = 0; i < items.size(); i++) 
+    {
+        if (dynamic_pointer_cast<FunctionNode>(items[i])) 
+        {
+            functions.push_back(i);
+            continue;
+        }
+        try 
+        {
+            globalAnalyzer.analyzeItem(items[i], (int)i);
+        } 
+        catch (...) 
+        {
+            scopeErrors[i] = current_exception();
+            globalAnalyzer.resetScopes();
+            continue;
+        }
+        try 
+        {
+            checker.checkItem(items[i]);
+        } 
+        catch (...) 
+        {
+            typeErrors[i] = current_exception();
+        }
+    }
+    
+    WorkStealingPool pool(jobs);
+    const ScopeStack* globals = &globalAnalyzer.getScopeStack();
+    workerAnalyzers.clear();
+    for (unsigned w = 0; w < pool.size(); w++) 
+    {
+        workerAnalyzers.push_back(make_unique<ScopeAnalyzer>(globals));
+    }
+    vector<TypeChecker> workerCheckers(pool.size());
+    
+    pool.run(functions.size(), [&](size_t task, unsigned worker) 
+    {
+        size_t index = functions[task];
+        try 
+        {
+            workerAnalyzers[worker]->analyzeItem(items[index], (int)index);
+        } 
+        catch (...) 
+        {
+            scopeErrors[index] = current_exception();
+            workerAnalyzers[worker]->resetScopes();
+            return;
+        }
+        try 
+        {
+            workerCheckers[worker].checkItem(items[index]);
+        } 
+        catch (...) 
+        {
+            typeErrors[index] = current_exception();
+        }
+    });
+    rethrowFirst(scopeErrors);
+    rethrowFirst(typeErrors);
+}
@@ -0,0 +1,29 @@
+#ifndef PARALLEL_SEMANTIC_H
+#define PARALLEL_SEMANTIC_H
+
+#include <memory>
+#include <vector>
+#include "scope_analyzer.h"
+
+using namespace std;
+
+// Scope and type checking with function bodies spread over a work-stealing
+// pool. The global table is built first; each worker then resolves bodies
+// against its own local ScopeStack. Errors are recorded per top-level item
+// and the one a sequential run would have hit first is rethrown, scope
+// errors taking precedence over type errors.
+class ParallelSemanticAnalyzer 
+{
+private:
+    unsigned jobs;
+    ScopeAnalyzer globalAnalyzer;
+    // kept alive because the AST points into their symbol arenas
+    vector<unique_ptr<ScopeAnalyzer>> workerAnalyzers;
+    
+public:
+    explicit ParallelSemanticAnalyzer(unsigned jobs) : jobs(jobs) {}
+    
+    void analyze(shared_ptr<ProgramNode> program);
+};
+
+#endif
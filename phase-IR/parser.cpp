@@ -1,122 +1,338 @@
 #include "parser.h"
 
-string indentStr(int n) 
-{ 
-    return string(n*2, ' '); 
+void ASTNode::print(ostream &os, int indent) const 
+{
+    OutputBuffer out(os);
+    dump(out, indent);
+}
+
+void ASTNode::printJson(ostream &os) const 
+{
+    OutputBuffer out(os);
+    dumpJson(out);
+    out << '\n';
 }
 
-// Implementation of print methods
-void ProgramNode::print(ostream &os, int indent) const 
+// Implementation of dump methods
+void ProgramNode::dump(OutputBuffer &out, int indent) const 
 {
-    os << indentStr(indent) << "Program\n";
-    for (auto &it : items) it->print(os, indent+1);
+    out.indent(indent); out << "Program\n";
+    for (auto &it : items) it->dump(out, indent+1);
 }
 
-void BlockNode::print(ostream &os, int indent) const 
+void BlockNode::dump(OutputBuffer &out, int indent) const 
 {
-    os << indentStr(indent) << "Block\n";
-    for (auto &s : stmts) s->print(os, indent+1);
+    out.indent(indent); out << "Block\n";
+    for (auto &s : stmts) s->dump(out, indent+1);
 }
 
-void FunctionNode::print(ostream &os, int indent) const 
+void FunctionNode::dump(OutputBuffer &out, int indent) const 
 {
-    os << indentStr(indent) << "Function " << name << " : " << retType << "\n";
-    os << indentStr(indent+1) << "Params\n";
-    for (auto &p: params)
-        os << indentStr(indent+2) << p.first << " " << p.second << "\n";
-    body->print(os, indent+1);
+    out.indent(indent); out << "Function " << name << " : " << typeName(retType) << "\n";
+    out.indent(indent+1); out << "Params\n";
+    for (auto &p: params) 
+    {
+        out.indent(indent+2); out << typeName(p.first) << " " << p.second << "\n";
+    }
+    body->dump(out, indent+1);
 }
 
-void VarDeclNode::print(ostream &os, int indent) const 
+void VarDeclNode::dump(OutputBuffer &out, int indent) const 
 {
-    os << indentStr(indent) << "VarDecl " << typeName << " " << name;
+    out.indent(indent); out << "VarDecl " << ::typeName(typeName) << " " << name;
     if (init) 
     { 
-        os << " =\n"; 
-        init->print(os, indent+1); 
+        out << " =\n"; 
+        init->dump(out, indent+1); 
     }
     else 
     {
-        os << "\n";
+        out << "\n";
     }
 }
 
-void ReturnNode::print(ostream &os, int indent) const 
+void ReturnNode::dump(OutputBuffer &out, int indent) const 
 {
-    os << indentStr(indent) << "Return\n";
-    if (expr) expr->print(os, indent+1);
+    out.indent(indent); out << "Return\n";
+    if (expr) expr->dump(out, indent+1);
 }
 
-void IfNode::print(ostream &os, int indent) const 
+void IfNode::dump(OutputBuffer &out, int indent) const 
 {
-    os << indentStr(indent) << "If\n";
-    os << indentStr(indent+1) << "Cond\n"; cond->print(os, indent+2);
-    os << indentStr(indent+1) << "Then\n"; thenBlock->print(os, indent+2);
+    out.indent(indent); out << "If\n";
+    out.indent(indent+1); out << "Cond\n"; cond->dump(out, indent+2);
+    out.indent(indent+1); out << "Then\n"; thenBlock->dump(out, indent+2);
     if (elseBlock) 
     {
-        os << indentStr(indent+1) << "Else\n"; elseBlock->print(os, indent+2);
+        out.indent(indent+1); out << "Else\n"; elseBlock->dump(out, indent+2);
+    }
+}
+
+void WhileNode::dump(OutputBuffer &out, int indent) const 
+{
+    out.indent(indent); out << "While\n";
+    out.indent(indent+1); out << "Cond\n"; cond->dump(out, indent+2);
+    out.indent(indent+1); out << "Body\n"; body->dump(out, indent+2);
+}
+
+void ExprStmtNode::dump(OutputBuffer &out, int indent) const 
+{
+    out.indent(indent); out << "ExprStmt\n";
+    expr->dump(out, indent+1);
+}
+
+void BinaryOpNode::dump(OutputBuffer &out, int indent) const 
+{
+    out.indent(indent); out << "BinaryOp(" << op << ")\n";
+    left->dump(out, indent+1);
+    right->dump(out, indent+1);
+}
+
+void UnaryOpNode::dump(OutputBuffer &out, int indent) const 
+{
+    out.indent(indent); out << (postfix ? "Postfix" : "Unary") << "Op(" << op << ")\n";
+    operand->dump(out, indent+1);
+}
+
+void LiteralNode::dump(OutputBuffer &out, int indent) const 
+{
+    out.indent(indent); out << "Literal " << typeName(kind) << "(" << value << ")\n";
+}
+
+void IdentifierNode::dump(OutputBuffer &out, int indent) const 
+{
+    out.indent(indent); out << "Ident " << name << "\n";
+}
+
+void CallNode::dump(OutputBuffer &out, int indent) const 
+{
+    out.indent(indent); out << "Call\n";
+    callee->dump(out, indent+1);
+    out.indent(indent+1); out << "Args\n";
+    for (auto &a: args) a->dump(out, indent+2);
+}
+
+void AssignmentNode::dump(OutputBuffer &out, int indent) const 
+{
+    out.indent(indent); out << "Assign(" << op << ")\n";
+    left->dump(out, indent+1);
+    right->dump(out, indent+1);
+}
+
+// JSON lines: one object per top-level item, children nested inline
+void ProgramNode::dumpJson(OutputBuffer &out) const 
+{
+    for (size_t i = 0; i < items.size(); i++) 
+    {
+        if (i > 0) out << '\n';
+        items[i]->dumpJson(out);
+    }
+}
+
+void BlockNode::dumpJson(OutputBuffer &out) const 
+{
+    out << "{\"node\":\"Block\",\"stmts\":[";
+    for (size_t i = 0; i < stmts.size(); i++) 
+    {
+        if (i > 0) out << ',';
+        stmts[i]->dumpJson(out);
+    }
+    out << "]}";
+}
+
+void FunctionNode::dumpJson(OutputBuffer &out) const 
+{
+    out << "{\"node\":\"Function\",\"name\":"; out.jsonString(name);
+    out << ",\"ret\":\"" << typeName(retType) << '"';
+    out << ",\"params\":[";
+    for (size_t i = 0; i < params.size(); i++) 
+    {
+        if (i > 0) out << ',';
+        out << "{\"type\":\"" << typeName(params[i].first) << '"';
+        out << ",\"name\":"; out.jsonString(params[i].second);
+        out << '}';
+    }
+    out << "],\"body\":";
+    body->dumpJson(out);
+    out << '}';
+}
+
+void VarDeclNode::dumpJson(OutputBuffer &out) const 
+{
+    out << "{\"node\":\"VarDecl\",\"type\":\"" << ::typeName(typeName) << '"';
+    out << ",\"name\":"; out.jsonString(name);
+    if (init) 
+    {
+        out << ",\"init\":";
+        init->dumpJson(out);
+    }
+    out << '}';
+}
+
+void ReturnNode::dumpJson(OutputBuffer &out) const 
+{
+    out << "{\"node\":\"Return\"";
+    if (expr) 
+    {
+        out << ",\"expr\":";
+        expr->dumpJson(out);
     }
+    out << '}';
 }
 
-void WhileNode::print(ostream &os, int indent) const 
+void IfNode::dumpJson(OutputBuffer &out) const 
 {
-    os << indentStr(indent) << "While\n";
-    os << indentStr(indent+1) << "Cond\n"; cond->print(os, indent+2);
-    os << indentStr(indent+1) << "Body\n"; body->print(os, indent+2);
+    out << "{\"node\":\"If\",\"cond\":"; cond->dumpJson(out);
+    out << ",\"then\":"; thenBlock->dumpJson(out);
+    if (elseBlock) 
+    {
+        out << ",\"else\":"; elseBlock->dumpJson(out);
+    }
+    out << '}';
 }
 
-void ExprStmtNode::print(ostream &os, int indent) const 
+void WhileNode::dumpJson(OutputBuffer &out) const 
 {
-    os << indentStr(indent) << "ExprStmt\n";
-    expr->print(os, indent+1);
+    out << "{\"node\":\"While\",\"cond\":"; cond->dumpJson(out);
+    out << ",\"body\":"; body->dumpJson(out);
+    out << '}';
 }
 
-void BinaryOpNode::print(ostream &os, int indent) const 
+void ExprStmtNode::dumpJson(OutputBuffer &out) const 
 {
-    os << indentStr(indent) << "BinaryOp(" << op << ")\n";
-    left->print(os, indent+1);
-    right->print(os, indent+1);
+    out << "{\"node\":\"ExprStmt\",\"expr\":"; expr->dumpJson(out);
+    out << '}';
 }
 
-void UnaryOpNode::print(ostream &os, int indent) const 
+void BinaryOpNode::dumpJson(OutputBuffer &out) const 
 {
-    os << indentStr(indent) << (postfix ? "Postfix" : "Unary") << "Op(" << op << ")\n";
-    operand->print(os, indent+1);
+    out << "{\"node\":\"BinaryOp\",\"op\":"; out.jsonString(op);
+    out << ",\"left\":"; left->dumpJson(out);
+    out << ",\"right\":"; right->dumpJson(out);
+    out << '}';
 }
 
-void LiteralNode::print(ostream &os, int indent) const 
+void UnaryOpNode::dumpJson(OutputBuffer &out) const 
 {
-    os << indentStr(indent) << "Literal " << kind << "(" << value << ")\n";
+    out << "{\"node\":\"" << (postfix ? "PostfixOp" : "UnaryOp") << "\",\"op\":"; out.jsonString(op);
+    out << ",\"operand\":"; operand->dumpJson(out);
+    out << '}';
 }
 
-void IdentifierNode::print(ostream &os, int indent) const 
+void LiteralNode::dumpJson(OutputBuffer &out) const 
 {
-    os << indentStr(indent) << "Ident " << name << "\n";
+    out << "{\"node\":\"Literal\",\"kind\":\"" << typeName(kind) << '"';
+    out << ",\"value\":"; out.jsonString(value);
+    out << '}';
 }
 
-void CallNode::print(ostream &os, int indent) const 
+void IdentifierNode::dumpJson(OutputBuffer &out) const 
 {
-    os << indentStr(indent) << "Call\n";
-    callee->print(os, indent+1);
-    os << indentStr(indent+1) << "Args\n";
-    for (auto &a: args) a->print(os, indent+2);
+    out << "{\"node\":\"Ident\",\"name\":"; out.jsonString(name);
+    out << '}';
 }
 
-void AssignmentNode::print(ostream &os, int indent) const 
+void CallNode::dumpJson(OutputBuffer &out) const 
 {
-    os << indentStr(indent) << "Assign(" << op << ")\n";
-    left->print(os, indent+1);
-    right->print(os, indent+1);
+    out << "{\"node\":\"Call\",\"callee\":"; callee->dumpJson(out);
+    out << ",\"args\":[";
+    for (size_t i = 0; i < args.size(); i++) 
+    {
+        if (i > 0) out << ',';
+        args[i]->dumpJson(out);
+    }
+    out << "]}";
+}
+
+void AssignmentNode::dumpJson(OutputBuffer &out) const 
+{
+    out << "{\"node\":\"Assign\",\"op\":"; out.jsonString(op);
+    out << ",\"left\":"; left->dumpJson(out);
+    out << ",\"right\":"; right->dumpJson(out);
+    out << '}';
 }
 
 // Parser implementation
-Parser::Parser(const string &src): lx(src) 
+Parser::Parser(const string &src, bool hashConsExprs): lx(src), hashCons(hashConsExprs) 
 { 
+    enterConsScope();
     advance(); 
 }
 
+void Parser::enterConsScope() 
+{
+    if (hashCons) consMarks.push_back(consUndo.size());
+}
+
+void Parser::exitConsScope() 
+{
+    if (!hashCons) return;
+    size_t mark = consMarks.back();
+    consMarks.pop_back();
+    while (consUndo.size() > mark) 
+    {
+        auto& entry = consUndo.back();
+        if (entry.second) consTable[entry.first] = entry.second;
+        else consTable.erase(entry.first);
+        consUndo.pop_back();
+    }
+}
+
+AST Parser::internKey(ConsKey key, AST node) 
+{
+    auto it = consTable.find(key);
+    if (it != consTable.end()) 
+    {
+        it->second->shared = true;
+        return it->second;
+    }
+    node->interned = true;
+    consTable.emplace(key, node);
+    consUndo.push_back({move(key), nullptr});
+    return node;
+}
+
+// A new declaration of name starts a new binding, so earlier uses must not be shared with later ones
+void Parser::forgetName(const string& name) 
+{
+    if (!hashCons) return;
+    ConsKey key{"I" + name, nullptr, nullptr};
+    auto it = consTable.find(key);
+    if (it == consTable.end()) return;
+    consUndo.push_back({key, it->second});
+    consTable.erase(it);
+}
+
+AST Parser::intern(shared_ptr<IdentifierNode> node) 
+{
+    if (!hashCons) return node;
+    return internKey({"I" + node->name, nullptr, nullptr}, node);
+}
+
+AST Parser::intern(shared_ptr<LiteralNode> node) 
+{
+    if (!hashCons) return node;
+    return internKey({"L" + string(1, char('0' + (int)node->kind)) + node->value, nullptr, nullptr}, node);
+}
+
+AST Parser::intern(shared_ptr<BinaryOpNode> node) 
+{
+    if (!hashCons || !node->left->interned || !node->right->interned) 
+        return node;
+    return internKey({"B" + node->op, node->left.get(), node->right.get()}, node);
+}
+
+AST Parser::intern(shared_ptr<UnaryOpNode> node) 
+{
+    if (!hashCons || node->postfix || node->op == "++" || node->op == "--" || 
+        !node->operand->interned) 
+        return node;
+    return internKey({"U" + node->op, node->operand.get(), nullptr}, node);
+}
+
 void Parser::advance() 
 {
+    lastEnd = cur.end;
     while (true) 
     {
         cur = lx.getNextToken();
@@ -147,29 +363,38 @@ shared_ptr<ProgramNode> Parser::parseProgram()
     return prog;
 }
 
-string Parser::parseTypeName() 
+TypeId Parser::parseTypeName() 
 {
-    if (cur.type == T_INT || cur.type == T_FLOAT || cur.type == T_BOOL || cur.type == T_STRING) 
+    TypeId t;
+    switch (cur.type) 
     {
-        string s = cur.value; advance(); return s;
+        case T_INT: t = TypeId::Int; break;
+        case T_FLOAT: t = TypeId::Float; break;
+        case T_BOOL: t = TypeId::Bool; break;
+        case T_STRING: t = TypeId::String; break;
+        default: throw ParseError(ParseError::ExpectedTypeToken, cur);
     }
-    throw ParseError(ParseError::ExpectedTypeToken, cur);
+    advance();
+    return t;
 }
 
 AST Parser::parseFunction() 
 {
+    int start = cur.pos;
     expect(T_FUNCTION, ParseError::FailedToFindToken);
-    string ret = parseTypeName();
+    TypeId ret = parseTypeName();
     if (cur.type != T_IDENTIFIER) throw ParseError(ParseError::ExpectedIdentifier, cur);
     string fname = cur.value; advance();
     expect(T_PARENL, ParseError::FailedToFindToken);
-    vector<pair<string,string>> params;
+    vector<pair<TypeId,string>> params;
+    vector<int> paramPositions;
     if (cur.type != T_PARENR) 
     {
         while (true) 
         {
-            string ptype = parseTypeName();
+            TypeId ptype = parseTypeName();
             if (cur.type != T_IDENTIFIER) throw ParseError(ParseError::ExpectedIdentifier, cur);
+            paramPositions.push_back(cur.pos);
             string pname = cur.value; advance();
             params.push_back({ptype,pname});
             if (cur.type == T_COMMA) { advance(); continue; }
@@ -177,18 +402,26 @@ AST Parser::parseFunction()
         }
     }
     expect(T_PARENR, ParseError::FailedToFindToken);
+    enterConsScope();
+    for (auto &p : params) forgetName(p.second);
     auto body = parseBlock();
+    exitConsScope();
     auto fn = make_shared<FunctionNode>();
     fn->retType = ret; fn->name = fname; fn->params = params; fn->body = body;
+    fn->pos = start; fn->paramPositions = paramPositions;
     return fn;
 }
 
 shared_ptr<BlockNode> Parser::parseBlock() 
 {
-    expect(T_BRACEL, ParseError::FailedToFindToken);
     auto block = make_shared<BlockNode>();
+    block->pos = cur.pos;
+    expect(T_BRACEL, ParseError::FailedToFindToken);
+    enterConsScope();
     while (cur.type != T_BRACER && cur.type != T_EOF)
         block->stmts.push_back(parseStatementOrDecl());
+    exitConsScope();
+    block->endPos = cur.end;
     expect(T_BRACER, ParseError::FailedToFindToken);
     return block;
 }
@@ -197,14 +430,17 @@ AST Parser::parseStatementOrDecl()
 {
     if (cur.type == T_INT || cur.type == T_FLOAT || cur.type == T_BOOL || cur.type == T_STRING) 
     {
-        string tname = parseTypeName();
+        TypeId tname = parseTypeName();
         if (cur.type != T_IDENTIFIER) throw ParseError(ParseError::ExpectedIdentifier, cur);
+        int namePos = cur.pos;
         string name = cur.value; advance();
         AST init = nullptr;
         if (cur.type == T_ASSIGNOP) { advance(); init = parseExpression(); }
+        int endPos = cur.pos;
         expect(T_SEMICOLON, ParseError::FailedToFindToken);
+        forgetName(name);
         auto v = make_shared<VarDeclNode>();
-        v->typeName = tname; v->name = name; v->init = init; return v;
+        v->typeName = tname; v->name = name; v->init = init; v->pos = namePos; v->endPos = endPos; return v;
     }
     if (cur.type == T_IF) return parseIf();
     if (cur.type == T_WHILE) return parseWhile();
@@ -238,7 +474,11 @@ AST Parser::parseIf()
         else 
         {
             auto tmp = make_shared<BlockNode>();
+            tmp->pos = cur.pos;
+            enterConsScope();
             tmp->stmts.push_back(parseStatementOrDecl());
+            exitConsScope();
+            tmp->endPos = lastEnd;
             elseB = tmp;
         }
     }
@@ -287,7 +527,7 @@ AST Parser::parseLogicalOr()
     {
         string op = "||"; advance();
         AST rhs = parseLogicalAnd();
-        auto bn = make_shared<BinaryOpNode>(); bn->op = op; bn->left = node; bn->right = rhs; node = bn;
+        auto bn = make_shared<BinaryOpNode>(); bn->op = op; bn->left = node; bn->right = rhs; node = intern(bn);
     }
     return node;
 }
@@ -299,7 +539,7 @@ AST Parser::parseLogicalAnd()
     {
         string op = "&&"; advance();
         AST rhs = parseEquality();
-        auto bn = make_shared<BinaryOpNode>(); bn->op = op; bn->left = node; bn->right = rhs; node = bn;
+        auto bn = make_shared<BinaryOpNode>(); bn->op = op; bn->left = node; bn->right = rhs; node = intern(bn);
     }
     return node;
 }
@@ -311,7 +551,7 @@ AST Parser::parseEquality()
     {
         string op = cur.value; advance();
         AST rhs = parseRelational();
-        auto bn = make_shared<BinaryOpNode>(); bn->op = op; bn->left = node; bn->right = rhs; node = bn;
+        auto bn = make_shared<BinaryOpNode>(); bn->op = op; bn->left = node; bn->right = rhs; node = intern(bn);
     }
     return node;
 }
@@ -323,7 +563,7 @@ AST Parser::parseRelational()
     {
         string op = cur.value; advance();
         AST rhs = parseAdditive();
-        auto bn = make_shared<BinaryOpNode>(); bn->op = op; bn->left = node; bn->right = rhs; node = bn;
+        auto bn = make_shared<BinaryOpNode>(); bn->op = op; bn->left = node; bn->right = rhs; node = intern(bn);
     }
     return node;
 }
@@ -335,7 +575,7 @@ AST Parser::parseAdditive()
     {
         string op = cur.value; advance();
         AST rhs = parseMultiplicative();
-        auto bn = make_shared<BinaryOpNode>(); bn->op = op; bn->left = node; bn->right = rhs; node = bn;
+        auto bn = make_shared<BinaryOpNode>(); bn->op = op; bn->left = node; bn->right = rhs; node = intern(bn);
     }
     return node;
 }
@@ -347,7 +587,7 @@ AST Parser::parseMultiplicative()
     {
         string op = cur.value; advance();
         AST rhs = parseUnary();
-        auto bn = make_shared<BinaryOpNode>(); bn->op = op; bn->left = node; bn->right = rhs; node = bn;
+        auto bn = make_shared<BinaryOpNode>(); bn->op = op; bn->left = node; bn->right = rhs; node = intern(bn);
     }
     return node;
 }
@@ -358,7 +598,7 @@ AST Parser::parseUnary()
     {
         string op = cur.value; advance();
         AST operand = parseUnary();
-        auto un = make_shared<UnaryOpNode>(); un->op = op; un->operand = operand; un->postfix = false; return un;
+        auto un = make_shared<UnaryOpNode>(); un->op = op; un->operand = operand; un->postfix = false; return intern(un);
     }
     if (cur.type == T_INCREMENT || cur.type == T_DECREMENT) 
     {
@@ -406,23 +646,23 @@ AST Parser::parsePrimary()
 {
     if (cur.type == T_IDENTIFIER) 
     {
-        auto id = make_shared<IdentifierNode>(); id->name = cur.value; advance(); return id;
+        auto id = make_shared<IdentifierNode>(); id->name = cur.value; id->pos = cur.pos; advance(); return intern(id);
     }
     if (cur.type == T_INTLIT) 
     {
-        auto lit = make_shared<LiteralNode>(); lit->kind = "int"; lit->value = cur.value; advance(); return lit;
+        auto lit = make_shared<LiteralNode>(); lit->kind = TypeId::Int; lit->value = cur.value; advance(); return intern(lit);
     }
     if (cur.type == T_FLOATLIT) 
     {
-        auto lit = make_shared<LiteralNode>(); lit->kind = "float"; lit->value = cur.value; advance(); return lit;
+        auto lit = make_shared<LiteralNode>(); lit->kind = TypeId::Float; lit->value = cur.value; advance(); return intern(lit);
     }
     if (cur.type == T_STRINGLIT) 
     {
-        auto lit = make_shared<LiteralNode>(); lit->kind = "string"; lit->value = cur.value; advance(); return lit;
+        auto lit = make_shared<LiteralNode>(); lit->kind = TypeId::String; lit->value = cur.value; advance(); return intern(lit);
     }
     if (cur.type == T_BOOLLIT) 
     {
-        auto lit = make_shared<LiteralNode>(); lit->kind = "bool"; lit->value = cur.value; advance(); return lit;
+        auto lit = make_shared<LiteralNode>(); lit->kind = TypeId::Bool; lit->value = cur.value; advance(); return intern(lit);
     }
     if (cur.type == T_PARENL) 
     {
@@ -443,15 +683,100 @@ AST Parser::parsePrimary()
     }
 }
 
-void Parser::printTokens(ostream &os) const 
+void Parser::printTokens(ostream &os, DumpFormat format) const 
 {
-    os << "=== TOKENS ===" << endl;
+    OutputBuffer out(os);
+    if (format == DumpFormat::JsonLines) 
+    {
+        for (size_t i = 0; i < tokens.size(); i++) 
+        {
+            const auto& t = tokens[i];
+            out << "{\"index\":" << i << ",\"type\":\"" << tokenTypeName(t.type) << "\",\"value\":";
+            out.jsonString(t.value);
+            out << "}\n";
+        }
+        return;
+    }
+    out << "=== TOKENS ===\n";
     for (size_t i = 0; i < tokens.size(); i++) {
         const auto& t = tokens[i];
-        os << "Token " << i << ": " 
-           << "Type=" << tokenTypeToString(t.type, t.value) 
-           << ", Value='" << t.value << "'";
+        out << "Token " << i << ": Type=" << tokenTypeName(t.type);
+        switch (t.type) 
+        {
+            case T_IDENTIFIER: out << "(\"" << t.value << "\")"; break;
+            case T_INTLIT: case T_FLOATLIT: case T_STRINGLIT: case T_BOOLLIT:
+                out << '(' << t.value << ')'; break;
+            default: break;
+        }
+        out << ", Value='" << t.value << "'\n";
     }
-    os << "Total tokens: " << tokens.size() << endl;
-    os << "==============" << endl;
+    out << "Total tokens: " << tokens.size() << "\n";
+    out << "==============\n";
+}
+
+static void collectNodes(const AST& node, unordered_set<const ASTNode*>& seen) 
+{
+    if (!node || !seen.insert(node.get()).second) return;
+
+    if (auto prog = dynamic_pointer_cast<ProgramNode>(node)) 
+    {
+        for (auto &it : prog->items) collectNodes(it, seen);
+    } 
+    else if (auto block = dynamic_pointer_cast<BlockNode>(node)) 
+    {
+        for (auto &st : block->stmts) collectNodes(st, seen);
+    } 
+    else if (auto func = dynamic_pointer_cast<FunctionNode>(node)) 
+    {
+        collectNodes(func->body, seen);
+    } 
+    else if (auto varDecl = dynamic_pointer_cast<VarDeclNode>(node)) 
+    {
+        collectNodes(varDecl->init, seen);
+    } 
+    else if (auto ret = dynamic_pointer_cast<ReturnNode>(node)) 
+    {
+        collectNodes(ret->expr, seen);
+    } 
+    else if (auto ifNode = dynamic_pointer_cast<IfNode>(node)) 
+    {
+        collectNodes(ifNode->cond, seen);
+        collectNodes(ifNode->thenBlock, seen);
+        collectNodes(ifNode->elseBlock, seen);
+    } 
+    else if (auto whileNode = dynamic_pointer_cast<WhileNode>(node)) 
+    {
+        collectNodes(whileNode->cond, seen);
+        collectNodes(whileNode->body, seen);
+    } 
+    else if (auto exprStmt = dynamic_pointer_cast<ExprStmtNode>(node)) 
+    {
+        collectNodes(exprStmt->expr, seen);
+    } 
+    else if (auto binOp = dynamic_pointer_cast<BinaryOpNode>(node)) 
+    {
+        collectNodes(binOp->left, seen);
+        collectNodes(binOp->right, seen);
+    } 
+    else if (auto unOp = dynamic_pointer_cast<UnaryOpNode>(node)) 
+    {
+        collectNodes(unOp->operand, seen);
+    } 
+    else if (auto call = dynamic_pointer_cast<CallNode>(node)) 
+    {
+        collectNodes(call->callee, seen);
+        for (auto &a : call->args) collectNodes(a, seen);
+    } 
+    else if (auto assign = dynamic_pointer_cast<AssignmentNode>(node)) 
+    {
+        collectNodes(assign->left, seen);
+        collectNodes(assign->right, seen);
+    }
+}
+
+size_t countASTNodes(const AST& root) 
+{
+    unordered_set<const ASTNode*> seen;
+    collectNodes(root, seen);
+    return seen.size();
 }
\ No newline at end of file
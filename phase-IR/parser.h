@@ -6,57 +6,82 @@
 #include <memory>
 #include <string>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 #include "lexer.h"
 #include "parser_error.h"
+#include "output_buffer.h"
+#include "types.h"
 
 using namespace std;
 
 
 struct ASTNode;
+struct SymbolInfo;
 using AST = shared_ptr<ASTNode>;
 
 
 struct ASTNode 
 {
+    // set by hash-consing: interned nodes are pure, shared ones have several parents
+    bool interned = false;
+    bool shared = false;
+    // result type of an expression, filled in by type checking
+    TypeId type = TypeId::Void;
+    // source offset of the node's name or first token; -1 where not tracked.
+    // A shared node keeps the offset of its first occurrence.
+    int pos = -1;
+    
     virtual ~ASTNode() = default;
-    virtual void print(ostream &os, int indent = 0) const = 0;
+    void print(ostream &os, int indent = 0) const;
+    void printJson(ostream &os) const;
+    virtual void dump(OutputBuffer &out, int indent = 0) const = 0;
+    virtual void dumpJson(OutputBuffer &out) const = 0;
 };
 
-string indentStr(int n);
-
 struct ProgramNode : ASTNode 
 {
     vector<AST> items;
-    void print(ostream &os, int indent = 0) const override;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct BlockNode : ASTNode 
 {
     vector<AST> stmts;
-    void print(ostream &os, int indent = 0) const override;
+    int endPos = -1;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct FunctionNode : ASTNode 
 {
-    string retType;
+    TypeId retType;
     string name;
-    vector<pair<string,string>> params;
+    vector<pair<TypeId,string>> params;
+    vector<int> paramPositions;
     shared_ptr<BlockNode> body;
-    void print(ostream &os, int indent = 0) const override;
+    vector<SymbolInfo*> paramSymbols;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct VarDeclNode : ASTNode 
 {
-    string typeName;
+    TypeId typeName;
     string name;
     AST init;
-    void print(ostream &os, int indent = 0) const override;
+    int endPos = -1;        // offset of the closing ';'
+    SymbolInfo* symbol = nullptr;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct ReturnNode : ASTNode 
 {
     AST expr;
-    void print(ostream &os, int indent = 0) const override;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct IfNode : ASTNode 
@@ -64,27 +89,31 @@ struct IfNode : ASTNode
     AST cond;
     shared_ptr<BlockNode> thenBlock;
     shared_ptr<BlockNode> elseBlock;
-    void print(ostream &os, int indent = 0) const override;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct WhileNode : ASTNode 
 {
     AST cond;
     shared_ptr<BlockNode> body;
-    void print(ostream &os, int indent = 0) const override;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct ExprStmtNode : ASTNode 
 {
     AST expr;
-    void print(ostream &os, int indent = 0) const override;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct BinaryOpNode : ASTNode 
 {
     string op;
     AST left, right;
-    void print(ostream &os, int indent = 0) const override;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct UnaryOpNode : ASTNode 
@@ -92,27 +121,33 @@ struct UnaryOpNode : ASTNode
     string op;
     AST operand;
     bool postfix = false;
-    void print(ostream &os, int indent = 0) const override;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct LiteralNode : ASTNode 
 {
-    string kind;
+    TypeId kind;
     string value;
-    void print(ostream &os, int indent = 0) const override;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct IdentifierNode : ASTNode 
 {
     string name;
-    void print(ostream &os, int indent = 0) const override;
+    SymbolInfo* symbol = nullptr;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct CallNode : ASTNode 
 {
     AST callee;
     vector<AST> args;
-    void print(ostream &os, int indent = 0) const override;
+    SymbolInfo* symbol = nullptr;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
 };
 
 struct AssignmentNode : ASTNode 
@@ -120,22 +155,63 @@ struct AssignmentNode : ASTNode
     AST left;
     string op;
     AST right;
-    void print(ostream &os, int indent = 0) const override;
+    void dump(OutputBuffer &out, int indent = 0) const override;
+    void dumpJson(OutputBuffer &out) const override;
+};
+
+
+struct ConsKey 
+{
+    string text;
+    const ASTNode* left;
+    const ASTNode* right;
+
+    bool operator==(const ConsKey& o) const 
+    {
+        return left == o.left && right == o.right && text == o.text;
+    }
 };
 
+struct ConsKeyHash 
+{
+    size_t operator()(const ConsKey& k) const 
+    {
+        size_t h = hash<string>()(k.text);
+        h ^= hash<const void*>()(k.left) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        h ^= hash<const void*>()(k.right) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+    }
+};
 
 class Parser 
 {
     lexer lx;
     token cur;
+    int lastEnd = 0;
     vector<token> tokens;
 
+    // Hash-consing of side-effect-free expressions. Entries added inside a
+    // block are rolled back from the undo log when the block closes.
+    bool hashCons;
+    unordered_map<ConsKey, AST, ConsKeyHash> consTable;
+    vector<pair<ConsKey, AST>> consUndo;
+    vector<size_t> consMarks;
+
+    AST intern(shared_ptr<IdentifierNode> node);
+    AST intern(shared_ptr<LiteralNode> node);
+    AST intern(shared_ptr<BinaryOpNode> node);
+    AST intern(shared_ptr<UnaryOpNode> node);
+    AST internKey(ConsKey key, AST node);
+    void forgetName(const string& name);
+    void enterConsScope();
+    void exitConsScope();
+
 public:
-    Parser(const string &src);
+    Parser(const string &src, bool hashConsExprs = false);
     void advance();
     void expect(tokenType t, ParseError::Kind errKind);
     shared_ptr<ProgramNode> parseProgram();
-    string parseTypeName();
+    TypeId parseTypeName();
     AST parseFunction();
     shared_ptr<BlockNode> parseBlock();
     AST parseStatementOrDecl();
@@ -152,7 +228,9 @@ public:
     AST parseUnary();
     AST parsePostfix();
     AST parsePrimary();
-    void printTokens(ostream &os) const;
+    void printTokens(ostream &os, DumpFormat format = DumpFormat::Text) const;
 };
 
+size_t countASTNodes(const AST& root);
+
 #endif 
\ No newline at end of file
@@ -0,0 +1,527 @@
+#include "passes.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// regions with more blocks than this are left alone
+static const size_t MaxRegion = 1024;
+// rounds over the function, each placing expressions built on those placed before
+static const size_t MaxRounds = 4;
+
+// An operand the way an expression reads it: temps and names by index,
+// constants by value, so pooled copies of one literal compare equal.
+struct OperandKey 
+{
+    OperandKind kind;
+    uint64_t bits;
+    
+    bool operator==(const OperandKey& o) const { return kind == o.kind && bits == o.bits; }
+    bool operator<(const OperandKey& o) const { return kind != o.kind ? kind < o.kind : bits < o.bits; }
+};
+
+struct ComputationKey 
+{
+    IROpcode op;
+    OperandKey left, right;
+    
+    bool operator==(const ComputationKey& o) const { return op == o.op && left == o.left && right == o.right; }
+    bool operator<(const ComputationKey& o) const 
+    {
+        if (op != o.op) return op < o.op;
+        return left == o.left ? right < o.right : left < o.left;
+    }
+};
+
+// one expression: an instruction computing it and the results of all of them
+struct Candidate 
+{
+    IRInstruction instr;
+    vector<pair<uint32_t, Operand>> sites;      // block and result, in reverse postorder
+};
+
+// an edge into a block of the region; source -1 when it comes from outside
+struct RegionEdge 
+{
+    int32_t source;
+    uint32_t pred;              // the predecessor block, or UINT32_MAX for the function's entry
+};
+
+// a computation to add once the analysis is done, before the terminator or after the phis
+struct Insertion 
+{
+    uint32_t block;
+    bool atTop;
+    IRInstruction instr;
+};
+
+class PartialRedundancy 
+{
+private:
+    SSAFunction& function;
+    IRBuffer& code;
+    vector<Operand> replacement;        // per value: what its uses read instead
+    vector<int32_t> defBlock;           // per original value
+    vector<int32_t> order;              // per block: position in reverse postorder
+    vector<int32_t> local;              // per block: index in the region, -1 outside it
+    vector<Insertion> insertions;
+    uint32_t names = 0;
+    PartialRedundancyResult result;
+    
+    // the region of the expression being placed and its dataflow, per region block
+    const Candidate* candidate = nullptr;
+    vector<uint32_t> region;
+    vector<uint32_t> edgeOffsets;
+    vector<RegionEdge> edges;
+    vector<uint8_t> transp, antloc, comp, avout, antin, antout, laterin, stop, av2out;
+    vector<uint8_t> earliest, later, insert;    // per edge
+    vector<Operand> firstResult, in, out, onEdge;
+    Operand atTop, name;
+    bool topOfRegion = false;           // insertions from outside go after the phis of its first block
+    
+    OperandKey keyOf(Operand operand) const 
+    {
+        switch (operand.kind()) 
+        {
+            case OperandKind::LongInt: return {OperandKind::Int, (uint64_t)code.intValue(operand)};
+            case OperandKind::Int: return {OperandKind::Int, (uint64_t)(int64_t)operand.inlineInt()};
+            case OperandKind::Float: 
+            {
+                double value = code.floatValue(operand);
+                uint64_t bits;
+                memcpy(&bits, &value, sizeof bits);
+                return {OperandKind::Float, bits};
+            }
+            default: return {operand.kind(), operand.index()};
+        }
+    }
+    
+    // Arithmetic, negation and conversions. Comparisons stay next to the
+    // branches that fuse with them; an operation that may trap could fail
+    // sooner on the path it moved onto.
+    bool isCandidate(const IRInstruction& instr) const 
+    {
+        if (instr.op > IROpcode::F2I || !SSAFunction::isValue(instr.result)) return false;
+        if (instr.arg1.kind() == OperandKind::Global || instr.arg2.kind() == OperandKind::Global) return false;
+        return !mayTrap(instr, code);
+    }
+    
+    // the expressions computed at least twice, found by sorting the keys of all
+    vector<Candidate> collect() 
+    {
+        vector<pair<ComputationKey, uint32_t>> keys;        // with the site's position
+        vector<pair<uint32_t, const IRInstruction*>> sites;
+        defBlock.assign(function.valueCount(), -1);
+        for (uint32_t b : function.reversePostorder()) 
+        {
+            const SSABlock& block = function.blocks[b];
+            for (const auto& phi : block.phis) defBlock[phi.result.index()] = (int32_t)b;
+            for (const auto& instr : block.code) 
+            {
+                if (!definesResult(instr) || !SSAFunction::isValue(instr.result)) continue;
+                defBlock[instr.result.index()] = (int32_t)b;
+                if (!isCandidate(instr)) continue;
+                ComputationKey key = {instr.op, keyOf(instr.arg1), keyOf(instr.arg2)};
+                if (isCommutative(instr.op) && key.right < key.left) swap(key.left, key.right);
+                keys.push_back({key, (uint32_t)sites.size()});
+                sites.push_back({b, &instr});
+            }
+        }
+        sort(keys.begin(), keys.end(), [](const pair<ComputationKey, uint32_t>& x, const pair<ComputationKey, uint32_t>& y) 
+        {
+            return x.first == y.first ? x.second < y.second : x.first < y.first;
+        });
+        
+        vector<Candidate> candidates;
+        for (size_t k = 0, next; k < keys.size(); k = next) 
+        {
+            next = k + 1;
+            while (next < keys.size() && keys[next].first == keys[k].first) next++;
+            if (next - k < 2) continue;
+            candidates.push_back({*sites[keys[k].second].second, {}});
+            for (size_t j = k; j < next; j++) 
+            {
+                const auto& site = sites[keys[j].second];
+                candidates.back().sites.push_back({site.first, site.second->result});
+            }
+        }
+        return candidates;
+    }
+    
+    bool isCritical(uint32_t from, uint32_t to) const 
+    {
+        return function.blocks[from].succs.size() > 1 && function.blocks[to].preds.size() > 1;
+    }
+    
+    // The blocks dominated by the closest common dominator of the
+    // computations that reach one of them, in reverse postorder. Edges into
+    // the region come from outside only into that first block.
+    bool findRegion() 
+    {
+        uint32_t top = candidate->sites[0].first;
+        for (const auto& site : candidate->sites) 
+        {
+            while (!function.dominates(top, site.first)) top = (uint32_t)function.immediateDominator(top);
+        }
+        vector<uint32_t> stack;
+        auto add = [&](uint32_t b) 
+        {
+            if (local[b] >= 0) return;
+            local[b] = 0;
+            region.push_back(b);
+            stack.push_back(b);
+        };
+        add(top);
+        for (const auto& site : candidate->sites) add(site.first);
+        while (!stack.empty()) 
+        {
+            uint32_t b = stack.back();
+            stack.pop_back();
+            for (uint32_t p : function.blocks[b].preds) 
+            {
+                if (!function.reachable(p)) return false;
+                if (b != top || function.dominates(top, p)) add(p);
+            }
+            if (region.size() > MaxRegion) return false;
+        }
+        sort(region.begin(), region.end(), [&](uint32_t a, uint32_t b) { return order[a] < order[b]; });
+        for (size_t i = 0; i < region.size(); i++) local[region[i]] = (int32_t)i;
+        
+        // a branch with both edges into one block has no edge to tell apart
+        for (uint32_t b : region) 
+        {
+            const vector<uint32_t>& succs = function.blocks[b].succs;
+            if (succs.size() == 2 && succs[0] == succs[1]) return false;
+            for (uint32_t p : function.blocks[b].preds) 
+            {
+                const vector<uint32_t>& next = function.blocks[p].succs;
+                if (next.size() == 2 && next[0] == next[1]) return false;
+            }
+        }
+        return true;
+    }
+    
+    void clearRegion() 
+    {
+        for (uint32_t b : region) local[b] = -1;
+        region.clear();
+    }
+    
+    // Lazy code motion after Knoop, Ruthing and Steffen, in the edge-based
+    // form: earliest where the expression becomes anticipated and was not
+    // available, then delayed while every path into a block is delaying it.
+    bool analyse() 
+    {
+        size_t n = region.size();
+        edgeOffsets.assign(n + 1, 0);
+        edges.clear();
+        topOfRegion = true;
+        for (size_t i = 0; i < n; i++) 
+        {
+            const SSABlock& block = function.blocks[region[i]];
+            if (region[i] == 0) edges.push_back({-1, UINT32_MAX});
+            for (uint32_t p : block.preds) 
+            {
+                edges.push_back({local[p], p});
+                if (i == 0 && local[p] >= 0) topOfRegion = false;
+            }
+            edgeOffsets[i + 1] = (uint32_t)edges.size();
+        }
+        
+        transp.assign(n, 1);
+        antloc.assign(n, 0);
+        comp.assign(n, 0);
+        for (Operand arg : {candidate->instr.arg1, candidate->instr.arg2}) 
+        {
+            if (!SSAFunction::isValue(arg) || defBlock[arg.index()] < 0) continue;
+            int32_t d = local[defBlock[arg.index()]];
+            if (d >= 0) transp[d] = 0;
+        }
+        for (const auto& site : candidate->sites) 
+        {
+            uint32_t i = (uint32_t)local[site.first];
+            comp[i] = 1;
+            antloc[i] = transp[i];
+        }
+        
+        avout.assign(n, 1);
+        bool changed = true;
+        while (changed) 
+        {
+            changed = false;
+            for (size_t i = 0; i < n; i++) 
+            {
+                bool available = true;
+                for (uint32_t e = edgeOffsets[i]; e < edgeOffsets[i + 1]; e++) 
+                {
+                    available = available && edges[e].source >= 0 && avout[edges[e].source];
+                }
+                uint8_t value = comp[i] || (available && transp[i]);
+                if (value != avout[i]) changed = true;
+                avout[i] = value;
+            }
+        }
+        antin.assign(n, 1);
+        antout.assign(n, 0);
+        changed = true;
+        while (changed) 
+        {
+            changed = false;
+            for (size_t i = n; i-- > 0;) 
+            {
+                const vector<uint32_t>& succs = function.blocks[region[i]].succs;
+                bool anticipated = !succs.empty();
+                for (uint32_t s : succs) anticipated = anticipated && local[s] >= 0 && antin[local[s]];
+                antout[i] = anticipated;
+                uint8_t value = antloc[i] || (transp[i] && anticipated);
+                if (value != antin[i]) changed = true;
+                antin[i] = value;
+            }
+        }
+        earliest.assign(edges.size(), 0);
+        for (size_t i = 0; i < n; i++) 
+        {
+            for (uint32_t e = edgeOffsets[i]; e < edgeOffsets[i + 1]; e++) 
+            {
+                int32_t p = edges[e].source;
+                earliest[e] = antin[i] && (p < 0 || (!avout[p] && (!transp[p] || !antout[p])));
+            }
+        }
+        
+        // A computation due on an edge from a branch into a join would need
+        // a block of its own, and its jump costs what it saves. When every
+        // successor anticipates the expression, the branch block computes
+        // it before the branch instead and its edges need nothing.
+        stop.assign(n, 0);
+        while (true) 
+        {
+            computeLater();
+            int32_t critical = -1;
+            for (size_t i = 0; i < n && critical < 0; i++) 
+            {
+                for (uint32_t e = edgeOffsets[i]; e < edgeOffsets[i + 1]; e++) 
+                {
+                    if (!insert[e]) continue;
+                    int32_t p = edges[e].source;
+                    if (p < 0) 
+                    {
+                        if (topOfRegion) continue;
+                        if (edges[e].pred == UINT32_MAX || isCritical(edges[e].pred, region[i])) return false;
+                        continue;
+                    }
+                    if (!isCritical(region[p], region[i])) continue;
+                    if (!antout[p] || comp[p] || stop[p]) return false;
+                    critical = p;
+                    break;
+                }
+            }
+            if (critical < 0) break;
+            stop[critical] = 1;
+        }
+        
+        // the expression after the motion, which each removed computation must find
+        av2out.assign(n, 1);
+        vector<uint8_t> av2in(n, 0);
+        changed = true;
+        while (changed) 
+        {
+            changed = false;
+            for (size_t i = 0; i < n; i++) 
+            {
+                bool available = true;
+                for (uint32_t e = edgeOffsets[i]; e < edgeOffsets[i + 1]; e++) 
+                {
+                    int32_t p = edges[e].source;
+                    available = available && (insert[e] || (p >= 0 && av2out[p]));
+                }
+                av2in[i] = available;
+                uint8_t value = comp[i] || insertsAtEnd(i) || (available && transp[i]);
+                if (value != av2out[i]) changed = true;
+                av2out[i] = value;
+            }
+        }
+        bool removes = false;
+        for (size_t i = 0; i < n; i++) 
+        {
+            if (!removesFirst(i)) continue;
+            if (!av2in[i]) return false;
+            removes = true;
+        }
+        // a second computation in one block always goes
+        const auto& sites = candidate->sites;
+        for (size_t k = 1; k < sites.size(); k++) removes = removes || sites[k].first == sites[k - 1].first;
+        return removes;
+    }
+    
+    void computeLater() 
+    {
+        size_t n = region.size();
+        laterin.assign(n, 1);
+        later.assign(edges.size(), 0);
+        bool changed = true;
+        while (changed) 
+        {
+            changed = false;
+            for (size_t i = 0; i < n; i++) 
+            {
+                bool all = true;
+                for (uint32_t e = edgeOffsets[i]; e < edgeOffsets[i + 1]; e++) 
+                {
+                    int32_t p = edges[e].source;
+                    if (p >= 0 && stop[p]) later[e] = 0;
+                    else later[e] = earliest[e] || (p >= 0 && laterin[p] && !antloc[p]);
+                    all = all && later[e];
+                }
+                if (all != (bool)laterin[i]) changed = true;
+                laterin[i] = all;
+            }
+        }
+        insert.assign(edges.size(), 0);
+        for (size_t i = 0; i < n; i++) 
+        {
+            for (uint32_t e = edgeOffsets[i]; e < edgeOffsets[i + 1]; e++) insert[e] = later[e] && !laterin[i];
+        }
+    }
+    
+    bool insertsAtEnd(size_t i) const { return stop[i]; }
+    bool removesFirst(size_t i) const { return antloc[i] && !laterin[i]; }
+    
+    Operand inserted(uint32_t block, bool top) 
+    {
+        Operand value = function.newValue(name);
+        const IRInstruction& instr = candidate->instr;
+        insertions.push_back({block, top, IRInstruction(instr.op, value, instr.arg1, instr.arg2)});
+        result.inserted++;
+        return value;
+    }
+    
+    // the expression where block i of the region begins and where it ends
+    Operand readIn(uint32_t i) 
+    {
+        if (!in[i].empty()) return in[i];
+        uint32_t first = edgeOffsets[i], last = edgeOffsets[i + 1];
+        if (i == 0 && topOfRegion) 
+        {
+            if (atTop.empty()) atTop = inserted(region[0], true);
+            return in[i] = atTop;
+        }
+        if (last - first == 1) return in[i] = readEdge(i, first);
+        
+        // a phi, made before its arguments are read so that loops find it
+        Operand phi = function.newValue(name);
+        in[i] = phi;
+        vector<Operand> args;
+        for (uint32_t e = first; e < last; e++) args.push_back(readEdge(i, e));
+        Operand same;
+        bool unique = true;
+        for (Operand arg : args) 
+        {
+            arg = replaced(replacement, arg);
+            if (arg == phi) continue;
+            if (same.empty()) same = arg;
+            else if (arg != same) unique = false;
+        }
+        if (unique) 
+        {
+            replacement.resize(function.valueCount());
+            replacement[phi.index()] = same;
+            return in[i] = same;
+        }
+        function.blocks[region[i]].phis.push_back({phi, args});
+        result.phis++;
+        return phi;
+    }
+    
+    Operand readEdge(uint32_t i, uint32_t e) 
+    {
+        if (!onEdge[e].empty()) return onEdge[e];
+        if (!insert[e]) return readOut((uint32_t)edges[e].source);
+        uint32_t from = edges[e].pred;
+        if (function.blocks[from].succs.size() == 1) return onEdge[e] = inserted(from, false);
+        return onEdge[e] = inserted(region[i], true);
+    }
+    
+    Operand readOut(uint32_t i) 
+    {
+        if (!out[i].empty()) return out[i];
+        if (insertsAtEnd(i)) return out[i] = inserted(region[i], false);
+        if (comp[i] && !removesFirst(i)) return out[i] = firstResult[i];
+        return out[i] = readIn(i);
+    }
+    
+    void place(const Candidate& c) 
+    {
+        size_t n = region.size();
+        name = code.variable("pre." + to_string(++names));
+        firstResult.assign(n, Operand());
+        in.assign(n, Operand());
+        out.assign(n, Operand());
+        onEdge.assign(edges.size(), Operand());
+        atTop = Operand();
+        
+        // kept computations take the name too, so the phis reading them coalesce
+        for (const auto& site : c.sites) 
+        {
+            uint32_t i = (uint32_t)local[site.first];
+            if (!firstResult[i].empty()) continue;
+            firstResult[i] = site.second;
+            if (!removesFirst(i) && function.origin[site.second.index()].empty())
+                function.origin[site.second.index()] = name;
+        }
+        for (const auto& site : c.sites) 
+        {
+            uint32_t i = (uint32_t)local[site.first];
+            if (site.second == firstResult[i] && !removesFirst(i)) continue;
+            Operand value = site.second == firstResult[i] ? readIn(i) : readOut(i);
+            replacement[site.second.index()] = value;
+            result.removed++;
+        }
+        result.expressions++;
+    }
+    
+    void rewrite() 
+    {
+        for (const Insertion& insertion : insertions) 
+        {
+            vector<IRInstruction>& instrs = function.blocks[insertion.block].code;
+            instrs.insert(insertion.atTop ? instrs.begin() : instrs.end() - 1, insertion.instr);
+        }
+        function.replaceValues(replacement);
+    }
+
+public:
+    PartialRedundancy(SSAFunction& fn, IRBuffer& buffer) : function(fn), code(buffer) {}
+    
+    PartialRedundancyResult run() 
+    {
+        function.computeDominators();
+        const vector<uint32_t>& rpo = function.reversePostorder();
+        order.assign(function.blocks.size(), -1);
+        for (uint32_t i = 0; i < rpo.size(); i++) order[rpo[i]] = (int32_t)i;
+        local.assign(function.blocks.size(), -1);
+        
+        // Blocks are never added, so dominators hold from round to round.
+        // Once a - b is one value, (a - b) * 4 can be one expression.
+        for (size_t round = 0; round < MaxRounds; round++) 
+        {
+            size_t moved = result.expressions;
+            replacement.assign(function.valueCount(), Operand());
+            insertions.clear();
+            vector<Candidate> candidates = collect();
+            for (const Candidate& c : candidates) 
+            {
+                candidate = &c;
+                if (findRegion() && analyse()) place(c);
+                clearRegion();
+            }
+            if (result.expressions == moved) break;
+            rewrite();
+        }
+        return result;
+    }
+};
+
+PartialRedundancyResult eliminatePartialRedundancy(SSAFunction& function, IRBuffer& code) 
+{
+    return PartialRedundancy(function, code).run();
+}
@@ -0,0 +1,180 @@
+#ifndef PASSES_H
+#define PASSES_H
+
+#include <cstddef>
+#include <unordered_map>
+#include "ir.h"
+#include "ssa.h"
+
+using namespace std;
+
+// Optimization passes over one function in SSA form. Each returns counts
+// of what it changed, which the optimizer sums up for --stats.
+
+struct ConstantPropagationResult 
+{
+    size_t folded = 0;          // instructions and phis replaced by a constant
+    size_t branches = 0;        // conditional branches resolved to one side
+    size_t unreachable = 0;     // instructions removed with the blocks never reached
+};
+
+// Sparse conditional constant propagation (Wegman and Zadeck). Int, float
+// and bool arithmetic, comparisons and logic are evaluated over the SSA
+// graph following only the edges that can execute, so a phi does not lose
+// its constant to an argument from a branch that is never taken. Constant
+// values are substituted into their uses and their definitions deleted,
+// branches on constants become GOTOs and blocks left unreachable are emptied.
+ConstantPropagationResult propagateConstants(SSAFunction& function, IRBuffer& code);
+
+struct CopyPropagationResult 
+{
+    size_t copies = 0;          // copies removed, their uses reading the source
+    size_t coalesced = 0;       // computations renamed after the variable they were copied into
+};
+
+// Copy propagation. A copy of a value, an entry value or a constant is
+// deleted and its uses read the source; copies out of globals stay, the
+// global may change in between. When the source is an unnamed temp, it
+// takes over the name of the variable it was copied into, so toTAC()
+// emits `x = x ADD_I 1` rather than a temp and a copy unless the two
+// live ranges overlap.
+CopyPropagationResult propagateCopies(SSAFunction& function);
+
+struct DeadCodeResult 
+{
+    size_t values = 0;          // instructions and phis whose result is never read
+    size_t stores = 0;          // global stores overwritten before anything can read them
+    size_t callResults = 0;     // call results dropped, the call itself stays
+    size_t unreachable = 0;     // instructions in blocks no path reaches
+    
+    size_t removed() const { return values + stores + unreachable; }
+};
+
+// Dead code elimination. A value is live when an instruction with an
+// effect reads it (a store to a global, PARAM, CALL, RETURN, a branch, or
+// an operation that may trap) or a live instruction or phi does; everything
+// else is swept, cycles of phis feeding only each other included. Within
+// a block, a store to a global that is stored again before any read, call
+// or return is dead as well.
+DeadCodeResult eliminateDeadCode(SSAFunction& function, const IRBuffer& code);
+
+struct ValueNumberingResult 
+{
+    size_t redundant = 0;       // instructions recomputing an available value
+    size_t phis = 0;            // phis merging one value, or repeating another phi
+};
+
+// Hash-based value numbering. Operations on the same value numbers
+// compute the same value, so a pure instruction whose (opcode, operands)
+// key is already available is deleted and its uses read the earlier
+// result; commutative operands are ordered and > / >= flipped into < / <=
+// so more spellings meet. With global set, availability follows the
+// dominator tree (Briggs, Cooper and Simpson); otherwise it is reset at
+// every block, which is plain local value numbering.
+ValueNumberingResult numberValues(SSAFunction& function, const IRBuffer& code, bool global);
+
+struct BranchFusionResult 
+{
+    size_t fused = 0;           // comparisons folded into the branch that read them
+};
+
+// Compare-and-branch fusion. An int or float comparison whose only use is
+// the IF_FALSE or IF_TRUE ending its own block becomes the fused branch
+// (IF_LT_I a, b and so on) and the bool is never materialized. A float
+// ordering has no negation that agrees on NaN, so under IF_FALSE it keeps
+// its sense and the successors trade places. A comparison of a global that
+// may be stored or called over before the branch stays. Lowering already
+// fuses the branches written in the source; this catches the ones
+// propagation exposes, as in `bool c = a < b; if (c)`.
+BranchFusionResult fuseBranches(SSAFunction& function);
+
+// What a call can do to program state. A Pure function computes its result
+// from its arguments alone; one that ReadsGlobals depends on globals too
+// but stores none. A function does what its callees do, recursion included.
+enum class CallEffect : uint8_t { Pure, ReadsGlobals, WritesGlobals };
+
+// the effect of every function defined in code, keyed by name index
+unordered_map<uint32_t, CallEffect> findCallEffects(const IRBuffer& code);
+
+// Whether an operation can fail at run time: a DIV_I by anything but a
+// nonzero constant, or an F2I of anything but a float constant in int range.
+// Such an operation must not move onto a path that skipped it, and is not
+// dead while it may fail.
+bool mayTrap(const IRInstruction& instr, const IRBuffer& code);
+
+struct InvariantMotionResult 
+{
+    size_t loops = 0;           // natural loops found
+    size_t hoisted = 0;         // instructions moved out into a preheader
+    size_t calls = 0;           // calls among them
+};
+
+// Loop-invariant code motion. Every natural loop gets a preheader, and an
+// instruction of the loop whose operands are constants, entry values or
+// values defined outside it moves there. Loops are visited innermost
+// first, so an outer loop can take the same instruction further. Globals
+// count as invariant in a loop that neither stores one nor calls a
+// function that may. A call is hoisted only when proven pure there: Pure,
+// or reading globals the loop leaves alone. Operations that cannot fail
+// are hoisted from anywhere in the loop; one that may trap, or a call
+// with its PARAMs, only from a block that runs on every trip, dominating
+// each latch and exit of the loop.
+InvariantMotionResult hoistInvariants(SSAFunction& function, const IRBuffer& code, 
+                                      const unordered_map<uint32_t, CallEffect>& effects);
+
+struct InductionVariableResult 
+{
+    size_t found = 0;           // basic induction variables
+    size_t reduced = 0;         // multiplications turned into running sums
+    size_t eliminated = 0;      // variables made redundant, merged or left to their own step
+};
+
+// Induction variable strength reduction. A header phi that comes back
+// around the loop as itself plus an invariant step is a basic induction
+// variable; one stepping in lockstep with another is merged into it. A
+// product of one with an invariant factor becomes a new variable starting
+// at init * factor and stepping by step * factor, so the MUL_I leaves the
+// loop. When the variable was only counting, its exit test against a
+// constant moves onto a multiple of it that provably does not overflow,
+// and dead code elimination removes the variable.
+InductionVariableResult reduceInductionVariables(SSAFunction& function, IRBuffer& code);
+
+struct PartialRedundancyResult 
+{
+    size_t expressions = 0;     // expressions whose computations moved
+    size_t removed = 0;         // computations made redundant and deleted
+    size_t inserted = 0;        // computations added where a path lacked the value
+    size_t phis = 0;            // phis merging the copies
+};
+
+// Partial redundancy elimination by lazy code motion (Knoop, Ruthing and
+// Steffen). An expression computed in several blocks, none dominating the
+// rest, is placed anew within the blocks their closest common dominator
+// dominates: a computation goes wherever a path would otherwise reach a
+// later one without the value, as late as that allows, and the later ones
+// become redundant and read a phi of the copies instead. No path computes
+// the expression more often than before. Insertions never need a block of
+// their own: one due on an edge from a branch into a join moves up before
+// the branch, and when it cannot the expression stays. Up to four rounds
+// run, so expressions of the values merged move in the next. Operations
+// that may trap, comparisons and anything reading a global stay.
+PartialRedundancyResult eliminatePartialRedundancy(SSAFunction& function, IRBuffer& code);
+
+struct UnrollResult 
+{
+    size_t full = 0;            // loops replaced by copies of their body, one per trip
+    size_t partial = 0;         // loops given a main loop running several trips per test
+    size_t copies = 0;          // copies of loop bodies made
+};
+
+// Loop unrolling. An innermost loop whose latch is its only exit, testing
+// a counter stepped by a constant against an invariant bound, pays for
+// that test and the jump back on every trip. When the trip count is a
+// constant and the copies fit in budget instructions, the loop is unrolled
+// fully, one copy per trip; otherwise as many copies as fit, at most 8, go
+// into a main loop that runs while a trip past them is left, and the loop
+// itself runs the remaining trips. Values and counters of the copies are
+// left for the other passes to fold.
+UnrollResult unrollLoops(SSAFunction& function, IRBuffer& code, size_t budget);
+
+#endif
@@ -28,28 +28,50 @@ ScopeException::ScopeException(ScopeError type, const string& symbol)
     msg = oss.str();
 }
 
-ScopeStack::ScopeStack() : nextScopeId(0) 
+ScopeStack::ScopeStack(const ScopeStack* globalTable) 
+    : nextScopeId(0), globals(globalTable), currentItem(0), lookupLog(nullptr) 
 {
-    globalScope = make_shared<ScopeNode>(nextScopeId++);
-    currentScope = globalScope;
+    scopeIds.push_back(nextScopeId++);
+    scopeMarks.push_back(0);
 }
 
 void ScopeStack::enterScope() 
 {
-    currentScope = make_shared<ScopeNode>(nextScopeId++, currentScope);
+    scopeIds.push_back(nextScopeId++);
+    scopeMarks.push_back(undoLog.size());
+}
+
+// Scope ids restart for every function so shadowed names get the same
+// unique names whichever order the bodies are analysed in.
+void ScopeStack::enterFunctionScope() 
+{
+    nextScopeId = 1;
+    enterScope();
 }
 
 void ScopeStack::exitScope() 
 {
-    if (currentScope->parent) 
+    if (scopeIds.size() <= 1) return;
+    
+    size_t mark = scopeMarks.back();
+    while (undoLog.size() > mark) 
     {
-        currentScope = currentScope->parent;
+        undoLog.back()->pop_back();
+        undoLog.pop_back();
     }
+    scopeMarks.pop_back();
+    scopeIds.pop_back();
 }
 
-void ScopeStack::addSymbol(const string& name, const string& type, bool isFunction) 
+void ScopeStack::exitToGlobalScope() 
 {
-    if (currentScope->symbols.find(name) != currentScope->symbols.end()) 
+    while (scopeIds.size() > 1) exitScope();
+}
+
+SymbolInfo* ScopeStack::addSymbol(const string& name, TypeId type, bool isFunction) 
+{
+    BindingStack& stack = bindings[name];
+    if (!stack.empty() && stack.back()->scopeLevel == currentScopeId()) 
     {
         if (isFunction) 
         {
@@ -61,51 +83,97 @@ void ScopeStack::addSymbol(const string& name, const string& type, bool isFuncti
         }
     }
     
-    auto info = make_shared<SymbolInfo>(name, type, isFunction, currentScope->id);
-    currentScope->symbols[name] = info;
+    SymbolInfo* info = arena.create(name, type, isFunction, currentScopeId());
+    info->declItem = currentItem;
+    bool shadows = false;
+    if (globals) 
+    {
+        SymbolInfo* outer = globals->lookupGlobal(name, false, currentItem);
+        if (lookupLog) lookupLog->emplace_back(name, false, outer);
+        shadows = outer != nullptr;
+    }
+    for (size_t i = 0; i < stack.size() && !shadows; i++) 
+    {
+        shadows = !stack[i]->isFunction;
+    }
+    if (shadows) info->uniqueName = name + "." + to_string(info->scopeLevel);
+    
+    stack.push_back(info);
+    if (scopeIds.size() > 1) undoLog.push_back(&stack);
+    else globalSymbols.push_back(&stack);
+    return info;
 }
 
-void ScopeStack::addFunction(const string& name, const string& retType, const vector<string>& paramTypes) 
+SymbolInfo* ScopeStack::addFunction(const string& name, TypeId retType, const vector<TypeId>& paramTypes) 
 {
-    if (globalScope->symbols.find(name) != globalScope->symbols.end())
+    int globalId = scopeIds.front();
+    BindingStack& stack = bindings[name];
+    if (!stack.empty() && stack.front()->scopeLevel == globalId)
     {
         throw ScopeException(ScopeError::FunctionPrototypeRedefinition, name);
     }
     
-    auto info = make_shared<SymbolInfo>(name, retType, true, globalScope->id);
+    SymbolInfo* info = arena.create(name, retType, true, globalId);
     info->paramTypes = paramTypes;
-    globalScope->symbols[name] = info;
+    info->declItem = currentItem;
+    // global bindings sit below any local ones and are never popped
+    stack.push_front(info);
+    globalSymbols.push_back(&stack);
+    return info;
 }
 
-shared_ptr<SymbolInfo> ScopeStack::lookup(const string& name, bool functionLookup) 
+SymbolInfo* ScopeStack::lookup(const string& name, bool functionLookup) 
 {
-    shared_ptr<ScopeNode> scope = currentScope;
-    
-    while (scope) 
+    auto it = bindings.find(name);
+    if (it != bindings.end()) 
     {
-        auto it = scope->symbols.find(name);
-        if (it != scope->symbols.end()) 
+        const BindingStack& stack = it->second;
+        for (size_t i = stack.size(); i-- > 0; ) 
         {
-            if (functionLookup && !it->second->isFunction) 
-            {
-                scope = scope->parent;
-                continue;
-            }
-            
-            if (!functionLookup && it->second->isFunction) 
-            {
-                scope = scope->parent;
-                continue;
-            }
-            return it->second;
+            if (stack[i]->isFunction == functionLookup) return stack[i];
         }
-        scope = scope->parent;
+    }
+    
+    if (!globals) return nullptr;
+    SymbolInfo* info = globals->lookupGlobal(name, functionLookup, currentItem);
+    if (lookupLog) lookupLog->emplace_back(name, functionLookup, info);
+    return info;
+}
+
+SymbolInfo* ScopeStack::lookupGlobal(const string& name, bool functionLookup, int beforeItem) const 
+{
+    auto it = bindings.find(name);
+    if (it == bindings.end()) return nullptr;
+    
+    // functions are declared up front; variables only once their item is reached
+    const BindingStack& stack = it->second;
+    for (size_t i = stack.size(); i-- > 0; ) 
+    {
+        SymbolInfo* info = stack[i];
+        if (info->isFunction != functionLookup || info->scopeLevel != scopeIds.front()) continue;
+        if (functionLookup || info->declItem < beforeItem) return info;
     }
     
     return nullptr;
 }
 
-shared_ptr<SymbolInfo> ScopeStack::requireSymbol(const string& name) 
+GlobalLookup::GlobalLookup(const string& n, bool isFunction, const SymbolInfo* info)
+    : name(n), function(isFunction), found(info != nullptr), type(info ? info->type : TypeId::Void) 
+{
+    if (info) 
+    {
+        paramTypes = info->paramTypes;
+        uniqueName = info->uniqueName;
+    }
+}
+
+bool GlobalLookup::stillValid(const SymbolInfo* now) const 
+{
+    if (!found || !now) return found == (now != nullptr);
+    return type == now->type && paramTypes == now->paramTypes && uniqueName == now->uniqueName;
+}
+
+SymbolInfo* ScopeStack::requireSymbol(const string& name) 
 {
     auto info = lookup(name, false);
     if (!info) 
@@ -115,7 +183,7 @@ shared_ptr<SymbolInfo> ScopeStack::requireSymbol(const string& name)
     return info;
 }
 
-shared_ptr<SymbolInfo> ScopeStack::requireFunction(const string& name) 
+SymbolInfo* ScopeStack::requireFunction(const string& name) 
 {
     auto info = lookup(name, true);
     if (!info) 
@@ -125,45 +193,55 @@ shared_ptr<SymbolInfo> ScopeStack::requireFunction(const string& name)
     return info;
 }
 
+static void printSymbol(ostream& os, const SymbolInfo& info) 
+{
+    os << "  " << info.name << " : " << typeName(info.type);
+    if (info.isFunction) 
+    {
+        os << " (function, params: [";
+        for (size_t i = 0; i < info.paramTypes.size(); i++) 
+        {
+            if (i > 0) os << ", ";
+            os << typeName(info.paramTypes[i]);
+        }
+        os << "])";
+    }
+    os << endl;
+}
+
 void ScopeStack::printScopes(ostream& os) const 
 {
     os << "\n=== SCOPE STACK ===" << endl;
-    shared_ptr<ScopeNode> scope = currentScope;
-    int depth = 0;
     
-    while (scope)
+    size_t end = undoLog.size();
+    int depth = 0;
+    for (size_t level = scopeIds.size(); level-- > 0; depth++) 
     {
-        os << "Scope " << scope->id << " (depth " << depth << ")";
-        if (scope == globalScope) 
+        int id = scopeIds[level];
+        os << "Scope " << id << " (depth " << depth << ")";
+        if (level == 0) 
         {
             os << " [GLOBAL]";
         }
         os << ":" << endl;
         
-        if (scope->symbols.empty()) 
+        const vector<BindingStack*>& declared = level == 0 ? globalSymbols : undoLog;
+        size_t begin = level == 0 ? 0 : scopeMarks[level];
+        if (level == 0) end = globalSymbols.size();
+        
+        if (begin == end) 
         {
             os << "  (empty)" << endl;
-        } 
-        else 
+        }
+        for (size_t i = begin; i < end; i++) 
         {
-            for (const auto& pair : scope->symbols) 
+            const BindingStack& stack = *declared[i];
+            for (size_t b = 0; b < stack.size(); b++) 
             {
-                os << "  " << pair.first << " : " << pair.second->type;
-                if (pair.second->isFunction) 
-                {
-                    os << " (function, params: [";
-                    for (size_t i = 0; i < pair.second->paramTypes.size(); i++) 
-                    {
-                        if (i > 0) os << ", ";
-                        os << pair.second->paramTypes[i];
-                    }
-                    os << "])";
-                }
-                os << endl;
+                if (stack[b]->scopeLevel == id) printSymbol(os, *stack[b]);
             }
         }
-        scope = scope->parent;
-        depth++;
+        end = begin;
     }
     os << "===================\n" << endl;
 }
@@ -171,6 +249,20 @@ void ScopeStack::printScopes(ostream& os) const
 void ScopeAnalyzer::analyze(shared_ptr<ProgramNode> program) 
 {
     analyzeProgram(program);
+    if (tree) tree->finish();
+}
+
+void ScopeAnalyzer::declare(SymbolInfo* info, int pos, int end) 
+{
+    info->declPos = pos;
+    if (!tree) return;
+    tree->declare(info, end < 0 ? pos : end);
+    tree->reference(pos, (int)info->name.size(), info);
+}
+
+void ScopeAnalyzer::reference(shared_ptr<IdentifierNode> id) 
+{
+    if (tree) tree->reference(id->pos, (int)id->name.size(), id->symbol);
 }
 
 void ScopeAnalyzer::printScopes(ostream& os) const 
@@ -214,45 +306,65 @@ void ScopeAnalyzer::analyzeNode(AST node)
     }
 }
 
-void ScopeAnalyzer::analyzeProgram(shared_ptr<ProgramNode> node) 
+void ScopeAnalyzer::declareFunctions(shared_ptr<ProgramNode> program) 
 {
-    for (const auto& item : node->items) 
+    for (const auto& item : program->items) 
     {
         if (auto func = dynamic_pointer_cast<FunctionNode>(item)) 
         {
-            vector<string> paramTypes;
+            vector<TypeId> paramTypes;
             for (const auto& param : func->params) {
                 paramTypes.push_back(param.first);  
             }
-            scopeStack.addFunction(func->name, func->retType, paramTypes);
+            SymbolInfo* info = scopeStack.addFunction(func->name, func->retType, paramTypes);
+            info->declPos = func->pos;
+            if (tree) tree->declare(info, -1);
         }
     }
+}
+
+void ScopeAnalyzer::analyzeItem(const AST& item, int index) 
+{
+    scopeStack.setCurrentItem(index);
+    analyzeNode(item);
+}
+
+void ScopeAnalyzer::analyzeProgram(shared_ptr<ProgramNode> node) 
+{
+    declareFunctions(node);
     
-    for (const auto& item : node->items) 
+    for (size_t i = 0; i < node->items.size(); i++) 
     {
-        analyzeNode(item);
+        analyzeItem(node->items[i], (int)i);
     }
 }
 
 void ScopeAnalyzer::analyzeBlock(shared_ptr<BlockNode> node) 
 {
     scopeStack.enterScope();
+    if (tree) tree->openRegion(node->pos);
     
     for (const auto& stmt : node->stmts) 
     {
         analyzeNode(stmt);
     }
     
+    if (tree) tree->closeRegion(node->endPos);
     scopeStack.exitScope();
 }
 
 void ScopeAnalyzer::analyzeFunction(shared_ptr<FunctionNode> node) 
 {
-    scopeStack.enterScope();
+    scopeStack.enterFunctionScope();
+    if (tree) tree->openRegion(node->pos);
     
-    for (const auto& param : node->params) 
+    node->paramSymbols.clear();
+    for (size_t i = 0; i < node->params.size(); i++) 
     {
-        scopeStack.addSymbol(param.second, param.first, false);  
+        const auto& param = node->params[i];
+        node->paramSymbols.push_back(scopeStack.addSymbol(param.second, param.first, false));  
+        int pos = i < node->paramPositions.size() ? node->paramPositions[i] : -1;
+        declare(node->paramSymbols.back(), pos, pos);
     }
     
     for (const auto& stmt : node->body->stmts) 
@@ -260,6 +372,7 @@ void ScopeAnalyzer::analyzeFunction(shared_ptr<FunctionNode> node)
         analyzeNode(stmt);
     }
     
+    if (tree) tree->closeRegion(node->body->endPos);
     scopeStack.exitScope();
 }
 
@@ -270,7 +383,8 @@ void ScopeAnalyzer::analyzeVarDecl(shared_ptr<VarDeclNode> node)
         analyzeNode(node->init);
     }
     
-    scopeStack.addSymbol(node->name, node->typeName, false);
+    node->symbol = scopeStack.addSymbol(node->name, node->typeName, false);
+    declare(node->symbol, node->pos, node->endPos);
 }
 
 void ScopeAnalyzer::analyzeReturn(shared_ptr<ReturnNode> node) 
@@ -305,12 +419,17 @@ void ScopeAnalyzer::analyzeExprStmt(shared_ptr<ExprStmtNode> node)
 
 void ScopeAnalyzer::analyzeBinaryOp(shared_ptr<BinaryOpNode> node) 
 {
+    // every use of a hash-consed node sees the same bindings, so one visit resolves all of them
+    if (node->shared && !analyzedExprs.insert(node.get()).second) return;
+    
     analyzeNode(node->left);
     analyzeNode(node->right);
 }
 
 void ScopeAnalyzer::analyzeUnaryOp(shared_ptr<UnaryOpNode> node) 
 {
+    if (node->shared && !analyzedExprs.insert(node.get()).second) return;
+    
     analyzeNode(node->operand);
 }
 
@@ -321,14 +440,18 @@ void ScopeAnalyzer::analyzeLiteral(shared_ptr<LiteralNode> node)
 
 void ScopeAnalyzer::analyzeIdentifier(shared_ptr<IdentifierNode> node) 
 {
-    scopeStack.requireSymbol(node->name);
+    // a hash-consed identifier binds the same symbol at every use
+    if (node->shared && node->symbol) return;
+    node->symbol = scopeStack.requireSymbol(node->name);
+    reference(node);
 }
 
 void ScopeAnalyzer::analyzeCall(shared_ptr<CallNode> node)
 {
     if (auto id = dynamic_pointer_cast<IdentifierNode>(node->callee)) 
     {
-        scopeStack.requireFunction(id->name);
+        node->symbol = scopeStack.requireFunction(id->name);
+        if (tree) tree->reference(id->pos, (int)id->name.size(), node->symbol);
     }
     else 
     {
@@ -345,7 +468,8 @@ void ScopeAnalyzer::analyzeAssignment(shared_ptr<AssignmentNode> node)
 {
     if (auto id = dynamic_pointer_cast<IdentifierNode>(node->left)) 
     {
-        scopeStack.requireSymbol(id->name);
+        id->symbol = scopeStack.requireSymbol(id->name);
+        reference(id);
     }
     else 
     {
@@ -6,7 +6,10 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <sstream>
+#include "scope_tree.h"
+#include "types.h"
 
 using namespace std;
 
@@ -40,13 +43,16 @@ enum class ScopeError
 struct SymbolInfo 
 {
     string name;
-    string type;           
+    TypeId type;           
     bool isFunction;
-    vector<string> paramTypes;  
+    vector<TypeId> paramTypes;  
     int scopeLevel;
+    string uniqueName;      // differs from name when the binding shadows a live one
+    int declItem;           // index of the top-level item that declared it
+    int declPos;            // source offset of the declaration, -1 if unknown
     
-    SymbolInfo(const string& n, const string& t, bool isFunc = false, int level = 0)
-        : name(n), type(t), isFunction(isFunc), scopeLevel(level) {}
+    SymbolInfo(const string& n, TypeId t, bool isFunc = false, int level = 0)
+        : name(n), type(t), isFunction(isFunc), scopeLevel(level), uniqueName(n), declItem(0), declPos(-1) {}
 };
 
 class ScopeException : public exception 
@@ -67,33 +73,130 @@ public:
     string getSymbolName() const { return symbolName; }
 };
 
-class ScopeStack 
+// Stack of the live bindings of one name. Almost every name has one or two,
+// so those live inline and only deeper shadowing spills to the heap.
+class BindingStack 
+{
+private:
+    static const size_t InlineSlots = 2;
+    SymbolInfo* slots[InlineSlots];
+    vector<SymbolInfo*> spill;
+    size_t count;
+    
+public:
+    BindingStack() : count(0) {}
+    
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    SymbolInfo* operator[](size_t i) const { return i < InlineSlots ? slots[i] : spill[i - InlineSlots]; }
+    SymbolInfo* front() const { return (*this)[0]; }
+    SymbolInfo* back() const { return (*this)[count - 1]; }
+    
+    void push_back(SymbolInfo* info) 
+    {
+        if (count < InlineSlots) slots[count] = info;
+        else spill.push_back(info);
+        count++;
+    }
+    
+    void pop_back() 
+    {
+        count--;
+        if (count >= InlineSlots) spill.pop_back();
+    }
+    
+    void push_front(SymbolInfo* info) 
+    {
+        push_back(info);
+        for (size_t i = count - 1; i > 0; i--) set(i, (*this)[i - 1]);
+        set(0, info);
+    }
+    
+private:
+    void set(size_t i, SymbolInfo* info) 
+    {
+        if (i < InlineSlots) slots[i] = info;
+        else spill[i - InlineSlots] = info;
+    }
+};
+
+// Owns every SymbolInfo by value in fixed-size chunks, so addresses stay
+// stable for the AST annotations and scopes never free symbols on exit.
+class SymbolArena 
 {
 private:
-    struct ScopeNode 
+    static const size_t ChunkSize = 256;
+    vector<vector<SymbolInfo>> chunks;
+    
+public:
+    SymbolInfo* create(const string& name, TypeId type, bool isFunction, int level) 
     {
-        int id;
-        shared_ptr<ScopeNode> parent;
-        unordered_map<string, shared_ptr<SymbolInfo>> symbols;
-        
-        ScopeNode(int scopeId, shared_ptr<ScopeNode> par = nullptr)
-            : id(scopeId), parent(par) {}
-    };
-    
-    shared_ptr<ScopeNode> currentScope;
-    shared_ptr<ScopeNode> globalScope;
+        if (chunks.empty() || chunks.back().size() == ChunkSize) 
+        {
+            chunks.emplace_back();
+            chunks.back().reserve(ChunkSize);
+        }
+        chunks.back().emplace_back(name, type, isFunction, level);
+        return &chunks.back().back();
+    }
+};
+
+// A name a function body resolved against the global table and a copy of
+// what it found; an incremental rebuild can reuse the body only if the same
+// lookup against the new table still finds the same thing.
+struct GlobalLookup 
+{
+    string name;
+    bool function;
+    bool found;
+    TypeId type;
+    vector<TypeId> paramTypes;
+    string uniqueName;
+    
+    GlobalLookup(const string& n, bool isFunction, const SymbolInfo* info);
+    bool stillValid(const SymbolInfo* now) const;
+};
+
+class ScopeStack 
+{
+private:
+    // Flat symbol table: every name maps to the stack of its active bindings,
+    // innermost last. Each open scope owns a segment of the undo log listing
+    // the binding stacks it pushed onto, so exitScope pops exactly those.
+    SymbolArena arena;
+    unordered_map<string, BindingStack> bindings;
+    vector<BindingStack*> undoLog;
+    vector<size_t> scopeMarks;
+    vector<int> scopeIds;
+    vector<BindingStack*> globalSymbols;
     int nextScopeId;
     
+    // A function-local stack analysing one body on its own resolves misses
+    // against a finished global table, seeing only globals declared before
+    // the current item, exactly as a sequential walk would.
+    const ScopeStack* globals;
+    int currentItem;
+    vector<GlobalLookup>* lookupLog;
+    
+    int currentScopeId() const { return scopeIds.back(); }
+    SymbolInfo* lookupGlobal(const string& name, bool functionLookup, int beforeItem) const;
+    
 public:
-    ScopeStack();
+    ScopeStack(const ScopeStack* globalTable = nullptr);
+    ScopeStack(const ScopeStack&) = delete;
+    ScopeStack& operator=(const ScopeStack&) = delete;
     
+    void setCurrentItem(int item) { currentItem = item; }
+    void logGlobalLookups(vector<GlobalLookup>* log) { lookupLog = log; }
     void enterScope();
+    void enterFunctionScope();
     void exitScope();
-    void addSymbol(const string& name, const string& type, bool isFunction = false);
-    void addFunction(const string& name, const string& retType, const vector<string>& paramTypes);
-    shared_ptr<SymbolInfo> lookup(const string& name, bool functionLookup = false);
-    shared_ptr<SymbolInfo> requireSymbol(const string& name);
-    shared_ptr<SymbolInfo> requireFunction(const string& name);
+    void exitToGlobalScope();
+    SymbolInfo* addSymbol(const string& name, TypeId type, bool isFunction = false);
+    SymbolInfo* addFunction(const string& name, TypeId retType, const vector<TypeId>& paramTypes);
+    SymbolInfo* lookup(const string& name, bool functionLookup = false);
+    SymbolInfo* requireSymbol(const string& name);
+    SymbolInfo* requireFunction(const string& name);
     void printScopes(ostream& os) const;
 };
 
@@ -101,11 +204,24 @@ class ScopeAnalyzer
 {
 private:
     ScopeStack scopeStack;
+    unordered_set<const ASTNode*> analyzedExprs;
+    unique_ptr<ScopeTree> tree;
+    
+    void declare(SymbolInfo* info, int pos, int end);
+    void reference(shared_ptr<IdentifierNode> id);
     
 public:
-    ScopeAnalyzer() {}
+    ScopeAnalyzer(const ScopeStack* globals = nullptr) : scopeStack(globals) {}
+    
+    // keep a ScopeTree of the next analyze() for positional queries
+    void recordScopeTree() { tree = make_unique<ScopeTree>(); }
+    const ScopeTree* getScopeTree() const { return tree.get(); }
     
     void analyze(shared_ptr<ProgramNode> program);
+    void declareFunctions(shared_ptr<ProgramNode> program);
+    void analyzeItem(const AST& item, int index);
+    // drops scopes left open by an analysis that threw
+    void resetScopes() { scopeStack.exitToGlobalScope(); }
     void printScopes(ostream& os) const;
     ScopeStack& getScopeStack() { return scopeStack; }
 private:
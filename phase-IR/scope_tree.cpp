@@ -0,0 +1,87 @@
+#include "scope_tree.h"
+#include "scope_analyzer.h"
+#include <algorithm>
+#include <climits>
+#include <unordered_set>
+
+using namespace std;
+
+ScopeTree::ScopeTree() 
+{
+    regions.push_back({0, INT_MAX, -1, {}, {}});
+    openRegions.push_back(0);
+    boundaries.push_back({0, 0});
+}
+
+void ScopeTree::openRegion(int begin) 
+{
+    int index = (int)regions.size();
+    regions.push_back({begin, INT_MAX, openRegions.back(), {}, {}});
+    openRegions.push_back(index);
+    boundaries.push_back({begin, index});
+}
+
+void ScopeTree::closeRegion(int end) 
+{
+    if (openRegions.size() <= 1) return;
+    
+    regions[openRegions.back()].end = end;
+    openRegions.pop_back();
+    boundaries.push_back({end, openRegions.back()});
+}
+
+void ScopeTree::declare(const SymbolInfo* info, int end) 
+{
+    regions[openRegions.back()].symbols.push_back(info);
+    regions[openRegions.back()].declEnds.push_back(end);
+}
+
+void ScopeTree::reference(int begin, int length, const SymbolInfo* info) 
+{
+    if (begin < 0 || !info) return;
+    refs.push_back({begin, begin + length, info});
+}
+
+void ScopeTree::finish() 
+{
+    // a declaration is recorded after its initializer, so uses arrive out of order
+    stable_sort(boundaries.begin(), boundaries.end(), 
+        [](const pair<int, int>& a, const pair<int, int>& b) { return a.first < b.first; });
+    sort(refs.begin(), refs.end(), 
+        [](const SymbolRef& a, const SymbolRef& b) { return a.begin < b.begin; });
+}
+
+int ScopeTree::regionAt(int pos) const 
+{
+    auto it = upper_bound(boundaries.begin(), boundaries.end(), pos, 
+        [](int p, const pair<int, int>& b) { return p < b.first; });
+    return it == boundaries.begin() ? 0 : prev(it)->second;
+}
+
+const SymbolInfo* ScopeTree::symbolAt(int pos) const 
+{
+    auto it = upper_bound(refs.begin(), refs.end(), pos, 
+        [](int p, const SymbolRef& r) { return p < r.begin; });
+    if (it == refs.begin()) return nullptr;
+    --it;
+    return pos < it->end ? it->symbol : nullptr;
+}
+
+vector<const SymbolInfo*> ScopeTree::visibleAt(int pos) const 
+{
+    vector<const SymbolInfo*> visible;
+    unordered_set<string> hidden;
+    for (int r = regionAt(pos); r >= 0; r = regions[r].parent) 
+    {
+        const ScopeRegion& region = regions[r];
+        for (size_t i = 0; i < region.symbols.size(); i++) 
+        {
+            // a variable comes into view after its declaration, initializer included
+            const SymbolInfo* info = region.symbols[i];
+            if (region.declEnds[i] >= pos) continue;
+            if (!hidden.insert(info->name + (info->isFunction ? "()" : "")).second) continue;
+            visible.push_back(info);
+        }
+    }
+    return visible;
+}
@@ -0,0 +1,59 @@
+#ifndef SCOPE_TREE_H
+#define SCOPE_TREE_H
+
+#include <vector>
+
+using namespace std;
+
+struct SymbolInfo;
+
+// One lexical scope of the analysed program, as a half-open source range.
+struct ScopeRegion 
+{
+    int begin;
+    int end;
+    int parent;                          // -1 for the global region
+    vector<const SymbolInfo*> symbols;   // in declaration order
+    vector<int> declEnds;                // where each symbol's declaration ends, -1 for functions
+};
+
+// A source range naming a symbol: a declaration or a resolved use.
+struct SymbolRef 
+{
+    int begin;
+    int end;
+    const SymbolInfo* symbol;
+};
+
+// Immutable record of every scope a ScopeAnalyzer run entered, kept after
+// the scopes are popped so tooling can ask "what is declared here" and
+// "what is visible here" without re-running the analysis. Scope entry and
+// exit points are kept as one sorted boundary list, so the innermost scope
+// at an offset and the symbol under an offset are binary searches.
+class ScopeTree 
+{
+private:
+    vector<ScopeRegion> regions;
+    vector<int> openRegions;
+    vector<pair<int, int>> boundaries;   // offset -> innermost region from there on
+    vector<SymbolRef> refs;
+    
+public:
+    ScopeTree();
+    
+    // recording, in source order
+    void openRegion(int begin);
+    void closeRegion(int end);
+    void declare(const SymbolInfo* info, int end);
+    void reference(int begin, int length, const SymbolInfo* info);
+    void finish();
+    
+    // queries, valid after finish()
+    size_t regionCount() const { return regions.size(); }
+    const ScopeRegion& region(int index) const { return regions[index]; }
+    int regionAt(int pos) const;
+    const SymbolInfo* symbolAt(int pos) const;
+    vector<const SymbolInfo*> visibleAt(int pos) const;
+};
+
+#endif
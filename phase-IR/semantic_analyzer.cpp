@@ -0,0 +1,266 @@
+#include "semantic_analyzer.h"
+#include "type_checker.h"
+#include "parser.h"
+
+using namespace std;
+
+// Evaluates one typing rule unless typing already failed; a violation is
+// kept as the program's type error and switches typing off.
+template <typename Rule>
+TypeId FusedSemanticAnalyzer::applyRule(Rule rule) 
+{
+    if (!typing) return TypeId::Void;
+    try 
+    {
+        return rule();
+    } 
+    catch (const TypeCheckException&) 
+    {
+        firstTypeError = current_exception();
+        typing = false;
+        return TypeId::Void;
+    }
+}
+
+void FusedSemanticAnalyzer::analyze(shared_ptr<ProgramNode> program) 
+{
+    visitProgram(program);
+    if (firstTypeError) rethrow_exception(firstTypeError);
+}
+
+TypeId FusedSemanticAnalyzer::visitNode(const AST& node) 
+{
+    if (!node) 
+    {
+        return applyRule([]() -> TypeId { throw TypeCheckException(TypeChkError::EmptyExpression); });
+    }
+    
+    if (auto block = dynamic_pointer_cast<BlockNode>(node)) 
+    {
+        visitBlock(block);
+    } 
+    else if (auto func = dynamic_pointer_cast<FunctionNode>(node)) 
+    {
+        visitFunction(func);
+    } 
+    else if (auto varDecl = dynamic_pointer_cast<VarDeclNode>(node)) 
+    {
+        visitVarDecl(varDecl);
+        return varDecl->typeName;
+    } 
+    else if (auto ret = dynamic_pointer_cast<ReturnNode>(node)) 
+    {
+        visitReturn(ret);
+    } 
+    else if (auto ifNode = dynamic_pointer_cast<IfNode>(node)) 
+    {
+        visitIf(ifNode);
+    } 
+    else if (auto whileNode = dynamic_pointer_cast<WhileNode>(node)) 
+    {
+        visitWhile(whileNode);
+    } 
+    else if (auto exprStmt = dynamic_pointer_cast<ExprStmtNode>(node)) 
+    {
+        visitNode(exprStmt->expr);
+    } 
+    else if (auto binOp = dynamic_pointer_cast<BinaryOpNode>(node)) 
+    {
+        if (node->shared && node->type != TypeId::Void) return node->type;
+        return node->type = visitBinaryOp(binOp);
+    } 
+    else if (auto unOp = dynamic_pointer_cast<UnaryOpNode>(node)) 
+    {
+        if (node->shared && node->type != TypeId::Void) return node->type;
+        return node->type = visitUnaryOp(unOp);
+    } 
+    else if (auto lit = dynamic_pointer_cast<LiteralNode>(node)) 
+    {
+        return node->type = lit->kind;
+    } 
+    else if (auto id = dynamic_pointer_cast<IdentifierNode>(node)) 
+    {
+        return node->type = visitIdentifier(id);
+    } 
+    else if (auto call = dynamic_pointer_cast<CallNode>(node)) 
+    {
+        return node->type = visitCall(call);
+    } 
+    else if (auto assign = dynamic_pointer_cast<AssignmentNode>(node)) 
+    {
+        return node->type = visitAssignment(assign);
+    }
+    
+    return TypeId::Void;
+}
+
+void FusedSemanticAnalyzer::visitProgram(shared_ptr<ProgramNode> node) 
+{
+    for (const auto& item : node->items) 
+    {
+        if (auto func = dynamic_pointer_cast<FunctionNode>(item)) 
+        {
+            vector<TypeId> paramTypes;
+            for (const auto& param : func->params) 
+            {
+                paramTypes.push_back(param.first);
+            }
+            scopeStack.addFunction(func->name, func->retType, paramTypes)->declPos = func->pos;
+        }
+    }
+    
+    for (size_t i = 0; i < node->items.size(); i++) 
+    {
+        scopeStack.setCurrentItem((int)i);
+        visitNode(node->items[i]);
+    }
+}
+
+void FusedSemanticAnalyzer::visitBlock(shared_ptr<BlockNode> node) 
+{
+    scopeStack.enterScope();
+    for (const auto& stmt : node->stmts) 
+    {
+        visitNode(stmt);
+    }
+    scopeStack.exitScope();
+}
+
+void FusedSemanticAnalyzer::visitFunction(shared_ptr<FunctionNode> node) 
+{
+    scopeStack.enterFunctionScope();
+    
+    node->paramSymbols.clear();
+    for (size_t i = 0; i < node->params.size(); i++) 
+    {
+        const auto& param = node->params[i];
+        SymbolInfo* info = scopeStack.addSymbol(param.second, param.first, false);
+        info->declPos = i < node->paramPositions.size() ? node->paramPositions[i] : -1;
+        node->paramSymbols.push_back(info);
+    }
+    
+    currentFunctionRetType = node->retType;
+    hasReturnStmt = false;
+    for (const auto& stmt : node->body->stmts) 
+    {
+        visitNode(stmt);
+    }
+    applyRule([&]() { checkFunctionReturns(*node, hasReturnStmt); return TypeId::Void; });
+    
+    scopeStack.exitScope();
+}
+
+void FusedSemanticAnalyzer::visitVarDecl(shared_ptr<VarDeclNode> node) 
+{
+    if (node->init) 
+    {
+        TypeId initType = visitNode(node->init);
+        applyRule([&]() { checkInitializerType(*node, initType); return TypeId::Void; });
+    }
+    
+    node->symbol = scopeStack.addSymbol(node->name, node->typeName, false);
+    node->symbol->declPos = node->pos;
+}
+
+void FusedSemanticAnalyzer::visitReturn(shared_ptr<ReturnNode> node) 
+{
+    hasReturnStmt = true;
+    TypeId exprType = node->expr ? visitNode(node->expr) : TypeId::Void;
+    applyRule([&]() 
+    {
+        checkReturnType(currentFunctionRetType, node->expr != nullptr, exprType);
+        return TypeId::Void;
+    });
+}
+
+void FusedSemanticAnalyzer::visitIf(shared_ptr<IfNode> node) 
+{
+    TypeId condType = visitNode(node->cond);
+    applyRule([&]() { checkConditionType("If", condType); return TypeId::Void; });
+    
+    visitBlock(node->thenBlock);
+    if (node->elseBlock) 
+    {
+        visitBlock(node->elseBlock);
+    }
+}
+
+void FusedSemanticAnalyzer::visitWhile(shared_ptr<WhileNode> node) 
+{
+    TypeId condType = visitNode(node->cond);
+    applyRule([&]() { checkConditionType("While", condType); return TypeId::Void; });
+    
+    visitBlock(node->body);
+}
+
+TypeId FusedSemanticAnalyzer::visitBinaryOp(shared_ptr<BinaryOpNode> node) 
+{
+    TypeId leftType = visitNode(node->left);
+    TypeId rightType = visitNode(node->right);
+    return applyRule([&]() { return binaryOpType(node->op, leftType, rightType); });
+}
+
+TypeId FusedSemanticAnalyzer::visitUnaryOp(shared_ptr<UnaryOpNode> node) 
+{
+    TypeId operandType = visitNode(node->operand);
+    return applyRule([&]() { return unaryOpType(node->op, operandType); });
+}
+
+TypeId FusedSemanticAnalyzer::visitIdentifier(shared_ptr<IdentifierNode> node) 
+{
+    node->symbol = scopeStack.requireSymbol(node->name);
+    return node->symbol->type;
+}
+
+TypeId FusedSemanticAnalyzer::visitCall(shared_ptr<CallNode> node) 
+{
+    auto idNode = dynamic_pointer_cast<IdentifierNode>(node->callee);
+    if (idNode) 
+    {
+        node->symbol = scopeStack.requireFunction(idNode->name);
+    } 
+    else 
+    {
+        applyRule([]() -> TypeId 
+        {
+            throw TypeCheckException(TypeChkError::ExpressionTypeMismatch, "Invalid function call");
+        });
+        visitNode(node->callee);
+    }
+    
+    if (idNode) 
+    {
+        applyRule([&]() { checkArgCount(idNode->name, *node->symbol, node->args.size()); return TypeId::Void; });
+    }
+    for (size_t i = 0; i < node->args.size(); i++) 
+    {
+        TypeId argType = visitNode(node->args[i]);
+        if (idNode) 
+        {
+            applyRule([&]() { checkArgType(idNode->name, *node->symbol, i, argType); return TypeId::Void; });
+        }
+    }
+    
+    return node->symbol ? node->symbol->type : TypeId::Void;
+}
+
+TypeId FusedSemanticAnalyzer::visitAssignment(shared_ptr<AssignmentNode> node) 
+{
+    TypeId leftType = TypeId::Void;
+    if (auto idNode = dynamic_pointer_cast<IdentifierNode>(node->left)) 
+    {
+        leftType = visitIdentifier(idNode);
+    } 
+    else 
+    {
+        applyRule([]() -> TypeId 
+        {
+            throw TypeCheckException(TypeChkError::ExpressionTypeMismatch,
+                "Left side of assignment must be a variable");
+        });
+        visitNode(node->left);
+    }
+    
+    TypeId rightType = visitNode(node->right);
+    return applyRule([&]() { return assignmentType(node->op, leftType, rightType); });
+}
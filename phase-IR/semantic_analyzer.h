@@ -0,0 +1,49 @@
+#ifndef SEMANTIC_ANALYZER_H
+#define SEMANTIC_ANALYZER_H
+
+#include <exception>
+#include <memory>
+#include "scope_analyzer.h"
+#include "types.h"
+
+using namespace std;
+
+// Name resolution and type checking in a single traversal. Scope errors are
+// thrown as soon as they are found. The first type error is only recorded:
+// typing stops there but resolution carries on, so a later scope error
+// still wins, and the type error is rethrown at the end. The diagnostics
+// therefore match running ScopeAnalyzer and then TypeChecker.
+class FusedSemanticAnalyzer 
+{
+private:
+    ScopeStack scopeStack;
+    TypeId currentFunctionRetType;
+    bool hasReturnStmt;
+    bool typing;
+    exception_ptr firstTypeError;
+    
+    template <typename Rule>
+    TypeId applyRule(Rule rule);
+    
+public:
+    FusedSemanticAnalyzer() : currentFunctionRetType(TypeId::Void), hasReturnStmt(false), typing(true) {}
+    
+    void analyze(shared_ptr<ProgramNode> program);
+    
+private:
+    TypeId visitNode(const AST& node);
+    void visitProgram(shared_ptr<ProgramNode> node);
+    void visitBlock(shared_ptr<BlockNode> node);
+    void visitFunction(shared_ptr<FunctionNode> node);
+    void visitVarDecl(shared_ptr<VarDeclNode> node);
+    void visitReturn(shared_ptr<ReturnNode> node);
+    void visitIf(shared_ptr<IfNode> node);
+    void visitWhile(shared_ptr<WhileNode> node);
+    TypeId visitBinaryOp(shared_ptr<BinaryOpNode> node);
+    TypeId visitUnaryOp(shared_ptr<UnaryOpNode> node);
+    TypeId visitIdentifier(shared_ptr<IdentifierNode> node);
+    TypeId visitCall(shared_ptr<CallNode> node);
+    TypeId visitAssignment(shared_ptr<AssignmentNode> node);
+};
+
+#endif
@@ -0,0 +1,1105 @@
+#include "ssa.h"
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+bool definesResult(const IRInstruction& instr) 
+{
+    if (isConditionalBranch(instr.op)) return false;
+    switch (instr.op) 
+    {
+        case IROpcode::LABEL:
+        case IROpcode::GOTO:
+        case IROpcode::PARAM:
+        case IROpcode::RETURN:
+        case IROpcode::FUNC_BEGIN:
+        case IROpcode::FUNC_END:
+            return false;
+        default:
+            break;
+    }
+    OperandKind kind = instr.result.kind();
+    return kind == OperandKind::Temp || kind == OperandKind::Var;
+}
+
+static bool isLocal(Operand operand) 
+{
+    return operand.kind() == OperandKind::Temp || operand.kind() == OperandKind::Var;
+}
+
+// Builds a CSR list from (key, value) pairs with keys below count.
+static void groupByKey(const vector<pair<uint32_t, uint32_t>>& pairs, size_t count,
+                       vector<uint32_t>& offsets, vector<uint32_t>& values) 
+{
+    offsets.assign(count + 1, 0);
+    for (const auto& p : pairs) offsets[p.first + 1]++;
+    for (size_t i = 0; i < count; i++) offsets[i + 1] += offsets[i];
+    values.resize(pairs.size());
+    vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (const auto& p : pairs) values[fill[p.first]++] = p.second;
+}
+
+int32_t& SSAFunction::slot(Operand operand) 
+{
+    vector<int32_t>& slots = operand.kind() == OperandKind::Temp ? tempSlots : nameSlots;
+    if (operand.index() >= slots.size()) slots.resize(operand.index() + 1, -1);
+    return slots[operand.index()];
+}
+
+Operand SSAFunction::newValue(Operand versionOf) 
+{
+    origin.push_back(versionOf);
+    return Operand(OperandKind::Temp, (uint32_t)(origin.size() - 1));
+}
+
+void SSAFunction::rebuildPredecessors() 
+{
+    for (auto& block : blocks) block.preds.clear();
+    for (uint32_t b = 0; b < blocks.size(); b++) 
+    {
+        for (uint32_t s : blocks[b].succs) blocks[s].preds.push_back(b);
+    }
+}
+
+uint32_t SSAFunction::addBlock(int32_t after) 
+{
+    blocks.emplace_back();
+    blocks.back().placeAfter = after;
+    return (uint32_t)(blocks.size() - 1);
+}
+
+uint32_t SSAFunction::splitEdge(uint32_t from, uint32_t to) 
+{
+    uint32_t middle = addBlock((int32_t)from);
+    SSABlock& block = blocks[middle];
+    block.code.push_back(IRInstruction(IROpcode::GOTO));
+    block.succs.push_back(to);
+    block.preds.push_back(from);
+    *find(blocks[from].succs.begin(), blocks[from].succs.end(), to) = middle;
+    *find(blocks[to].preds.begin(), blocks[to].preds.end(), from) = middle;
+    return middle;
+}
+
+void SSAFunction::removeEdge(uint32_t from, uint32_t to) 
+{
+    SSABlock& source = blocks[from];
+    source.succs.erase(find(source.succs.begin(), source.succs.end(), to));
+    if (isConditionalBranch(source.terminator().op) && source.succs.size() == 1) 
+    {
+        source.terminator() = IRInstruction(IROpcode::GOTO);
+    }
+    SSABlock& target = blocks[to];
+    size_t j = find(target.preds.begin(), target.preds.end(), from) - target.preds.begin();
+    target.preds.erase(target.preds.begin() + j);
+    for (auto& phi : target.phis) phi.args.erase(phi.args.begin() + j);
+}
+
+size_t SSAFunction::removeUnreachable() 
+{
+    vector<uint8_t> seen(blocks.size(), 0);
+    vector<uint32_t> stack = {0};
+    seen[0] = 1;
+    while (!stack.empty()) 
+    {
+        uint32_t b = stack.back();
+        stack.pop_back();
+        for (uint32_t s : blocks[b].succs) 
+        {
+            if (!seen[s]) 
+            {
+                seen[s] = 1;
+                stack.push_back(s);
+            }
+        }
+    }
+    size_t removed = 0;
+    for (uint32_t b = 0; b < blocks.size(); b++) 
+    {
+        if (seen[b]) continue;
+        SSABlock& block = blocks[b];
+        if (block.code.size() == 1 && block.phis.empty() && block.succs.empty() && block.preds.empty()) continue;
+        // only edges into live blocks have phi arguments left to drop
+        vector<uint32_t> succs = block.succs;
+        for (uint32_t s : succs) 
+        {
+            if (seen[s]) removeEdge(b, s);
+        }
+        block.succs.clear();
+        removed += block.phis.size() + block.code.size() - 1;
+        block.phis.clear();
+        block.preds.clear();
+        block.code.assign(1, IRInstruction(IROpcode::FUNC_END));
+    }
+    return removed;
+}
+
+void SSAFunction::build(const IRBuffer& code, const ControlFlowGraph& cfg) 
+{
+    name = code.result(cfg.functionBegin());
+    blocks.clear();
+    origin.clear();
+    droppedInstructions = 0;
+    
+    // only blocks reachable from the entry take part
+    size_t count = cfg.blockCount();
+    vector<int32_t> blockId(count, -1);
+    vector<uint32_t> stack = {0};
+    blockId[0] = 0;
+    while (!stack.empty()) 
+    {
+        uint32_t b = stack.back();
+        stack.pop_back();
+        for (uint32_t s : cfg.successors(b)) 
+        {
+            if (blockId[s] < 0) 
+            {
+                blockId[s] = 0;
+                stack.push_back(s);
+            }
+        }
+    }
+    for (size_t b = 0; b < count; b++) 
+    {
+        if (blockId[b] < 0) 
+        {
+            droppedInstructions += cfg.blockEnd(b) - cfg.blockBegin(b);
+            continue;
+        }
+        blockId[b] = (int32_t)blocks.size();
+        blocks.emplace_back();
+    }
+    
+    for (size_t b = 0; b < count; b++) 
+    {
+        if (blockId[b] < 0) continue;
+        SSABlock& block = blocks[blockId[b]];
+        size_t first = cfg.blockBegin(b), last = cfg.blockEnd(b);
+        if (first < last && code.op(first) == IROpcode::LABEL) first++;
+        for (size_t i = first; i < last; i++) block.code.push_back(code.at(i));
+        
+        auto succs = cfg.successors(b);
+        for (uint32_t s : succs) block.succs.push_back((uint32_t)blockId[s]);
+        IROpcode endOp = block.code.empty() ? IROpcode::LABEL : block.code.back().op;
+        if (endOp == IROpcode::RETURN) continue;
+        if (isConditionalBranch(endOp) && succs.size() == 2) 
+        {
+            block.code.back().result = Operand();
+        }
+        else if (endOp == IROpcode::GOTO || isConditionalBranch(endOp)) 
+        {
+            block.code.back() = IRInstruction(IROpcode::GOTO);
+        }
+        else if (!succs.size()) 
+        {
+            block.code.push_back(IRInstruction(IROpcode::FUNC_END));
+        }
+        else 
+        {
+            block.code.push_back(IRInstruction(IROpcode::GOTO));
+        }
+    }
+    // the entry must not be a loop header, its phis would have no argument
+    // for the values coming in from the caller
+    bool entryReentered = false;
+    for (const auto& block : blocks) 
+    {
+        for (uint32_t s : block.succs) entryReentered = entryReentered || s == 0;
+    }
+    if (entryReentered) 
+    {
+        uint32_t body = addBlock(0);
+        swap(blocks[0].code, blocks[body].code);
+        swap(blocks[0].succs, blocks[body].succs);
+        for (auto& block : blocks) 
+        {
+            for (uint32_t& s : block.succs) s = s == 0 ? body : s;
+        }
+        blocks[0].code.push_back(IRInstruction(IROpcode::GOTO));
+        blocks[0].succs.push_back(body);
+    }
+    rebuildPredecessors();
+    computeDominators();
+    
+    // every parameter, local and temp is a variable to rename; record the
+    // blocks defining each and the blocks reading it before any local definition
+    vector<Operand> vars;
+    auto variableOf = [&](Operand operand) -> uint32_t 
+    {
+        int32_t& index = slot(operand);
+        if (index < 0) 
+        {
+            index = (int32_t)vars.size();
+            vars.push_back(operand);
+        }
+        return (uint32_t)index;
+    };
+    vector<pair<uint32_t, uint32_t>> defPairs, usePairs;
+    vector<uint32_t> defStamp, useStamp, defCount;
+    for (uint32_t b = 0; b < blocks.size(); b++) 
+    {
+        for (auto& instr : blocks[b].code) 
+        {
+            forEachUse(instr, [&](Operand operand) 
+            {
+                if (!isLocal(operand)) return;
+                uint32_t v = variableOf(operand);
+                if (v >= defStamp.size()) defStamp.resize(v + 1, 0), useStamp.resize(v + 1, 0);
+                if (defStamp[v] == b + 1 || useStamp[v] == b + 1) return;
+                useStamp[v] = b + 1;
+                usePairs.push_back({v, b});
+            });
+            if (!definesResult(instr)) continue;
+            uint32_t v = variableOf(instr.result);
+            if (v >= defStamp.size()) defStamp.resize(v + 1, 0), useStamp.resize(v + 1, 0);
+            if (v >= defCount.size()) defCount.resize(v + 1, 0);
+            defCount[v]++;
+            if (defStamp[v] == b + 1) continue;
+            defStamp[v] = b + 1;
+            defPairs.push_back({v, b});
+        }
+    }
+    size_t varCount = vars.size();
+    defCount.resize(varCount, 0);
+    vector<uint32_t> defOffsets, defBlocks, useOffsets, useBlocks;
+    groupByKey(defPairs, varCount, defOffsets, defBlocks);
+    groupByKey(usePairs, varCount, useOffsets, useBlocks);
+    
+    // Phis go on the iterated dominance frontier of the defining blocks of
+    // every variable read before assignment in some block (Briggs'
+    // semi-pruned form); the ones that turn out dead are dropped after
+    // renaming. Walking liveness per variable up front instead would cost
+    // blocks times variables on long functions.
+    vector<vector<uint32_t>> frontiers;
+    computeFrontiers(frontiers);
+    size_t blockCount = blocks.size();
+    vector<uint32_t> phiMark(blockCount, 0), workMark(blockCount, 0);
+    vector<vector<uint32_t>> phiVars(blockCount);
+    vector<uint32_t> work;
+    for (uint32_t v = 0; v < varCount; v++) 
+    {
+        if (defOffsets[v] == defOffsets[v + 1] || useOffsets[v] == useOffsets[v + 1]) continue;
+        uint32_t stamp = v + 1;
+        for (uint32_t i = defOffsets[v]; i < defOffsets[v + 1]; i++) 
+        {
+            workMark[defBlocks[i]] = stamp;
+            work.push_back(defBlocks[i]);
+        }
+        while (!work.empty()) 
+        {
+            uint32_t b = work.back();
+            work.pop_back();
+            for (uint32_t d : frontiers[b]) 
+            {
+                if (phiMark[d] == stamp) continue;
+                phiMark[d] = stamp;
+                blocks[d].phis.push_back({Operand(), vector<Operand>(blocks[d].preds.size())});
+                phiVars[d].push_back(v);
+                if (workMark[d] != stamp) 
+                {
+                    workMark[d] = stamp;
+                    work.push_back(d);
+                }
+            }
+        }
+    }
+    
+    // renaming over the dominator tree; a variable assigned more than once
+    // names its versions after the first one so out-of-SSA can merge them
+    vector<Operand> current(varCount), group(varCount);
+    vector<bool> versioned(varCount, false);
+    for (uint32_t v = 0; v < varCount; v++) 
+    {
+        if (vars[v].kind() == OperandKind::Var) current[v] = group[v] = vars[v];
+        versioned[v] = vars[v].kind() == OperandKind::Var || defCount[v] > 1;
+    }
+    for (uint32_t b = 0; b < blockCount; b++) 
+    {
+        for (uint32_t v : phiVars[b]) versioned[v] = true;
+    }
+    auto newVersion = [&](uint32_t v) 
+    {
+        Operand value = newValue(group[v]);
+        if (versioned[v] && group[v].empty()) 
+        {
+            group[v] = value;
+            origin[value.index()] = value;
+        }
+        return value;
+    };
+    auto rename = [&](Operand& operand) 
+    {
+        if (!isLocal(operand)) return;
+        int32_t v = slot(operand);
+        if (v >= 0 && !current[v].empty()) operand = current[v];
+    };
+    
+    vector<pair<uint32_t, Operand>> undo;
+    vector<pair<uint32_t, size_t>> walk;    // block and its undo mark
+    vector<uint32_t> childCursor(blockCount, 0);
+    auto enter = [&](uint32_t b) 
+    {
+        walk.push_back({b, undo.size()});
+        SSABlock& block = blocks[b];
+        for (size_t k = 0; k < block.phis.size(); k++) 
+        {
+            uint32_t v = phiVars[b][k];
+            block.phis[k].result = newVersion(v);
+            undo.push_back({v, current[v]});
+            current[v] = block.phis[k].result;
+        }
+        for (auto& instr : block.code) 
+        {
+            forEachUse(instr, rename);
+            if (!definesResult(instr)) continue;
+            uint32_t v = (uint32_t)slot(instr.result);
+            instr.result = newVersion(v);
+            undo.push_back({v, current[v]});
+            current[v] = instr.result;
+        }
+        for (uint32_t s : block.succs) 
+        {
+            SSABlock& succ = blocks[s];
+            size_t j = find(succ.preds.begin(), succ.preds.end(), b) - succ.preds.begin();
+            for (size_t k = 0; k < succ.phis.size(); k++) succ.phis[k].args[j] = current[phiVars[s][k]];
+        }
+    };
+    enter(0);
+    while (!walk.empty()) 
+    {
+        uint32_t b = walk.back().first;
+        auto children = dominatorChildren(b);
+        if (childCursor[b] < children.size()) 
+        {
+            enter(children[childCursor[b]++]);
+            continue;
+        }
+        for (size_t i = undo.size(); i > walk.back().second; i--) current[undo[i - 1].first] = undo[i - 1].second;
+        undo.resize(walk.back().second);
+        walk.pop_back();
+    }
+    for (Operand var : vars) slot(var) = -1;
+    
+    // a phi is live when a real instruction reads it, directly or through
+    // other live phis; what remains is exactly the pruned form
+    vector<int64_t> phiOf(valueCount(), -1);
+    vector<vector<bool>> useful(blockCount);
+    for (uint32_t b = 0; b < blockCount; b++) 
+    {
+        useful[b].assign(blocks[b].phis.size(), false);
+        for (size_t k = 0; k < blocks[b].phis.size(); k++) 
+        {
+            phiOf[blocks[b].phis[k].result.index()] = ((int64_t)b << 32) | k;
+        }
+    }
+    auto markUseful = [&](Operand operand) 
+    {
+        if (!isValue(operand) || phiOf[operand.index()] < 0) return;
+        int64_t site = phiOf[operand.index()];
+        phiOf[operand.index()] = -1;
+        useful[site >> 32][site & 0xffffffff] = true;
+        work.push_back((uint32_t)(site >> 32));
+        work.push_back((uint32_t)(site & 0xffffffff));
+    };
+    for (auto& block : blocks) 
+    {
+        for (auto& instr : block.code) forEachUse(instr, markUseful);
+    }
+    while (!work.empty()) 
+    {
+        uint32_t k = work.back();
+        work.pop_back();
+        uint32_t b = work.back();
+        work.pop_back();
+        for (Operand arg : blocks[b].phis[k].args) markUseful(arg);
+    }
+    for (uint32_t b = 0; b < blockCount; b++) 
+    {
+        auto& phis = blocks[b].phis;
+        size_t kept = 0;
+        for (size_t k = 0; k < phis.size(); k++) 
+        {
+            if (!useful[b][k]) continue;
+            if (kept != k) phis[kept] = move(phis[k]);
+            kept++;
+        }
+        phis.resize(kept);
+    }
+}
+
+void SSAFunction::computeDominators() 
+{
+    size_t count = blocks.size();
+    vector<uint32_t> postorder;
+    vector<uint32_t> cursor(count, 0);
+    vector<bool> seen(count, false);
+    vector<uint32_t> stack = {0};
+    seen[0] = true;
+    while (!stack.empty()) 
+    {
+        uint32_t b = stack.back();
+        if (cursor[b] < blocks[b].succs.size()) 
+        {
+            uint32_t s = blocks[b].succs[cursor[b]++];
+            if (!seen[s]) 
+            {
+                seen[s] = true;
+                stack.push_back(s);
+            }
+            continue;
+        }
+        postorder.push_back(b);
+        stack.pop_back();
+    }
+    rpo.assign(postorder.rbegin(), postorder.rend());
+    vector<uint32_t> order(count, UINT32_MAX);
+    for (uint32_t i = 0; i < rpo.size(); i++) order[rpo[i]] = i;
+    
+    idom.assign(count, -1);
+    idom[0] = 0;
+    auto intersect = [&](uint32_t a, uint32_t b) 
+    {
+        while (a != b) 
+        {
+            while (order[a] > order[b]) a = (uint32_t)idom[a];
+            while (order[b] > order[a]) b = (uint32_t)idom[b];
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed) 
+    {
+        changed = false;
+        for (size_t i = 1; i < rpo.size(); i++) 
+        {
+            uint32_t b = rpo[i];
+            int32_t next = -1;
+            for (uint32_t p : blocks[b].preds) 
+            {
+                if (idom[p] < 0) continue;
+                next = next < 0 ? (int32_t)p : (int32_t)intersect(p, (uint32_t)next);
+            }
+            if (next != idom[b]) 
+            {
+                idom[b] = next;
+                changed = true;
+            }
+        }
+    }
+    idom[0] = -1;
+    
+    vector<pair<uint32_t, uint32_t>> edges;
+    for (size_t i = 1; i < rpo.size(); i++) edges.push_back({(uint32_t)idom[rpo[i]], rpo[i]});
+    groupByKey(edges, count, domChildOffsets, domChildren);
+    
+    domPre.assign(count, 0);
+    domPost.assign(count, 0);
+    uint32_t clock = 0;
+    fill(cursor.begin(), cursor.end(), 0);
+    stack = {0};
+    domPre[0] = clock++;
+    while (!stack.empty()) 
+    {
+        uint32_t b = stack.back();
+        auto children = dominatorChildren(b);
+        if (cursor[b] < children.size()) 
+        {
+            uint32_t c = children[cursor[b]++];
+            domPre[c] = clock++;
+            stack.push_back(c);
+            continue;
+        }
+        domPost[b] = clock++;
+        stack.pop_back();
+    }
+}
+
+// Cooper, Harvey and Kennedy: walk up from each predecessor of a join
+// block to its immediate dominator
+void SSAFunction::computeFrontiers(vector<vector<uint32_t>>& frontiers) const 
+{
+    frontiers.assign(blocks.size(), {});
+    for (uint32_t b = 0; b < blocks.size(); b++) 
+    {
+        if (blocks[b].preds.size() < 2 || !reachable(b)) continue;
+        for (uint32_t p : blocks[b].preds) 
+        {
+            if (!reachable(p)) continue;
+            int32_t runner = (int32_t)p;
+            while (runner >= 0 && runner != idom[b]) 
+            {
+                auto& frontier = frontiers[runner];
+                if (frontier.empty() || frontier.back() != b) frontier.push_back(b);
+                runner = idom[runner];
+            }
+        }
+    }
+}
+
+void SSAFunction::computeDefUse() 
+{
+    size_t count = valueCount();
+    defSites.assign(count, {0, -1, -1});
+    vector<pair<uint32_t, SSASite>> uses;
+    for (uint32_t b = 0; b < blocks.size(); b++) 
+    {
+        SSABlock& block = blocks[b];
+        for (int32_t k = 0; k < (int32_t)block.phis.size(); k++) 
+        {
+            defSites[block.phis[k].result.index()] = {b, -1, k};
+            for (Operand arg : block.phis[k].args) 
+            {
+                if (isValue(arg)) uses.push_back({arg.index(), {b, -1, k}});
+            }
+        }
+        for (int32_t i = 0; i < (int32_t)block.code.size(); i++) 
+        {
+            IRInstruction& instr = block.code[i];
+            forEachUse(instr, [&](Operand operand) 
+            {
+                if (isValue(operand)) uses.push_back({operand.index(), {b, i, -1}});
+            });
+            if (definesResult(instr) && isValue(instr.result)) defSites[instr.result.index()] = {b, i, -1};
+        }
+    }
+    useOffsets.assign(count + 1, 0);
+    for (const auto& use : uses) useOffsets[use.first + 1]++;
+    for (size_t v = 0; v < count; v++) useOffsets[v + 1] += useOffsets[v];
+    useSites.resize(uses.size());
+    vector<uint32_t> fill(useOffsets.begin(), useOffsets.end() - 1);
+    for (const auto& use : uses) useSites[fill[use.first]++] = use.second;
+}
+
+void SSAFunction::replaceValues(const vector<Operand>& replacement) 
+{
+    auto isReplaced = [&](Operand result) 
+    {
+        return isValue(result) && result.index() < replacement.size() && !replacement[result.index()].empty();
+    };
+    for (auto& block : blocks) 
+    {
+        size_t kept = 0;
+        for (size_t k = 0; k < block.phis.size(); k++) 
+        {
+            if (isReplaced(block.phis[k].result)) continue;
+            for (Operand& arg : block.phis[k].args) arg = replaced(replacement, arg);
+            if (kept != k) block.phis[kept] = move(block.phis[k]);
+            kept++;
+        }
+        block.phis.resize(kept);
+        
+        kept = 0;
+        for (size_t i = 0; i < block.code.size(); i++) 
+        {
+            IRInstruction instr = block.code[i];
+            if (instr.op != IROpcode::CALL && isReplaced(instr.result)) continue;
+            forEachUse(instr, [&](Operand& operand) { operand = replaced(replacement, operand); });
+            block.code[kept++] = instr;
+        }
+        block.code.erase(block.code.begin() + kept, block.code.end());
+    }
+}
+
+// copies of phi arguments have to go on the edge itself, so an edge from
+// a block with several successors into a phi block gets its own block
+void SSAFunction::splitPhiEdges() 
+{
+    size_t count = blocks.size();
+    for (uint32_t s = 0; s < count; s++) 
+    {
+        if (blocks[s].phis.empty()) continue;
+        for (size_t j = 0; j < blocks[s].preds.size(); j++) 
+        {
+            uint32_t p = blocks[s].preds[j];
+            if (blocks[p].succs.size() > 1) splitEdge(p, s);
+        }
+    }
+}
+
+// Orders a parallel copy so that no destination is overwritten before it
+// has been read, breaking cycles through a scratch temp.
+static void sequentialize(vector<pair<Operand, Operand>>& copies, vector<IRInstruction>& out,
+                          const function<Operand()>& scratch) 
+{
+    while (!copies.empty()) 
+    {
+        bool emitted = false;
+        for (size_t i = 0; i < copies.size(); i++) 
+        {
+            Operand dst = copies[i].first;
+            bool read = false;
+            for (size_t j = 0; j < copies.size() && !read; j++) read = j != i && copies[j].second == dst;
+            if (read) continue;
+            out.push_back(IRInstruction(IROpcode::COPY, dst, copies[i].second));
+            copies.erase(copies.begin() + i);
+            emitted = true;
+            break;
+        }
+        if (emitted) continue;
+        Operand saved = scratch();
+        Operand dst = copies[0].first;
+        out.push_back(IRInstruction(IROpcode::COPY, saved, dst));
+        for (auto& copy : copies) 
+        {
+            if (copy.second == dst) copy.second = saved;
+        }
+    }
+}
+
+void SSAFunction::toTAC(vector<IRInstruction>& out, uint32_t& nextLabel) 
+{
+    splitPhiEdges();
+    computeDominators();
+    size_t blockCount = blocks.size();
+    uint32_t temps = valueCount();
+    
+    // values are the temps plus the entry value of every Var
+    vector<Operand> varOperands;
+    auto valueOf = [&](Operand operand) -> int64_t 
+    {
+        if (isValue(operand)) return operand.index();
+        if (operand.kind() != OperandKind::Var) return -1;
+        int32_t& index = slot(operand);
+        if (index < 0) 
+        {
+            index = (int32_t)varOperands.size();
+            varOperands.push_back(operand);
+        }
+        return temps + index;
+    };
+    for (uint32_t v = 0; v < temps; v++) 
+    {
+        if (origin[v].kind() == OperandKind::Var) valueOf(origin[v]);
+    }
+    
+    // definition points and uses; an entry value is defined before the
+    // entry block, a phi at the top of its block and a phi argument is read
+    // at the end of the predecessor
+    const int32_t entryPos = INT32_MIN;
+    vector<uint32_t> defBlock(temps, 0);
+    vector<int32_t> defPos(temps, entryPos);
+    vector<pair<uint32_t, uint32_t>> instrUses, phiUses;    // (value, use index / block)
+    vector<pair<uint32_t, int32_t>> useSites;               // (block, instruction index)
+    for (uint32_t b = 0; b < blockCount; b++) 
+    {
+        if (!reachable(b)) continue;
+        const SSABlock& block = blocks[b];
+        for (size_t k = 0; k < block.phis.size(); k++) 
+        {
+            uint32_t d = block.phis[k].result.index();
+            defBlock[d] = b;
+            defPos[d] = (int32_t)k - (int32_t)block.phis.size();
+            for (size_t j = 0; j < block.phis[k].args.size(); j++) 
+            {
+                int64_t v = valueOf(block.phis[k].args[j]);
+                if (v >= 0) phiUses.push_back({(uint32_t)v, block.preds[j]});
+            }
+        }
+        for (int32_t i = 0; i < (int32_t)block.code.size(); i++) 
+        {
+            IRInstruction instr = block.code[i];
+            forEachUse(instr, [&](Operand operand) 
+            {
+                int64_t v = valueOf(operand);
+                if (v < 0) return;
+                instrUses.push_back({(uint32_t)v, (uint32_t)useSites.size()});
+                useSites.push_back({b, i});
+            });
+            if (!definesResult(instr)) continue;
+            uint32_t d = instr.result.index();
+            defBlock[d] = b;
+            defPos[d] = i;
+        }
+    }
+    size_t values = temps + varOperands.size();
+    defBlock.resize(values, 0);
+    defPos.resize(values, entryPos);
+    // instruction uses of a value stay sorted by block and index
+    vector<uint32_t> useOffsets, useIndices, phiUseOffsets, phiUseBlocks;
+    groupByKey(instrUses, values, useOffsets, useIndices);
+    groupByKey(phiUses, values, phiUseOffsets, phiUseBlocks);
+    
+    // Most checks are settled without the walk: nothing after a block can
+    // be reached from it if every use lies earlier in reverse postorder than
+    // anything the block reaches, its own earlier uses included unless the
+    // block sits on a cycle.
+    vector<uint32_t> order(blockCount, 0), reach(blockCount, 0);
+    vector<bool> onCycle(blockCount, false);
+    for (uint32_t i = 0; i < rpo.size(); i++) order[rpo[i]] = reach[rpo[i]] = i;
+    for (bool changed = true; changed; ) 
+    {
+        changed = false;
+        for (size_t i = rpo.size(); i-- > 0; ) 
+        {
+            uint32_t b = rpo[i];
+            for (uint32_t s : blocks[b].succs) 
+            {
+                if (reach[s] >= reach[b]) continue;
+                reach[b] = reach[s];
+                changed = true;
+            }
+        }
+    }
+    for (uint32_t b : rpo) 
+    {
+        onCycle[b] = reach[b] < order[b];
+        for (uint32_t p : blocks[b].preds) onCycle[b] = onCycle[b] || order[p] >= order[b];
+    }
+    // per value: the latest use block in reverse postorder, and the latest
+    // among the other blocks
+    vector<int64_t> lastUse(values, -1), lastOtherUse(values, -1);
+    vector<uint32_t> lastUseBlock(values, 0);
+    auto noteUse = [&](uint32_t v, uint32_t b) 
+    {
+        int64_t at = order[b];
+        if (at > lastUse[v]) 
+        {
+            if (lastUse[v] >= 0 && lastUseBlock[v] != b) lastOtherUse[v] = lastUse[v];
+            lastUse[v] = at;
+            lastUseBlock[v] = b;
+        }
+        else if (b != lastUseBlock[v] && at > lastOtherUse[v]) 
+        {
+            lastOtherUse[v] = at;
+        }
+    };
+    for (const auto& use : instrUses) noteUse(use.first, useSites[use.second].first);
+    for (const auto& use : phiUses) noteUse(use.first, use.second);
+    for (uint32_t v = 0; v < values; v++) sort(phiUseBlocks.begin() + phiUseOffsets[v], phiUseBlocks.begin() + phiUseOffsets[v + 1]);
+    
+    // per value: the dominator tree preorder numbers of its use blocks, so
+    // whether a dominator subtree holds a use is a binary search
+    vector<pair<uint32_t, uint32_t>> usePres;
+    for (const auto& use : instrUses) usePres.push_back({use.first, domPre[useSites[use.second].first]});
+    for (const auto& use : phiUses) usePres.push_back({use.first, domPre[use.second]});
+    vector<uint32_t> usePreOffsets, usePreValues;
+    groupByKey(usePres, values, usePreOffsets, usePreValues);
+    for (uint32_t v = 0; v < values; v++) sort(usePreValues.begin() + usePreOffsets[v], usePreValues.begin() + usePreOffsets[v + 1]);
+    auto usedWithin = [&](uint32_t v, uint32_t low, uint32_t high) 
+    {
+        auto first = usePreValues.begin() + usePreOffsets[v], last = usePreValues.begin() + usePreOffsets[v + 1];
+        auto it = lower_bound(first, last, low);
+        return it != last && *it < high;
+    };
+    
+    // Whether a use of v can be reached from the end of b without passing
+    // its definition, walking forward. A block the definition dominates
+    // and that dominates a use is as good as the use, by the argument in
+    // liveAfter, so the walk mostly stops at the first join after b's loop.
+    // Blocks that only reach blocks later than every use are left out.
+    vector<uint32_t> seen(blockCount, 0), work;
+    uint32_t stamp = 0;
+    auto reachesUse = [&](uint32_t v, uint32_t b) 
+    {
+        stamp++;
+        auto visit = [&](uint32_t s) 
+        {
+            if (s == defBlock[v] || (int64_t)reach[s] > lastUse[v] || seen[s] == stamp) return;
+            seen[s] = stamp;
+            work.push_back(s);
+        };
+        for (uint32_t s : blocks[b].succs) visit(s);
+        bool found = false;
+        while (!work.empty() && !found) 
+        {
+            uint32_t x = work.back();
+            work.pop_back();
+            found = dominates(defBlock[v], x) && usedWithin(v, domPre[x], domPost[x]);
+            for (uint32_t s : blocks[x].succs) visit(s);
+        }
+        work.clear();
+        return found;
+    };
+    
+    // whether v is still needed just after position pos of block b, which
+    // v's definition dominates
+    auto liveAfter = [&](uint32_t v, uint32_t b, int32_t pos) 
+    {
+        auto first = useIndices.begin() + useOffsets[v], last = useIndices.begin() + useOffsets[v + 1];
+        auto it = lower_bound(first, last, make_pair(b, pos + 1), [&](uint32_t use, pair<uint32_t, int32_t> site) 
+        {
+            return useSites[use] < site;
+        });
+        if (it != last && useSites[*it].first == b) return true;
+        auto phiFirst = phiUseBlocks.begin() + phiUseOffsets[v], phiLast = phiUseBlocks.begin() + phiUseOffsets[v + 1];
+        if (binary_search(phiFirst, phiLast, b)) return true;
+        int64_t latest = lastUseBlock[v] == b && !onCycle[b] ? lastOtherUse[v] : lastUse[v];
+        if (latest < (int64_t)reach[b]) return false;
+        // A use in a block b strictly dominates is reached: the path there
+        // from the last visit of b cannot pass the definition, which would
+        // then reach the use around b.
+        if (usedWithin(v, domPre[b] + 1, domPost[b])) return true;
+        return reachesUse(v, b);
+    };
+    
+    // Every version of a variable starts out with the variable's name. Two
+    // values of one name interfere only if one is live where the other is
+    // defined, and that definition is dominated by the first. Walking each
+    // name's values in dominator tree order with a stack of the enclosing
+    // ones (Budimlic et al.), a value defined while its nearest enclosing
+    // value is still live gets a fresh name.
+    vector<uint32_t> nameOf(values);
+    for (uint32_t v = 0; v < temps; v++) 
+    {
+        if (origin[v].empty()) nameOf[v] = v;
+        else if (isValue(origin[v])) nameOf[v] = origin[v].index();
+        else nameOf[v] = (uint32_t)valueOf(origin[v]);
+    }
+    for (uint32_t v = temps; v < values; v++) nameOf[v] = v;
+    // values that version a variable, in dominator tree preorder of their
+    // definitions, then grouped by name
+    vector<pair<uint32_t, uint32_t>> shared;    // (name, value)
+    auto share = [&](uint32_t v) 
+    {
+        if (v >= temps || !origin[v].empty()) shared.push_back({nameOf[v], v});
+    };
+    for (uint32_t v = temps; v < values; v++) share(v);
+    vector<uint32_t> stack = {0};
+    while (!stack.empty()) 
+    {
+        uint32_t b = stack.back();
+        stack.pop_back();
+        for (const auto& phi : blocks[b].phis) share(phi.result.index());
+        for (const auto& instr : blocks[b].code) 
+        {
+            if (definesResult(instr)) share(instr.result.index());
+        }
+        auto children = dominatorChildren(b);
+        for (size_t i = children.size(); i-- > 0; ) stack.push_back(children[i]);
+    }
+    vector<uint32_t> nameOffsets, nameValues;
+    groupByKey(shared, values, nameOffsets, nameValues);
+    
+    uint32_t nameCount = (uint32_t)values;
+    vector<uint32_t> enclosing;
+    for (uint32_t n = 0; n < values; n++) 
+    {
+        if (nameOffsets[n + 1] - nameOffsets[n] < 2) continue;
+        enclosing.clear();
+        for (uint32_t i = nameOffsets[n]; i < nameOffsets[n + 1]; i++) 
+        {
+            uint32_t v = nameValues[i];
+            while (!enclosing.empty()) 
+            {
+                uint32_t top = enclosing.back();
+                bool encloses = defBlock[top] == defBlock[v] ? defPos[top] < defPos[v] : dominates(defBlock[top], defBlock[v]);
+                if (encloses) break;
+                enclosing.pop_back();
+            }
+            if (!enclosing.empty() && liveAfter(enclosing.back(), defBlock[v], defPos[v] < 0 ? -1 : defPos[v])) 
+            {
+                nameOf[v] = nameCount++;
+                continue;
+            }
+            enclosing.push_back(v);
+        }
+    }
+    
+    // blocks left holding nothing but a jump, such as split edges that need
+    // no copies after all, are bypassed
+    auto copiesNothing = [&](uint32_t b) 
+    {
+        const SSABlock& block = blocks[b];
+        if (block.succs.size() != 1) return true;
+        const SSABlock& succ = blocks[block.succs[0]];
+        size_t j = find(succ.preds.begin(), succ.preds.end(), b) - succ.preds.begin();
+        for (const auto& phi : succ.phis) 
+        {
+            int64_t v = valueOf(phi.args[j]);
+            if (v >= 0 ? nameOf[v] != nameOf[phi.result.index()] : !phi.args[j].empty()) return false;
+        }
+        return true;
+    };
+    vector<uint32_t> forward(blockCount);
+    for (uint32_t b = 0; b < blockCount; b++) 
+    {
+        const SSABlock& block = blocks[b];
+        bool empty = b != 0 && block.phis.empty() && block.code.size() == 1 &&
+                     block.terminator().op == IROpcode::GOTO && copiesNothing(b);
+        forward[b] = empty ? block.succs[0] : b;
+    }
+    auto target = [&](uint32_t b) 
+    {
+        for (size_t hops = 0; forward[b] != b && hops < blockCount; hops++) b = forward[b];
+        return b;
+    };
+    
+    // layout: original blocks in order, each followed by the blocks placed after it
+    vector<vector<uint32_t>> placed(blockCount);
+    vector<uint32_t> layout, pending;
+    for (uint32_t b = 0; b < blockCount; b++) 
+    {
+        if (blocks[b].placeAfter >= 0) placed[blocks[b].placeAfter].push_back(b);
+    }
+    for (uint32_t b = 0; b < blockCount; b++) 
+    {
+        if (blocks[b].placeAfter >= 0) continue;
+        pending.push_back(b);
+        while (!pending.empty()) 
+        {
+            uint32_t next = pending.back();
+            pending.pop_back();
+            if (reachable(next) && forward[next] == next) layout.push_back(next);
+            for (size_t i = placed[next].size(); i-- > 0; ) pending.push_back(placed[next][i]);
+        }
+    }
+    vector<int32_t> following(blockCount, -1);
+    for (size_t i = 0; i + 1 < layout.size(); i++) following[layout[i]] = (int32_t)layout[i + 1];
+    
+    // each block's exits: jump to taken when the branch is taken, else go on to fall
+    vector<int32_t> labels(blockCount, -1);
+    auto jumpTarget = [&](uint32_t b) { labels[b] = -2; };
+    vector<uint32_t> taken(blockCount), fall(blockCount);
+    for (uint32_t b : layout) 
+    {
+        const SSABlock& block = blocks[b];
+        IROpcode op = block.terminator().op;
+        if (op == IROpcode::GOTO || isConditionalBranch(op)) fall[b] = target(block.succs[0]);
+        if (isConditionalBranch(op)) taken[b] = target(block.succs[1]);
+        if (isConditionalBranch(op) && taken[b] != fall[b]) 
+        {
+            // a branch without a negation jumps to taken even when it follows
+            bool invert = following[b] == (int32_t)taken[b] && negatedBranch(op) != op;
+            jumpTarget(invert ? fall[b] : taken[b]);
+            if (!invert && following[b] != (int32_t)fall[b]) jumpTarget(fall[b]);
+        }
+        else if ((op == IROpcode::GOTO || isConditionalBranch(op)) && following[b] != (int32_t)fall[b]) 
+        {
+            jumpTarget(fall[b]);
+        }
+    }
+    for (uint32_t b : layout) 
+    {
+        if (labels[b] == -2) labels[b] = (int32_t)nextLabel++;
+    }
+    auto label = [&](uint32_t b) { return Operand(OperandKind::Label, (uint32_t)labels[b]); };
+    
+    vector<int32_t> tempNumber(nameCount, -1);
+    uint32_t nextTemp = 0;
+    auto emitted = [&](Operand operand) -> Operand 
+    {
+        int64_t v = valueOf(operand);
+        if (v < 0) return operand;
+        uint32_t n = nameOf[v];
+        if (n >= temps && n < values) return varOperands[n - temps];
+        if (tempNumber[n] < 0) tempNumber[n] = (int32_t)nextTemp++;
+        return Operand(OperandKind::Temp, (uint32_t)tempNumber[n]);
+    };
+    auto scratch = [&]() { return Operand(OperandKind::Temp, nextTemp++); };
+    
+    out.push_back(IRInstruction(IROpcode::FUNC_BEGIN, name));
+    vector<pair<Operand, Operand>> copies;
+    for (uint32_t b : layout) 
+    {
+        const SSABlock& block = blocks[b];
+        if (labels[b] >= 0) out.push_back(IRInstruction(IROpcode::LABEL, label(b)));
+        for (size_t i = 0; i + 1 < block.code.size(); i++) 
+        {
+            IRInstruction instr = block.code[i];
+            if (instr.op != IROpcode::CALL) 
+            {
+                instr.arg1 = emitted(instr.arg1);
+                instr.arg2 = emitted(instr.arg2);
+            }
+            instr.result = emitted(instr.result);
+            if (instr.op == IROpcode::COPY && instr.result == instr.arg1) continue;
+            out.push_back(instr);
+        }
+        if (block.succs.size() == 1 && !blocks[block.succs[0]].phis.empty()) 
+        {
+            const SSABlock& succ = blocks[block.succs[0]];
+            size_t j = find(succ.preds.begin(), succ.preds.end(), b) - succ.preds.begin();
+            for (const auto& phi : succ.phis) 
+            {
+                Operand dst = emitted(phi.result), src = emitted(phi.args[j]);
+                if (!src.empty() && dst != src) copies.push_back({dst, src});
+            }
+            sequentialize(copies, out, scratch);
+        }
+        
+        IRInstruction term = block.terminator();
+        int32_t next = following[b];
+        IROpcode op = isConditionalBranch(term.op) && taken[b] == fall[b] ? IROpcode::GOTO : term.op;
+        switch (op) 
+        {
+            case IROpcode::GOTO:
+                if (next != (int32_t)fall[b]) out.push_back(IRInstruction(IROpcode::GOTO, label(fall[b])));
+                break;
+            case IROpcode::RETURN:
+                out.push_back(IRInstruction(IROpcode::RETURN, Operand(), emitted(term.arg1)));
+                break;
+            default: 
+            {
+                if (!isConditionalBranch(op)) 
+                {
+                    if (next >= 0) out.push_back(IRInstruction(IROpcode::RETURN));
+                    break;
+                }
+                Operand left = emitted(term.arg1), right = emitted(term.arg2);
+                IROpcode inverse = negatedBranch(op);
+                if (next == (int32_t)taken[b] && inverse != op) 
+                {
+                    out.push_back(IRInstruction(inverse, label(fall[b]), left, right));
+                    break;
+                }
+                out.push_back(IRInstruction(op, label(taken[b]), left, right));
+                if (next != (int32_t)fall[b]) out.push_back(IRInstruction(IROpcode::GOTO, label(fall[b])));
+                break;
+            }
+        }
+    }
+    out.push_back(IRInstruction(IROpcode::FUNC_END, name));
+    for (Operand var : varOperands) slot(var) = -1;
+}
+
+void SSAFunction::dump(OutputBuffer& out, const IRBuffer& code) const 
+{
+    out << "SSA " << code.text(name) << ": " << blocks.size() << " blocks\n";
+    for (size_t b = 0; b < blocks.size(); b++) 
+    {
+        if (b != 0 && blocks[b].preds.empty()) continue;
+        const SSABlock& block = blocks[b];
+        out << "B" << b << ":";
+        if (!block.preds.empty()) 
+        {
+            out << " <-";
+            for (uint32_t p : block.preds) out << " B" << (size_t)p;
+        }
+        out << '\n';
+        for (const auto& phi : block.phis) 
+        {
+            out << "  " << code.text(phi.result) << " = PHI";
+            for (size_t j = 0; j < phi.args.size(); j++) 
+            {
+                out << (j ? ", " : " ") << (phi.args[j].empty() ? string("?") : code.text(phi.args[j]));
+            }
+            out << '\n';
+        }
+        for (size_t i = 0; i + 1 < block.code.size(); i++) 
+        {
+            code.dump(out, block.code[i]);
+            out << '\n';
+        }
+        const IRInstruction& term = block.terminator();
+        switch (term.op) 
+        {
+            case IROpcode::GOTO:
+                out << "  GOTO B" << (size_t)block.succs[0] << '\n';
+                break;
+            case IROpcode::RETURN:
+                code.dump(out, term);
+                out << '\n';
+                break;
+            default:
+                if (!isConditionalBranch(term.op)) 
+                {
+                    out << "  EXIT\n";
+                    break;
+                }
+                out << "  " << opcodeToString(term.op) << " " << code.text(term.arg1);
+                if (!term.arg2.empty()) out << ", " << code.text(term.arg2);
+                out << " GOTO B" << (size_t)block.succs[1] << " ELSE B" << (size_t)block.succs[0] << '\n';
+                break;
+        }
+    }
+}
@@ -0,0 +1,161 @@
+#ifndef SSA_H
+#define SSA_H
+
+#include <cstdint>
+#include <vector>
+#include "ir.h"
+#include "cfg.h"
+
+using namespace std;
+
+// One function's TAC in SSA form. Every definition of a parameter, local
+// or temp becomes a function-local temp defined exactly once; a parameter
+// or local read before any assignment stays its Var operand, standing for
+// the value it had on entry. Globals are memory and are never renamed.
+//
+// Blocks keep their code without labels. Control flow lives in the last
+// instruction (GOTO, a conditional branch, RETURN, or FUNC_END for falling
+// off the end) plus the successor list: a GOTO has one successor; a conditional
+// branch has the fall-through successor first and the jump target second.
+// A phi's arguments line up with its block's predecessor list.
+struct PhiNode 
+{
+    Operand result;
+    vector<Operand> args;
+};
+
+struct SSABlock 
+{
+    vector<PhiNode> phis;
+    vector<IRInstruction> code;
+    vector<uint32_t> preds;
+    vector<uint32_t> succs;
+    int32_t placeAfter = -1;    // blocks added by passes are laid out after this one
+    
+    const IRInstruction& terminator() const { return code.back(); }
+    IRInstruction& terminator() { return code.back(); }
+};
+
+// A definition or use: an instruction of a block, or (phi >= 0) a phi of it
+struct SSASite 
+{
+    uint32_t block;
+    int32_t index;      // instruction index, or -1 for a phi
+    int32_t phi;        // phi index, or -1 for an instruction
+    
+    bool isPhi() const { return phi >= 0; }
+};
+
+class SSAFunction 
+{
+private:
+    vector<uint32_t> rpo;               // reachable blocks in reverse postorder
+    vector<int32_t> idom;               // immediate dominator, -1 for the entry
+    vector<uint32_t> domChildOffsets;   // dominator tree children, CSR
+    vector<uint32_t> domChildren;
+    vector<uint32_t> domPre, domPost;   // dominator tree DFS numbers
+    
+    vector<SSASite> defSites;           // per value
+    vector<uint32_t> useOffsets;        // per value, CSR into useSites
+    vector<SSASite> useSites;
+    
+    // scratch maps from a Temp or Var operand to a per-function index,
+    // kept at -1 between uses so they never need clearing
+    vector<int32_t> tempSlots, nameSlots;
+    int32_t& slot(Operand operand);
+    
+    void computeFrontiers(vector<vector<uint32_t>>& frontiers) const;
+    void splitPhiEdges();
+
+public:
+    Operand name;                       // the function operand of FUNC_BEGIN
+    vector<SSABlock> blocks;            // blocks[0] is the entry
+    vector<Operand> origin;             // per value: the variable it versions, or None
+    size_t droppedInstructions = 0;     // unreachable code discarded while building
+    
+    // builds SSA for the function whose graph is cfg, over code's instructions
+    void build(const IRBuffer& code, const ControlFlowGraph& cfg);
+    
+    uint32_t valueCount() const { return (uint32_t)origin.size(); }
+    Operand newValue(Operand versionOf = Operand());
+    static bool isValue(Operand operand) { return operand.kind() == OperandKind::Temp; }
+    
+    // Recomputes predecessor lists from successor lists. Phi arguments are
+    // positional, so passes that rewire edges keep phis in step themselves.
+    void rebuildPredecessors();
+    uint32_t addBlock(int32_t placeAfter);
+    // a new block on the edge from -> to, which keeps to's phi arguments
+    uint32_t splitEdge(uint32_t from, uint32_t to);
+    // drops the edge and the matching phi arguments
+    void removeEdge(uint32_t from, uint32_t to);
+    // Detaches every block no longer reachable from the entry and empties
+    // it, keeping block numbers stable; returns the instructions and phis
+    // removed. Dominators are left for the next computeDominators().
+    size_t removeUnreachable();
+    
+    // Dominators by Cooper, Harvey and Kennedy's iterative algorithm over
+    // reverse postorder. Blocks unreachable from the entry get idom -1 and
+    // are absent from reversePostorder().
+    void computeDominators();
+    const vector<uint32_t>& reversePostorder() const { return rpo; }
+    int32_t immediateDominator(uint32_t block) const { return idom[block]; }
+    bool reachable(uint32_t block) const { return block == 0 || idom[block] >= 0; }
+    bool dominates(uint32_t a, uint32_t b) const 
+    {
+        return domPre[a] <= domPre[b] && domPost[b] <= domPost[a];
+    }
+    ControlFlowGraph::Edges dominatorChildren(uint32_t block) const 
+    {
+        return {domChildren.data() + domChildOffsets[block], domChildren.data() + domChildOffsets[block + 1]};
+    }
+    
+    // Def-use chains in one linear pass; invalid after the code changes.
+    void computeDefUse();
+    const SSASite& definition(uint32_t value) const { return defSites[value]; }
+    const SSASite* usesBegin(uint32_t value) const { return useSites.data() + useOffsets[value]; }
+    const SSASite* usesEnd(uint32_t value) const { return useSites.data() + useOffsets[value + 1]; }
+    size_t useCount(uint32_t value) const { return useOffsets[value + 1] - useOffsets[value]; }
+    
+    // Points every use through a replacement map (see replaced()) and drops
+    // the phis and instructions of replaced values; a call stays for its effects.
+    void replaceValues(const vector<Operand>& replacement);
+    
+    // Leaves SSA: splits edges from branches into phi blocks, gives every value
+    // the name of the variable it versions unless its live range overlaps
+    // another value of that name, turns phis into parallel copies in the
+    // predecessors and lays the blocks out as labelled TAC. Temps are
+    // renumbered from 0 within the function, labels from nextLabel on.
+    void toTAC(vector<IRInstruction>& out, uint32_t& nextLabel);
+    
+    void dump(OutputBuffer& out, const IRBuffer& code) const;
+};
+
+// operands an instruction reads and whether it defines its result
+bool definesResult(const IRInstruction& instr);
+template <typename F>
+void forEachUse(IRInstruction& instr, F f) 
+{
+    if (instr.op == IROpcode::LABEL || instr.op == IROpcode::FUNC_BEGIN ||
+        instr.op == IROpcode::FUNC_END || instr.op == IROpcode::GOTO)
+        return;
+    if (instr.op == IROpcode::CALL) return;    // callee and argument count
+    if (!instr.arg1.empty()) f(instr.arg1);
+    if (!instr.arg2.empty()) f(instr.arg2);
+}
+
+inline bool isIntConstant(Operand operand) 
+{
+    return operand.kind() == OperandKind::Int || operand.kind() == OperandKind::LongInt;
+}
+
+// A replacement map holds, per value, the operand its uses read instead, or
+// None. Values made after the map was sized are never replaced.
+inline Operand replaced(const vector<Operand>& replacement, Operand operand) 
+{
+    while (SSAFunction::isValue(operand) && operand.index() < replacement.size() &&
+           !replacement[operand.index()].empty())
+        operand = replacement[operand.index()];
+    return operand;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#!/bin/sh
+# Regression checks on the driver's output for small programs in tests/.
+# usage: tests/run.sh [main] [gen_program]   (run from phase-IR)
+
+MAIN=${1:-./main}
+GEN=${2:-./gen_program}
+failed=0
+
+check() {
+    if [ "$3" = "$2" ]; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1: expected '$2', got '$3'"
+        failed=1
+    fi
+}
+
+# a variable only comes into view after its own initializer
+check lookup-initializer "  visible: a : int main() : int" \
+    "$("$MAIN" --no-dump --lookup=3:13 tests/lookup_init.txt | grep visible)"
+
+# an unused conversion that traps still traps once optimized
+check dead-f2i "$("$MAIN" --no-dump --run tests/dead_f2i.txt 2>&1 | tail -1)" \
+    "$("$MAIN" --no-dump --run -O tests/dead_f2i.txt 2>&1 | tail -1)"
+
+# every pass, alone and together, leaves what generated programs compute alone
+if [ -x "$GEN" ]; then
+    DIR=$(mktemp -d)
+    trap 'rm -rf "$DIR"' EXIT
+    for mode in plain loops pre; do
+        for seed in 1 2 3; do
+            file="$DIR/$mode$seed.txt"
+            "$GEN" 6 20 $seed $mode > "$file"
+            expected=$("$MAIN" --no-dump --run "$file" 2>&1 | tail -1)
+            for opt in -O --opt=sccp --opt=copy --opt=lvn --opt=gvn --opt=dce --opt=fuse \
+                       --opt=licm --opt=iv --opt=pre --opt=unroll; do
+                check "run $mode$seed $opt" "$expected" "$("$MAIN" --no-dump --run $opt "$file" 2>&1 | tail -1)"
+            done
+        done
+    done
+else
+    echo "skip run with passes: no $GEN"
+fi
+
+exit $failed
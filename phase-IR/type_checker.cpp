@@ -69,49 +69,12 @@ TypeCheckException::TypeCheckException(TypeChkError type, const string& detail)
     msg = oss.str();
 }
 
-bool TypeChecker::isNumericType(const string& type) 
-{
-    return type == "int" || type == "float";
-}
-
-bool TypeChecker::isIntegerType(const string& type) 
-{
-    return type == "int";
-}
-
-bool TypeChecker::isBooleanType(const string& type) 
-{
-    return type == "bool";
-}
-
-bool TypeChecker::areTypesCompatible(const string& type1, const string& type2) 
-{
-    if (type1 == type2) return true;
-    
-    
-    if ((type1 == "int" && type2 == "float") || (type1 == "float" && type2 == "int"))
-        return true;
-    
-    return false;
-}
-
-string TypeChecker::promoteTypes(const string& type1, const string& type2) 
-{
-    if (type1 == type2) return type1;
-    
-    
-    if ((type1 == "int" && type2 == "float") || (type1 == "float" && type2 == "int"))
-        return "float";
-    
-    return type1;
-}
-
 void TypeChecker::check(shared_ptr<ProgramNode> program) 
 {
     checkProgram(program);
 }
 
-string TypeChecker::checkNode(AST node)
+TypeId TypeChecker::checkNode(AST node)
 {
     if (!node) 
     {
@@ -121,12 +84,12 @@ string TypeChecker::checkNode(AST node)
     if (auto prog = dynamic_pointer_cast<ProgramNode>(node)) 
     {
         checkProgram(prog);
-        return "void";
+        return TypeId::Void;
     } 
     else if (auto block = dynamic_pointer_cast<BlockNode>(node)) 
     {
         checkBlock(block);
-        return "void";
+        return TypeId::Void;
     } 
     else if (auto func = dynamic_pointer_cast<FunctionNode>(node)) 
     {
@@ -140,49 +103,54 @@ string TypeChecker::checkNode(AST node)
     else if (auto ret = dynamic_pointer_cast<ReturnNode>(node)) 
     {
         checkReturn(ret);
-        return "void";
+        return TypeId::Void;
     } 
     else if (auto ifNode = dynamic_pointer_cast<IfNode>(node)) 
     {
         checkIf(ifNode);
-        return "void";
+        return TypeId::Void;
     } 
     else if (auto whileNode = dynamic_pointer_cast<WhileNode>(node)) 
     {
         checkWhile(whileNode);
-        return "void";
+        return TypeId::Void;
     } 
     else if (auto exprStmt = dynamic_pointer_cast<ExprStmtNode>(node)) 
     {
         checkExprStmt(exprStmt);
-        return "void";
+        return TypeId::Void;
     } 
-    else if (auto binOp = dynamic_pointer_cast<BinaryOpNode>(node)) 
+    
+    // expressions keep their type on the node; a hash-consed node typed
+    // through one parent is already done for the others
+    if (node->shared && node->type != TypeId::Void) return node->type;
+    
+    if (auto binOp = dynamic_pointer_cast<BinaryOpNode>(node)) 
     {
-        return checkBinaryOp(binOp);
+        return node->type = checkBinaryOp(binOp);
     } 
     else if (auto unOp = dynamic_pointer_cast<UnaryOpNode>(node)) 
     {
-        return checkUnaryOp(unOp);
+        return node->type = checkUnaryOp(unOp);
     } 
     else if (auto lit = dynamic_pointer_cast<LiteralNode>(node)) 
     {
-        return checkLiteral(lit);
+        return node->type = checkLiteral(lit);
     } 
     else if (auto id = dynamic_pointer_cast<IdentifierNode>(node)) 
     {
-        return checkIdentifier(id);
+        return node->type = checkIdentifier(id);
     } 
     else if (auto call = dynamic_pointer_cast<CallNode>(node)) 
     {
-        return checkCall(call);
+        return node->type = checkCall(call);
     } 
     else if (auto assign = dynamic_pointer_cast<AssignmentNode>(node)) 
     {
-        return checkAssignment(assign);
+        return node->type = checkAssignment(assign);
     }
     
-    return "void";
+    return TypeId::Void;
 }
 
 void TypeChecker::checkProgram(shared_ptr<ProgramNode> node) 
@@ -196,166 +164,101 @@ void TypeChecker::checkProgram(shared_ptr<ProgramNode> node)
 
 void TypeChecker::checkBlock(shared_ptr<BlockNode> node) 
 {
-    scopeStack.enterScope();
-    
     for (const auto& stmt : node->stmts) 
     {
         checkNode(stmt);
     }
-    
-    scopeStack.exitScope();
 }
 
-void TypeChecker::checkFunction(shared_ptr<FunctionNode> node) 
+void checkFunctionReturns(const FunctionNode& fn, bool hasReturnStmt) 
 {
-    currentFunctionRetType = node->retType;
-    hasReturnStmt = false;
-    
-    scopeStack.enterScope();
-    
-    for (const auto& param : node->params) 
-    {
-        scopeStack.addSymbol(param.second, param.first, false);
-    }
-    
-    for (const auto& stmt : node->body->stmts) 
-    {
-        checkNode(stmt);
-    }
-    
-    scopeStack.exitScope();
-    
-    
-    if (node->retType != "void" && !hasReturnStmt) 
+    if (fn.retType != TypeId::Void && !hasReturnStmt) 
     {
         throw TypeCheckException(TypeChkError::ReturnStmtNotFound, 
-            "Function '" + node->name + "' must return a value of type '" + node->retType + "'");
+            "Function '" + fn.name + "' must return a value of type '" + typeName(fn.retType) + "'");
     }
 }
 
-string TypeChecker::checkVarDecl(shared_ptr<VarDeclNode> node) 
+void checkInitializerType(const VarDeclNode& decl, TypeId initType) 
 {
-    if (node->init) 
+    if (!areTypesCompatible(decl.typeName, initType)) 
     {
-        string initType = checkNode(node->init);
-        
-        if (!areTypesCompatible(node->typeName, initType)) 
-        {
-            throw TypeCheckException(TypeChkError::ErroneousVarDecl,
-                "Cannot initialize variable '" + node->name + "' of type '" + 
-                node->typeName + "' with expression of type '" + initType + "'");
-        }
+        throw TypeCheckException(TypeChkError::ErroneousVarDecl,
+            "Cannot initialize variable '" + decl.name + "' of type '" + 
+            typeName(decl.typeName) + "' with expression of type '" + typeName(initType) + "'");
     }
-    
-    scopeStack.addSymbol(node->name, node->typeName, false);
-    return node->typeName;
 }
 
-void TypeChecker::checkReturn(shared_ptr<ReturnNode> node) 
+void checkReturnType(TypeId retType, bool hasValue, TypeId valueType) 
 {
-    hasReturnStmt = true;
-    
-    if (node->expr) 
+    if (hasValue) 
     {
-        string exprType = checkNode(node->expr);
-        
-        if (currentFunctionRetType == "void") 
+        if (retType == TypeId::Void) 
         {
             throw TypeCheckException(TypeChkError::ErroneousReturnType,
                 "Cannot return a value from void function");
         }
         
-        if (!areTypesCompatible(currentFunctionRetType, exprType)) 
+        if (!areTypesCompatible(retType, valueType)) 
         {
             throw TypeCheckException(TypeChkError::ErroneousReturnType,
-                "Expected return type '" + currentFunctionRetType + 
-                "' but got '" + exprType + "'");
+                string("Expected return type '") + typeName(retType) + 
+                "' but got '" + typeName(valueType) + "'");
         }
     } 
     else 
     {
-        if (currentFunctionRetType != "void") 
+        if (retType != TypeId::Void) 
         {
             throw TypeCheckException(TypeChkError::ErroneousReturnType,
-                "Function must return value of type '" + currentFunctionRetType + "'");
+                string("Function must return value of type '") + typeName(retType) + "'");
         }
     }
 }
 
-void TypeChecker::checkIf(shared_ptr<IfNode> node) 
+void checkConditionType(const char* stmt, TypeId condType) 
 {
-    string condType = checkNode(node->cond);
-    
-    if (!isBooleanType(condType)) 
+    if (condType != TypeId::Bool) 
     {
         throw TypeCheckException(TypeChkError::NonBooleanCondStmt,
-            "If condition must be boolean, got '" + condType + "'");
-    }
-    
-    checkBlock(node->thenBlock);
-    
-    if (node->elseBlock) 
-    {
-        checkBlock(node->elseBlock);
+            string(stmt) + " condition must be boolean, got '" + typeName(condType) + "'");
     }
 }
 
-void TypeChecker::checkWhile(shared_ptr<WhileNode> node) 
+TypeId binaryOpType(const string& op, TypeId leftType, TypeId rightType) 
 {
-    string condType = checkNode(node->cond);
-    
-    if (!isBooleanType(condType)) 
+    if (op == "&&" || op == "||") 
     {
-        throw TypeCheckException(TypeChkError::NonBooleanCondStmt,
-            "While condition must be boolean, got '" + condType + "'");
-    }
-    
-    checkBlock(node->body);
-}
-
-void TypeChecker::checkExprStmt(shared_ptr<ExprStmtNode> node) 
-{
-    checkNode(node->expr);
-}
-
-string TypeChecker::checkBinaryOp(shared_ptr<BinaryOpNode> node) 
-{
-    string leftType = checkNode(node->left);
-    string rightType = checkNode(node->right);
-    
-    
-    if (node->op == "&&" || node->op == "||") 
-    {
-        if (!isBooleanType(leftType) || !isBooleanType(rightType)) 
+        if (leftType != TypeId::Bool || rightType != TypeId::Bool) 
         {
             throw TypeCheckException(TypeChkError::AttemptedBoolOpOnNonBools,
-                "Operator '" + node->op + "' requires boolean operands, got '" + 
-                leftType + "' and '" + rightType + "'");
+                "Operator '" + op + "' requires boolean operands, got '" + 
+                typeName(leftType) + "' and '" + typeName(rightType) + "'");
         }
-        return "bool";
+        return TypeId::Bool;
     }
     
     
-    if (node->op == "==" || node->op == "!=" || 
-        node->op == "<" || node->op == ">" || 
-        node->op == "<=" || node->op == ">=") 
+    if (op == "==" || op == "!=" || 
+        op == "<" || op == ">" || 
+        op == "<=" || op == ">=") 
     {
         if (!areTypesCompatible(leftType, rightType)) 
         {
             throw TypeCheckException(TypeChkError::ExpressionTypeMismatch,
-                "Cannot compare '" + leftType + "' with '" + rightType + "'");
+                string("Cannot compare '") + typeName(leftType) + "' with '" + typeName(rightType) + "'");
         }
-        return "bool";
+        return TypeId::Bool;
     }
     
     
-    if (node->op == "+" || node->op == "-" || node->op == "*" || node->op == "/") 
+    if (op == "+" || op == "-" || op == "*" || op == "/") 
     {
         if (!isNumericType(leftType) || !isNumericType(rightType)) 
         {
             throw TypeCheckException(TypeChkError::AttemptedAddOpOnNonNumeric,
-                "Operator '" + node->op + "' requires numeric operands, got '" + 
-                leftType + "' and '" + rightType + "'");
+                "Operator '" + op + "' requires numeric operands, got '" + 
+                typeName(leftType) + "' and '" + typeName(rightType) + "'");
         }
         return promoteTypes(leftType, rightType);
     }
@@ -363,28 +266,25 @@ string TypeChecker::checkBinaryOp(shared_ptr<BinaryOpNode> node)
     return leftType;
 }
 
-string TypeChecker::checkUnaryOp(shared_ptr<UnaryOpNode> node) 
+TypeId unaryOpType(const string& op, TypeId operandType) 
 {
-    string operandType = checkNode(node->operand);
-    
-    
-    if (node->op == "-" || node->op == "+") 
+    if (op == "-" || op == "+") 
     {
         if (!isNumericType(operandType)) 
         {
             throw TypeCheckException(TypeChkError::AttemptedAddOpOnNonNumeric,
-                "Unary '" + node->op + "' requires numeric operand, got '" + operandType + "'");
+                "Unary '" + op + "' requires numeric operand, got '" + typeName(operandType) + "'");
         }
         return operandType;
     }
     
     
-    if (node->op == "++" || node->op == "--") 
+    if (op == "++" || op == "--") 
     {
         if (!isNumericType(operandType)) 
         {
             throw TypeCheckException(TypeChkError::AttemptedAddOpOnNonNumeric,
-                "Operator '" + node->op + "' requires numeric operand, got '" + operandType + "'");
+                "Operator '" + op + "' requires numeric operand, got '" + typeName(operandType) + "'");
         }
         return operandType;
     }
@@ -392,14 +292,127 @@ string TypeChecker::checkUnaryOp(shared_ptr<UnaryOpNode> node)
     return operandType;
 }
 
-string TypeChecker::checkLiteral(shared_ptr<LiteralNode> node) 
+void checkArgCount(const string& name, const SymbolInfo& fn, size_t argCount) 
+{
+    if (argCount != fn.paramTypes.size()) 
+    {
+        throw TypeCheckException(TypeChkError::FnCallParamCount,
+            "Function '" + name + "' expects " + 
+            to_string(fn.paramTypes.size()) + " parameters but got " + 
+            to_string(argCount));
+    }
+}
+
+void checkArgType(const string& name, const SymbolInfo& fn, size_t index, TypeId argType) 
+{
+    TypeId expectedType = fn.paramTypes[index];
+    if (!areTypesCompatible(expectedType, argType)) 
+    {
+        throw TypeCheckException(TypeChkError::FnCallParamType,
+            "Parameter " + to_string(index + 1) + " of function '" + name + 
+            "' expects type '" + typeName(expectedType) + "' but got '" + typeName(argType) + "'");
+    }
+}
+
+TypeId assignmentType(const string& op, TypeId leftType, TypeId rightType) 
+{
+    if (op != "=") 
+    {
+        if (!isNumericType(leftType) || !isNumericType(rightType)) 
+        {
+            throw TypeCheckException(TypeChkError::AttemptedAddOpOnNonNumeric,
+                "Compound assignment '" + op + "' requires numeric operands");
+        }
+    } 
+    else 
+    {
+        
+        if (!areTypesCompatible(leftType, rightType)) 
+        {
+            throw TypeCheckException(TypeChkError::ExpressionTypeMismatch,
+                string("Cannot assign value of type '") + typeName(rightType) + 
+                "' to variable of type '" + typeName(leftType) + "'");
+        }
+    }
+    
+    return leftType;
+}
+
+void TypeChecker::checkFunction(shared_ptr<FunctionNode> node) 
+{
+    currentFunctionRetType = node->retType;
+    hasReturnStmt = false;
+    
+    for (const auto& stmt : node->body->stmts) 
+    {
+        checkNode(stmt);
+    }
+    
+    checkFunctionReturns(*node, hasReturnStmt);
+}
+
+TypeId TypeChecker::checkVarDecl(shared_ptr<VarDeclNode> node) 
+{
+    if (node->init) 
+    {
+        checkInitializerType(*node, checkNode(node->init));
+    }
+    
+    return node->typeName;
+}
+
+void TypeChecker::checkReturn(shared_ptr<ReturnNode> node) 
+{
+    hasReturnStmt = true;
+    
+    TypeId exprType = node->expr ? checkNode(node->expr) : TypeId::Void;
+    checkReturnType(currentFunctionRetType, node->expr != nullptr, exprType);
+}
+
+void TypeChecker::checkIf(shared_ptr<IfNode> node) 
+{
+    checkConditionType("If", checkNode(node->cond));
+    
+    checkBlock(node->thenBlock);
+    
+    if (node->elseBlock) 
+    {
+        checkBlock(node->elseBlock);
+    }
+}
+
+void TypeChecker::checkWhile(shared_ptr<WhileNode> node) 
+{
+    checkConditionType("While", checkNode(node->cond));
+    
+    checkBlock(node->body);
+}
+
+void TypeChecker::checkExprStmt(shared_ptr<ExprStmtNode> node) 
+{
+    checkNode(node->expr);
+}
+
+TypeId TypeChecker::checkBinaryOp(shared_ptr<BinaryOpNode> node) 
+{
+    TypeId leftType = checkNode(node->left);
+    TypeId rightType = checkNode(node->right);
+    return binaryOpType(node->op, leftType, rightType);
+}
+
+TypeId TypeChecker::checkUnaryOp(shared_ptr<UnaryOpNode> node) 
+{
+    return unaryOpType(node->op, checkNode(node->operand));
+}
+
+TypeId TypeChecker::checkLiteral(shared_ptr<LiteralNode> node) 
 {
     return node->kind;
 }
 
-string TypeChecker::checkIdentifier(shared_ptr<IdentifierNode> node) 
+TypeId TypeChecker::checkIdentifier(shared_ptr<IdentifierNode> node) 
 {
-    auto symbol = scopeStack.lookup(node->name, false);
+    const auto& symbol = node->symbol;
     if (!symbol) 
     {
         throw TypeCheckException(TypeChkError::ExpressionTypeMismatch,
@@ -408,7 +421,7 @@ string TypeChecker::checkIdentifier(shared_ptr<IdentifierNode> node)
     return symbol->type;
 }
 
-string TypeChecker::checkCall(shared_ptr<CallNode> node)
+TypeId TypeChecker::checkCall(shared_ptr<CallNode> node)
 {
     auto idNode = dynamic_pointer_cast<IdentifierNode>(node->callee);
     if (!idNode) 
@@ -417,40 +430,23 @@ string TypeChecker::checkCall(shared_ptr<CallNode> node)
             "Invalid function call");
     }
     
-    auto funcSymbol = scopeStack.lookup(idNode->name, true);
+    const auto& funcSymbol = node->symbol;
     if (!funcSymbol) 
     {
         throw TypeCheckException(TypeChkError::ExpressionTypeMismatch,
             "Undefined function '" + idNode->name + "'");
     }
     
-    
-    if (node->args.size() != funcSymbol->paramTypes.size()) 
+    checkArgCount(idNode->name, *funcSymbol, node->args.size());
+    for (size_t i = 0; i < node->args.size(); i++) 
     {
-        throw TypeCheckException(TypeChkError::FnCallParamCount,
-            "Function '" + idNode->name + "' expects " + 
-            to_string(funcSymbol->paramTypes.size()) + " parameters but got " + 
-            to_string(node->args.size()));
-    }
-    
-    
-    for (int i = 0; i < node->args.size(); i++) 
-    {
-        string argType = checkNode(node->args[i]);
-        string expectedType = funcSymbol->paramTypes[i];
-        
-        if (!areTypesCompatible(expectedType, argType)) 
-        {
-            throw TypeCheckException(TypeChkError::FnCallParamType,
-                "Parameter " + to_string(i + 1) + " of function '" + idNode->name + 
-                "' expects type '" + expectedType + "' but got '" + argType + "'");
-        }
+        checkArgType(idNode->name, *funcSymbol, i, checkNode(node->args[i]));
     }
     
     return funcSymbol->type;
 }
 
-string TypeChecker::checkAssignment(shared_ptr<AssignmentNode> node) 
+TypeId TypeChecker::checkAssignment(shared_ptr<AssignmentNode> node) 
 {
     auto idNode = dynamic_pointer_cast<IdentifierNode>(node->left);
     if (!idNode) 
@@ -459,28 +455,7 @@ string TypeChecker::checkAssignment(shared_ptr<AssignmentNode> node)
             "Left side of assignment must be a variable");
     }
     
-    string leftType = checkIdentifier(idNode);
-    string rightType = checkNode(node->right);
-    
-    
-    if (node->op != "=") 
-    {
-        if (!isNumericType(leftType) || !isNumericType(rightType)) 
-        {
-            throw TypeCheckException(TypeChkError::AttemptedAddOpOnNonNumeric,
-                "Compound assignment '" + node->op + "' requires numeric operands");
-        }
-    } 
-    else 
-    {
-        
-        if (!areTypesCompatible(leftType, rightType)) 
-        {
-            throw TypeCheckException(TypeChkError::ExpressionTypeMismatch,
-                "Cannot assign value of type '" + rightType + 
-                "' to variable of type '" + leftType + "'");
-        }
-    }
-    
-    return leftType;
+    TypeId leftType = checkIdentifier(idNode);
+    TypeId rightType = checkNode(node->right);
+    return assignmentType(node->op, leftType, rightType);
 }
\ No newline at end of file
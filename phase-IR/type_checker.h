@@ -8,6 +8,7 @@
 #include <unordered_map>
 #include <sstream>
 #include "scope_analyzer.h"
+#include "types.h"
 
 using namespace std;
 
@@ -67,41 +68,46 @@ public:
     string getDetails() const { return details; }
 };
 
+// Typing rules, shared by TypeChecker and FusedSemanticAnalyzer. Each one
+// throws TypeCheckException on a violation.
+void checkFunctionReturns(const FunctionNode& fn, bool hasReturnStmt);
+void checkInitializerType(const VarDeclNode& decl, TypeId initType);
+void checkReturnType(TypeId retType, bool hasValue, TypeId valueType);
+void checkConditionType(const char* stmt, TypeId condType);
+TypeId binaryOpType(const string& op, TypeId leftType, TypeId rightType);
+TypeId unaryOpType(const string& op, TypeId operandType);
+void checkArgCount(const string& name, const SymbolInfo& fn, size_t argCount);
+void checkArgType(const string& name, const SymbolInfo& fn, size_t index, TypeId argType);
+TypeId assignmentType(const string& op, TypeId leftType, TypeId rightType);
+
 class TypeChecker 
 {
 private:
-    ScopeStack& scopeStack;
-    string currentFunctionRetType;
+    TypeId currentFunctionRetType;
     bool hasReturnStmt;
     
-    
-    bool isNumericType(const string& type);
-    bool isIntegerType(const string& type);
-    bool isBooleanType(const string& type);
-    bool areTypesCompatible(const string& type1, const string& type2);
-    string promoteTypes(const string& type1, const string& type2);
-    
 public:
-    TypeChecker(ScopeStack& stack) : scopeStack(stack), hasReturnStmt(false) {}
+    TypeChecker() : currentFunctionRetType(TypeId::Void), hasReturnStmt(false) {}
     
     void check(shared_ptr<ProgramNode> program);
+    void checkItem(const AST& item) { checkNode(item); }
     
 private:
-    string checkNode(AST node);
+    TypeId checkNode(AST node);
     void checkProgram(shared_ptr<ProgramNode> node);
     void checkBlock(shared_ptr<BlockNode> node);
     void checkFunction(shared_ptr<FunctionNode> node);
-    string checkVarDecl(shared_ptr<VarDeclNode> node);
+    TypeId checkVarDecl(shared_ptr<VarDeclNode> node);
     void checkReturn(shared_ptr<ReturnNode> node);
     void checkIf(shared_ptr<IfNode> node);
     void checkWhile(shared_ptr<WhileNode> node);
     void checkExprStmt(shared_ptr<ExprStmtNode> node);
-    string checkBinaryOp(shared_ptr<BinaryOpNode> node);
-    string checkUnaryOp(shared_ptr<UnaryOpNode> node);
-    string checkLiteral(shared_ptr<LiteralNode> node);
-    string checkIdentifier(shared_ptr<IdentifierNode> node);
-    string checkCall(shared_ptr<CallNode> node);
-    string checkAssignment(shared_ptr<AssignmentNode> node);
+    TypeId checkBinaryOp(shared_ptr<BinaryOpNode> node);
+    TypeId checkUnaryOp(shared_ptr<UnaryOpNode> node);
+    TypeId checkLiteral(shared_ptr<LiteralNode> node);
+    TypeId checkIdentifier(shared_ptr<IdentifierNode> node);
+    TypeId checkCall(shared_ptr<CallNode> node);
+    TypeId checkAssignment(shared_ptr<AssignmentNode> node);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <cstdint>
+
+using namespace std;
+
+// The language's closed set of types. Statements check as Void.
+enum class TypeId : uint8_t 
+{
+    Void,
+    Int,
+    Float,
+    Bool,
+    String,
+};
+
+const int TypeCount = 5;
+
+inline const char* typeName(TypeId t) 
+{
+    static const char* const names[TypeCount] = { "void", "int", "float", "bool", "string" };
+    return names[(int)t];
+}
+
+inline bool isNumericType(TypeId t) 
+{
+    return t == TypeId::Int || t == TypeId::Float;
+}
+
+// Compatibility and promotion are symmetric table lookups: int and float
+// mix (promoting to float), every other type only matches itself.
+inline bool areTypesCompatible(TypeId a, TypeId b) 
+{
+    static const bool compatible[TypeCount][TypeCount] = 
+    {
+        //  void   int    float  bool   string
+        {   true,  false, false, false, false },  // void
+        {   false, true,  true,  false, false },  // int
+        {   false, true,  true,  false, false },  // float
+        {   false, false, false, true,  false },  // bool
+        {   false, false, false, false, true  },  // string
+    };
+    return compatible[(int)a][(int)b];
+}
+
+// Result type of a binary arithmetic operation; the left type when the
+// operands are not compatible.
+inline TypeId promoteTypes(TypeId a, TypeId b) 
+{
+    static const TypeId promoted[TypeCount][TypeCount] = 
+    {
+        { TypeId::Void,   TypeId::Void,   TypeId::Void,   TypeId::Void,   TypeId::Void   },
+        { TypeId::Int,    TypeId::Int,    TypeId::Float,  TypeId::Int,    TypeId::Int    },
+        { TypeId::Float,  TypeId::Float,  TypeId::Float,  TypeId::Float,  TypeId::Float  },
+        { TypeId::Bool,   TypeId::Bool,   TypeId::Bool,   TypeId::Bool,   TypeId::Bool   },
+        { TypeId::String, TypeId::String, TypeId::String, TypeId::String, TypeId::String },
+    };
+    return promoted[(int)a][(int)b];
+}
+
+#endif
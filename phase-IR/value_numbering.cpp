@@ -0,0 +1,295 @@
+#include "passes.h"
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+// A value number: the kind of operand that stands for the value and its
+// bits. Temps number as the first value found equal to them; constants
+// as their value, so pooled copies of one literal compare equal.
+struct ValueKey 
+{
+    OperandKind kind;
+    uint64_t bits;
+    
+    bool operator==(const ValueKey& o) const { return kind == o.kind && bits == o.bits; }
+    bool operator<(const ValueKey& o) const { return kind != o.kind ? kind < o.kind : bits < o.bits; }
+};
+
+struct ExpressionKey 
+{
+    IROpcode op;
+    ValueKey left;
+    ValueKey right;
+    
+    bool operator==(const ExpressionKey& o) const 
+    {
+        return op == o.op && left == o.left && right == o.right;
+    }
+};
+
+static uint64_t mix(uint64_t h) 
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Open-addressed table of the available expressions. Entries leave in the
+// reverse of the order they came in, so removing one only empties its slot:
+// nothing still in the table was probed past it.
+class AvailableTable 
+{
+private:
+    struct Entry 
+    {
+        ExpressionKey key;
+        Operand result;
+        uint32_t slot;
+    };
+    vector<Entry> entries;      // in insertion order
+    vector<int32_t> slots;      // entry index, -1 when empty
+    size_t mask = 0;
+    
+    static size_t hashOf(const ExpressionKey& k) 
+    {
+        uint64_t h = mix(k.left.bits ^ (uint64_t)k.op << 56 ^ (uint64_t)k.left.kind << 48);
+        return mix(h ^ k.right.bits ^ (uint64_t)k.right.kind << 40);
+    }
+    
+    size_t probe(const ExpressionKey& key) const 
+    {
+        size_t s = hashOf(key) & mask;
+        while (slots[s] >= 0 && !(entries[slots[s]].key == key)) s = (s + 1) & mask;
+        return s;
+    }
+    
+    void grow() 
+    {
+        slots.assign(slots.empty() ? 1024 : slots.size() * 2, -1);
+        mask = slots.size() - 1;
+        for (size_t i = 0; i < entries.size(); i++) 
+        {
+            size_t s = probe(entries[i].key);
+            slots[s] = (int32_t)i;
+            entries[i].slot = (uint32_t)s;
+        }
+    }
+
+public:
+    size_t size() const { return entries.size(); }
+    
+    Operand find(const ExpressionKey& key) const 
+    {
+        if (slots.empty()) return Operand();
+        int32_t i = slots[probe(key)];
+        return i < 0 ? Operand() : entries[i].result;
+    }
+    
+    void insert(const ExpressionKey& key, Operand result) 
+    {
+        if (2 * (entries.size() + 1) > slots.size()) grow();
+        size_t s = probe(key);
+        slots[s] = (int32_t)entries.size();
+        entries.push_back({key, result, (uint32_t)s});
+    }
+    
+    void rollBack(size_t mark) 
+    {
+        while (entries.size() > mark) 
+        {
+            slots[entries.back().slot] = -1;
+            entries.pop_back();
+        }
+    }
+};
+
+// a > b is b < a, so both spellings share one entry
+static IROpcode swappedComparison(IROpcode op) 
+{
+    switch (op) 
+    {
+        case IROpcode::GT_I: return IROpcode::LT_I;
+        case IROpcode::GE_I: return IROpcode::LE_I;
+        case IROpcode::GT_F: return IROpcode::LT_F;
+        case IROpcode::GE_F: return IROpcode::LE_F;
+        default: return op;
+    }
+}
+
+class ValueNumbering 
+{
+private:
+    SSAFunction& function;
+    const IRBuffer& code;
+    bool global;
+    vector<ValueKey> number;            // per value
+    vector<Operand> replacement;        // per value: the earlier result standing in for it
+    vector<uint8_t> defined;            // per value, set once its definition is visited
+    AvailableTable available;
+    
+    ValueKey numberOf(Operand operand) const 
+    {
+        switch (operand.kind()) 
+        {
+            case OperandKind::Temp: return number[operand.index()];
+            case OperandKind::LongInt: return {OperandKind::Int, (uint64_t)code.intValue(operand)};
+            case OperandKind::Int: return {OperandKind::Int, (uint64_t)(int64_t)operand.inlineInt()};
+            case OperandKind::Float: 
+            {
+                double value = code.floatValue(operand);
+                uint64_t bits;
+                memcpy(&bits, &value, sizeof bits);
+                return {OperandKind::Float, bits};
+            }
+            default: return {operand.kind(), operand.index()};
+        }
+    }
+    
+    // globals change behind the function's back; everything else an
+    // operation reads is fixed for the value's lifetime
+    static bool isPure(const IRInstruction& instr) 
+    {
+        if (instr.op > IROpcode::OR) return false;
+        return instr.arg1.kind() != OperandKind::Global && instr.arg2.kind() != OperandKind::Global;
+    }
+    
+    void visitPhis(uint32_t b, ValueNumberingResult& result) 
+    {
+        SSABlock& block = function.blocks[b];
+        for (size_t k = 0; k < block.phis.size(); k++) 
+        {
+            PhiNode& phi = block.phis[k];
+            uint32_t v = phi.result.index();
+            defined[v] = 1;
+            
+            // A phi of one value, ignoring itself, is that value. The
+            // arguments may be different copies of it, so the phi reads the
+            // value itself: the temp that numbers it dominates every
+            // predecessor, while a constant or entry value is anywhere.
+            Operand first, stand;
+            bool unique = true;
+            for (Operand arg : phi.args) 
+            {
+                if (arg == phi.result || arg.empty()) continue;
+                if (first.empty()) first = arg;
+                else if (!(numberOf(arg) == numberOf(first))) unique = false;
+                if (!SSAFunction::isValue(arg)) stand = arg;
+            }
+            if (unique && !first.empty()) 
+            {
+                ValueKey key = numberOf(first);
+                if (key.kind == OperandKind::Temp) 
+                {
+                    uint32_t u = (uint32_t)key.bits;
+                    stand = u != v && defined[u] ? Operand(OperandKind::Temp, u) : Operand();
+                }
+                if (!stand.empty()) 
+                {
+                    number[v] = key;
+                    replacement[v] = stand;
+                    result.phis++;
+                    continue;
+                }
+            }
+            
+            // an earlier phi of the block with the same arguments
+            for (size_t e = 0; e < k; e++) 
+            {
+                const PhiNode& earlier = block.phis[e];
+                if (!replacement[earlier.result.index()].empty()) continue;
+                bool equal = true;
+                for (size_t j = 0; j < phi.args.size() && equal; j++) 
+                {
+                    equal = numberOf(earlier.args[j]) == numberOf(phi.args[j]);
+                }
+                if (equal) 
+                {
+                    number[v] = number[earlier.result.index()];
+                    replacement[v] = earlier.result;
+                    result.phis++;
+                    break;
+                }
+            }
+        }
+    }
+    
+    void visitInstructions(uint32_t b, ValueNumberingResult& result) 
+    {
+        for (auto& instr : function.blocks[b].code) 
+        {
+            if (!definesResult(instr) || !SSAFunction::isValue(instr.result)) continue;
+            uint32_t v = instr.result.index();
+            defined[v] = 1;
+            if (instr.op == IROpcode::COPY || instr.op == IROpcode::ASSIGN) 
+            {
+                if (instr.arg1.kind() != OperandKind::Global) number[v] = numberOf(instr.arg1);
+                continue;
+            }
+            if (!isPure(instr)) continue;
+            
+            ExpressionKey key = {instr.op, numberOf(instr.arg1), numberOf(instr.arg2)};
+            IROpcode swapped = swappedComparison(key.op);
+            if (swapped != key.op) 
+            {
+                key.op = swapped;
+                swap(key.left, key.right);
+            }
+            else if (isCommutative(key.op) && key.right < key.left) swap(key.left, key.right);
+            
+            Operand found = available.find(key);
+            if (!found.empty()) 
+            {
+                number[v] = number[found.index()];
+                replacement[v] = found;
+                result.redundant++;
+                continue;
+            }
+            available.insert(key, instr.result);
+        }
+    }
+
+public:
+    ValueNumbering(SSAFunction& fn, const IRBuffer& buffer, bool overDominators)
+        : function(fn), code(buffer), global(overDominators) {}
+        
+    ValueNumberingResult run() 
+    {
+        ValueNumberingResult result;
+        uint32_t count = function.valueCount();
+        number.resize(count);
+        for (uint32_t v = 0; v < count; v++) number[v] = {OperandKind::Temp, v};
+        replacement.assign(count, Operand());
+        defined.assign(count, 0);
+        function.computeDominators();
+        
+        // Preorder over the dominator tree: what a block computes stays
+        // available to the blocks it dominates and is rolled back on the
+        // way out. Locally, every block starts empty.
+        const size_t unvisited = SIZE_MAX;
+        vector<pair<uint32_t, size_t>> stack = {{0, unvisited}};
+        while (!stack.empty()) 
+        {
+            uint32_t b = stack.back().first;
+            if (stack.back().second != unvisited) 
+            {
+                available.rollBack(stack.back().second);
+                stack.pop_back();
+                continue;
+            }
+            stack.back().second = available.size();
+            visitPhis(b, result);
+            visitInstructions(b, result);
+            if (!global) available.rollBack(stack.back().second);
+            for (uint32_t child : function.dominatorChildren(b)) stack.push_back({child, unvisited});
+        }
+        function.replaceValues(replacement);
+        return result;
+    }
+};
+
+ValueNumberingResult numberValues(SSAFunction& function, const IRBuffer& code, bool global) 
+{
+    return ValueNumbering(function, code, global).run();
+}
@@ -0,0 +1,77 @@
+#include "work_pool.h"
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct WorkQueue 
+{
+    mutex lock;
+    deque<size_t> tasks;
+};
+
+WorkStealingPool::WorkStealingPool(unsigned threads) 
+    : threadCount(threads ? threads : max(1u, thread::hardware_concurrency())) 
+{
+}
+
+static bool popOwn(WorkQueue& queue, size_t& task) 
+{
+    lock_guard<mutex> guard(queue.lock);
+    if (queue.tasks.empty()) return false;
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+}
+
+static bool steal(WorkQueue& queue, size_t& task) 
+{
+    lock_guard<mutex> guard(queue.lock);
+    if (queue.tasks.empty()) return false;
+    task = queue.tasks.front();
+    queue.tasks.pop_front();
+    return true;
+}
+
+void WorkStealingPool::run(size_t count, const function<void(size_t, unsigned)>& task) 
+{
+    unsigned workers = (unsigned)min<size_t>(threadCount, count);
+    if (workers <= 1) 
+    {
+        for (size_t i = 0; i < count; i++) task(i, 0);
+        return;
+    }
+    
+    // contiguous slices keep neighbouring items on one worker; stealing
+    // takes from the far end of a victim's slice
+    unique_ptr<WorkQueue[]> queues(new WorkQueue[workers]);
+    for (unsigned w = 0; w < workers; w++) 
+    {
+        size_t begin = count * w / workers, end = count * (w + 1) / workers;
+        for (size_t i = end; i-- > begin; ) queues[w].tasks.push_back(i);
+    }
+    
+    // no task spawns new work, so a worker that finds every queue empty is done
+    auto work = [&](unsigned self) 
+    {
+        size_t index;
+        while (true) 
+        {
+            bool found = popOwn(queues[self], index);
+            for (unsigned k = 1; !found && k < workers; k++) 
+            {
+                found = steal(queues[(self + k) % workers], index);
+            }
+            if (!found) return;
+            task(index, self);
+        }
+    };
+    
+    vector<thread> threads;
+    for (unsigned w = 1; w < workers; w++) threads.emplace_back(work, w);
+    work(0);
+    for (auto& t : threads) t.join();
+}
@@ -0,0 +1,27 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <cstddef>
+#include <functional>
+
+using namespace std;
+
+// Fixed set of workers, each with its own deque of task indices. A worker
+// drains its own deque from the back and steals from the front of the
+// others once it runs dry, so uneven task sizes still balance out.
+class WorkStealingPool 
+{
+private:
+    unsigned threadCount;
+    
+public:
+    explicit WorkStealingPool(unsigned threads);
+    
+    unsigned size() const { return threadCount; }
+    
+    // Runs task(index, worker) for every index in [0, count) and returns once
+    // all of them have finished. Tasks must not throw.
+    void run(size_t count, const function<void(size_t, unsigned)>& task);
+};
+
+#endif